@@ -0,0 +1,133 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "pico.h"
+#include "hardware/timer.h"
+
+#include "boot_ready.h"
+#include "machine_profile.h"
+#include "rom_trap.h"
+#include "write_watch.h"
+#include "zx_mirror.h"
+
+/*
+ * The 48K ROM is ready once it gets to WAIT-KEY, in the editor, for the first
+ * time. If the ROM traps are on a trap there says so, the fetch is seen
+ * whether the ROM is emulated or not. Otherwise a write watch on ERR_SP
+ * spots the editor starting up, it points ERR_SP at ED-ERROR on the stack
+ * just before it waits for its first key. The RAM test writes ERR_SP too,
+ * but not with anything which points at ED-ERROR.
+ *
+ * Neither of those mean anything to the 128K's ROMs, which start up into the
+ * menu, so on a 128K, or if neither can be set up, it's left to a timeout
+ * which is as long as the Spectrum can take to get going.
+ */
+#define WAIT_KEY                 ((ZX_ADDR)0x15D4)
+#define ED_ERROR                 ((ZX_ADDR)0x107F)
+#define ERR_SP                   ((ZX_ADDR)0x5C3D)
+
+#define BOOT_READY_TIMEOUT_US    ((uint32_t)3000000)
+
+static uint32_t boot_started_us = 0;
+static uint32_t boot_ready_us   = 0;
+static bool     boot_ready      = false;
+
+static uint8_t  ready_trap      = ROM_TRAP_NONE;
+static uint8_t  ready_watch     = WRITE_WATCH_NONE;
+
+static uint16_t get_mirror_word( const ZX_ADDR zx_addr )
+{
+  return get_zx_mirror_byte( zx_addr ) | (get_zx_mirror_byte( zx_addr+1 ) << 8);
+}
+
+static void set_boot_ready( void )
+{
+  if( boot_ready )
+    return;
+
+  boot_ready_us = time_us_32() - boot_started_us;
+  boot_ready    = true;
+
+  if( ready_trap != ROM_TRAP_NONE )
+    remove_rom_trap( ready_trap );
+
+  if( ready_watch != WRITE_WATCH_NONE )
+    remove_write_watch( ready_watch );
+
+  ready_trap  = ROM_TRAP_NONE;
+  ready_watch = WRITE_WATCH_NONE;
+}
+
+static void wait_key_trap( const ZX_ADDR zx_addr, void *user_data )
+{
+  set_boot_ready();
+}
+
+/*
+ * The low byte of ERR_SP is written first, so by the time the high byte's
+ * write has been seen the mirror has all of it.
+ */
+static void err_sp_written( const ZX_ADDR zx_addr, const ZX_BYTE value, void *user_data )
+{
+  if( zx_addr != ERR_SP+1 )
+    return;
+
+  if( get_mirror_word( get_mirror_word( ERR_SP ) ) == ED_ERROR )
+    set_boot_ready();
+}
+
+/*
+ * Call this just before the Z80 comes out of reset, after the ROM traps and
+ * write watches have been initialised. Anything else which wants a ROM trap
+ * should have had it by now, this one is only used if there's one spare.
+ */
+void init_boot_ready( void )
+{
+  boot_started_us = time_us_32();
+  boot_ready_us   = 0;
+  boot_ready      = false;
+
+  if( query_machine_profile()->num_rom_pages != 1 )
+    return;
+
+  if( using_rom_traps() )
+    ready_trap = add_rom_trap( WAIT_KEY, wait_key_trap, NULL );
+
+  if( ready_trap == ROM_TRAP_NONE )
+    ready_watch = add_write_watch_callback( ERR_SP, ERR_SP+1, WATCH_MATCH_ANY, 0, err_sp_written, NULL );
+}
+
+/*
+ * True once the ROM has started, or it's had long enough.
+ */
+bool is_boot_ready( void )
+{
+  if( !boot_ready && (time_us_32() - boot_started_us) >= BOOT_READY_TIMEOUT_US )
+    set_boot_ready();
+
+  return boot_ready;
+}
+
+/*
+ * How long the ROM took to get ready, from coming out of reset. Zero until it has.
+ */
+uint32_t query_boot_ready_us( void )
+{
+  return boot_ready_us;
+}
@@ -0,0 +1,36 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __BOOT_READY_H
+#define __BOOT_READY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Boot readiness. Works out when the ROM has finished starting up and is
+ * sitting in the editor waiting for a key, which is the first point anything
+ * can safely be DMAed into the Spectrum.
+ */
+void init_boot_ready( void );
+
+bool is_boot_ready( void );
+uint32_t query_boot_ready_us( void );
+
+#endif
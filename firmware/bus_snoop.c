@@ -0,0 +1,145 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+
+#include "bus_snoop.h"
+#include "zx_mirror.h"
+#include "gpios.h"
+
+#include "bus_snoop.pio.h"
+
+/*
+ * PIO based snooping of the Z80's memory writes into the mirror. See
+ * bus_snoop.pio for how it works.
+ *
+ * It can't be switched on yet. The PIO only puts the bytes into the mirror,
+ * and everything else which works off the Z80's writes needs core1 to see
+ * them: the command trigger's fence (the write sequence numbers), the dirty
+ * flags, the HALT check, the write watches, the write log and the exec
+ * profile. Core1 is needed anyway for the port snoop and 128K paging, the
+ * I/O registers and the boot ready fallback, and the PIO writes to the flat
+ * mirror, not the paged segments. With core1 running its loop regardless,
+ * the PIO saves it nothing. Nothing calls init_bus_snoop() until those have
+ * been moved off core1.
+ */
+inline uint32_t using_pio_bus_snoop( void )
+{
+#define USE_PIO_BUS_SNOOP 0
+  return USE_PIO_BUS_SNOOP;
+}
+
+#if USE_PIO_BUS_SNOOP
+#error "The PIO bus snoop leaves core1 blind to the Z80's writes, see above"
+#endif
+
+/*
+ * This needs a PIO with its GPIO base at 0 to reach the data and address
+ * buses. pio0 has its base at 16 for the int_unsafe program.
+ */
+static PIO  bus_snoop_pio;
+static uint bus_snoop_sm;
+
+static int  bus_snoop_addr_dma_channel;
+static int  bus_snoop_data_dma_channel;
+
+void init_bus_snoop( void )
+{
+  bus_snoop_pio = pio1;
+
+  bus_snoop_sm  = pio_claim_unused_sm( bus_snoop_pio, true );
+  uint offset   = pio_add_program( bus_snoop_pio, &bus_snoop_program );
+  bus_snoop_program_init( bus_snoop_pio, bus_snoop_sm, offset, GPIO_DBUS_D0, GPIO_Z80_MREQ );
+
+  bus_snoop_addr_dma_channel = dma_claim_unused_channel( true );
+  bus_snoop_data_dma_channel = dma_claim_unused_channel( true );
+
+  const uint dreq = pio_get_dreq( bus_snoop_pio, bus_snoop_sm, false );
+
+  /*
+   * The data channel moves one byte from the RX FIFO to wherever its write
+   * address has been set, then chains back to the address channel. It's not
+   * started here, the address channel triggers it by writing its write address.
+   */
+  dma_channel_config data_config = dma_channel_get_default_config( bus_snoop_data_dma_channel );
+  channel_config_set_transfer_data_size( &data_config, DMA_SIZE_8 );
+  channel_config_set_read_increment( &data_config, false );
+  channel_config_set_write_increment( &data_config, false );
+  channel_config_set_dreq( &data_config, dreq );
+  channel_config_set_chain_to( &data_config, bus_snoop_addr_dma_channel );
+  channel_config_set_high_priority( &data_config, true );
+
+  dma_channel_configure( bus_snoop_data_dma_channel,
+                         &data_config,
+                         NULL,                                  // Write address, set by the address channel
+                         &bus_snoop_pio->rxf[bus_snoop_sm],     // Read address, the FIFO register
+                         1,                                     // One byte per write
+                         false                                  // Don't start yet
+                       );
+
+  /*
+   * The address channel moves one word from the RX FIFO into the data channel's
+   * write address trigger register, which sets the data channel going.
+   */
+  dma_channel_config addr_config = dma_channel_get_default_config( bus_snoop_addr_dma_channel );
+  channel_config_set_transfer_data_size( &addr_config, DMA_SIZE_32 );
+  channel_config_set_read_increment( &addr_config, false );
+  channel_config_set_write_increment( &addr_config, false );
+  channel_config_set_dreq( &addr_config, dreq );
+  channel_config_set_high_priority( &addr_config, true );
+
+  dma_channel_configure( bus_snoop_addr_dma_channel,
+                         &addr_config,
+                         &dma_hw->ch[bus_snoop_data_dma_channel].al2_write_addr_trig,  // Write address, the data channel
+                         &bus_snoop_pio->rxf[bus_snoop_sm],                           // Read address, the FIFO register
+                         1,                                                           // One address per write
+                         true                                                         // Start immediately
+                       );
+
+  /* The PIO program's first job is to pick up the top half of the mirror's address */
+  pio_sm_put( bus_snoop_pio, bus_snoop_sm, (uintptr_t)query_zx_mirror_ptr( 0 ) >> 16 );
+
+  pio_sm_set_enabled( bus_snoop_pio, bus_snoop_sm, true );
+
+  return;
+}
+
+/*
+ * Wait until every write the PIO has seen is in the mirror. That's when the
+ * FIFO is empty and the data channel isn't halfway through a write. The PIO
+ * pushes within a few cycles of /WR going low, so by the time core0 has seen
+ * a write on the bus it's already in the FIFO or in the mirror.
+ */
+bool wait_for_bus_snoop_idle( const uint32_t timeout_us )
+{
+  const uint32_t start_us = time_us_32();
+
+  while( !pio_sm_is_rx_fifo_empty( bus_snoop_pio, bus_snoop_sm ) || dma_channel_is_busy( bus_snoop_data_dma_channel ) )
+  {
+    if( (time_us_32() - start_us) > timeout_us )
+      return false;
+  }
+
+  __dmb();
+  return true;
+}
@@ -0,0 +1,280 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "pico.h"
+#include "hardware/sync.h"
+
+#include "calc_offload.h"
+#include "rom_trap.h"
+#include "rom_sandbox.h"
+#include "zx_mirror.h"
+
+/*
+ * BASIC spends most of its time in the ROM's calculator, and a lot of that in
+ * the multiply and divide loops. The RP2350 can run the same code in a few
+ * microseconds. Rather than rewrite the calculator in C, which would never
+ * quite match the ROM's rounding, the ROM's own code is run in the ROM
+ * sandbox (see rom_sandbox.c) which reads the Spectrum's RAM from the mirror.
+ *
+ * RST 28h is diverted to a stub in the patched ROM which pushes every register
+ * and spins waiting for core0. Core0 reads the registers off the Z80's stack
+ * in the mirror and runs the ROM from 0x0028 in the sandbox until it returns
+ * past the end-calc. The sandbox's writes, the calculator stack, STKEND, the
+ * memory area and so on, are DMAed back into the Spectrum's RAM, along with
+ * the final registers over the ones the stub pushed. The stub pops those and returns to
+ * where end-calc would have. Writes into the stack below where the stub's
+ * registers are were only ever the calculator's temporary stack, and aren't
+ * copied back.
+ *
+ * If the sandbox can't finish, because of an error report, something it won't
+ * run (I/O, HALT, DI/EI...) or running too long, nothing is written back and
+ * the stub runs the real calculator with the registers it started with, so
+ * errors come out of the ROM in the usual way.
+ *
+ * Core0's main loop stops while the sandbox runs, up to a few milliseconds
+ * for the slower functions. The Z80 is waiting in the stub, so it isn't going
+ * to be sending commands in the meantime.
+ *
+ *  39A0  F5              PUSH AF
+ *  39A1  C5              PUSH BC
+ *  39A2  D5              PUSH DE
+ *  39A3  E5              PUSH HL
+ *  39A4  D9              EXX
+ *  39A5  C5              PUSH BC
+ *  39A6  D5              PUSH DE
+ *  39A7  E5              PUSH HL
+ *  39A8  D9              EXX
+ *  39A9  08              EX AF,AF'
+ *  39AA  F5              PUSH AF
+ *  39AB  08              EX AF,AF'
+ *  39AC  DD E5           PUSH IX
+ *  39AE  FD E5           PUSH IY
+ *  39B0  ED 73 F0 39     LD (PARAMS_SP),SP
+ *  39B4  00              NOP                   <- entry trap
+ *  39B5  3A F2 39        LD A,(STATUS)
+ *  39B8  A7              AND A
+ *  39B9  28 FA           JR Z,39B5
+ *  39BB  FE 82           CP STATUS_FALLBACK    <- exit trap
+ *  39BD  28 11           JR Z,39D0
+ *  39BF  (pop them all)
+ *  39CF  C9              RET
+ *  39D0  (pop them all)
+ *  39E0  C3 5B 33        JP CALCULATE
+ */
+#define FP_CALC                ((ZX_ADDR)0x0028)
+#define CALCULATE              ((ZX_ADDR)0x335B)
+
+#define CALC_STUB              ((ZX_ADDR)0x39A0)
+#define CALC_ENTRY_TRAP        ((ZX_ADDR)0x39B4)
+#define CALC_EXIT_TRAP         ((ZX_ADDR)0x39BB)
+
+/* Written by the stub, so it's in the mirror */
+#define CALC_PARAMS_SP         ((ZX_ADDR)0x39F0)
+
+/* Written by core0, so it's in the ROM image */
+#define CALC_STATUS            ((ZX_ADDR)0x39F2)
+
+#define CALC_STUB_AREA_END     ((ZX_ADDR)0x3A00)
+
+#define CALC_STATUS_BUSY       0x00
+#define CALC_STATUS_DONE       0x81
+#define CALC_STATUS_FALLBACK   0x82
+
+/* The stub's registers (see rom_sandbox.h), then the RST's return address, i.e. the literals */
+#define CALC_REG_RETURN        SANDBOX_REG_BLOCK_SIZE
+#define CALC_REG_BLOCK_SIZE    (SANDBOX_REG_BLOCK_SIZE+2)
+
+static const uint8_t fp_calc_original[] = { 0xC3, CALCULATE & 0xFF, CALCULATE >> 8 };
+
+#define CALC_POP_ALL                                 \
+  0xFD, 0xE1,                                        \
+  0xDD, 0xE1,                                        \
+  0x08, 0xF1, 0x08,                                  \
+  0xD9, 0xE1, 0xD1, 0xC1, 0xD9,                      \
+  0xE1, 0xD1, 0xC1, 0xF1
+
+static const uint8_t calc_stub[] =
+{
+  0xF5, 0xC5, 0xD5, 0xE5,
+  0xD9, 0xC5, 0xD5, 0xE5, 0xD9,
+  0x08, 0xF5, 0x08,
+  0xDD, 0xE5,
+  0xFD, 0xE5,
+  0xED, 0x73, CALC_PARAMS_SP & 0xFF, CALC_PARAMS_SP >> 8,
+  0x00,
+  0x3A, CALC_STATUS & 0xFF, CALC_STATUS >> 8,
+  0xA7,
+  0x28, 0xFA,
+  0xFE, CALC_STATUS_FALLBACK,
+  0x28, 0x11,
+  CALC_POP_ALL,
+  0xC9,
+  CALC_POP_ALL,
+  0xC3, CALCULATE & 0xFF, CALCULATE >> 8,
+};
+
+/*
+ * Literal streams made only of these aren't worth sending over, the stub
+ * costs more than the ROM takes to do them. Stack shuffling, constants, the
+ * memory area, and the sign changes.
+ */
+#define LITERAL_EXCHANGE   0x01
+#define LITERAL_DELETE     0x02
+#define LITERAL_NEGATE     0x1B
+#define LITERAL_ABS        0x2A
+#define LITERAL_DUPLICATE  0x31
+#define LITERAL_END_CALC   0x38
+#define LITERAL_STK_CONST  0xA0     // 0xA0 upwards are constants, then st-mem, then get-mem
+
+#define CALC_LITERAL_SCAN  16
+
+/*
+ * How long the sandbox is allowed. The slowest of the ROM's functions take
+ * under a hundred thousand instructions, this only stops something going
+ * round forever.
+ */
+#define CALC_MAX_STEPS     ((uint32_t)200000)
+
+/* The patched ROM, shared with the other trap stubs */
+static uint8_t *calc_rom_image = NULL;
+
+static uint32_t calc_offload_count  = 0;
+static uint32_t calc_fallback_count = 0;
+
+/*
+ * Calculator offload is off by default. It needs the ROM traps, and replaces
+ * the active ROM with the patched copy.
+ */
+inline uint32_t using_calc_offload( void )
+{
+#define USE_CALC_OFFLOAD 0
+  return USE_CALC_OFFLOAD;
+}
+
+uint32_t query_calc_offload_count( void )
+{
+  return calc_offload_count;
+}
+
+uint32_t query_calc_fallback_count( void )
+{
+  return calc_fallback_count;
+}
+
+static bool is_cheap_literal( const ZX_BYTE literal )
+{
+  return (literal == LITERAL_EXCHANGE) || (literal == LITERAL_DELETE) ||
+         (literal == LITERAL_NEGATE)   || (literal == LITERAL_ABS)    ||
+         (literal == LITERAL_DUPLICATE) || (literal >= LITERAL_STK_CONST);
+}
+
+static bool is_worth_offloading( const ZX_ADDR literals )
+{
+  for( uint32_t i=0; i < CALC_LITERAL_SCAN; i++ )
+  {
+    const ZX_BYTE literal = read_rom_sandbox_byte( literals+i );
+
+    if( literal == LITERAL_END_CALC )
+      return false;
+
+    if( !is_cheap_literal( literal ) )
+      return true;
+  }
+
+  return true;
+}
+
+/*
+ * The Z80 has done a RST 28h and is waiting in the stub with its registers
+ * pushed. Run the calculator in the sandbox, from the RST's jump at 0x0028
+ * with the stack as it was straight after the RST.
+ */
+static void calc_entry_trap( const ZX_ADDR zx_addr, void *user_data )
+{
+  if( !is_rom_trap_image_running() )
+    return;
+
+  const ZX_ADDR reg_block = get_zx_mirror_byte( CALC_PARAMS_SP ) | (get_zx_mirror_byte( CALC_PARAMS_SP+1 ) << 8);
+  uint8_t       status    = CALC_STATUS_FALLBACK;
+
+  Z80_CPU cpu;
+  start_rom_sandbox( &cpu, reg_block, FP_CALC, reg_block+CALC_REG_RETURN );
+
+  const ZX_ADDR literals = read_rom_sandbox_word( reg_block+CALC_REG_RETURN );
+  ZX_ADDR       lowest_sp;
+
+  if( is_worth_offloading( literals ) &&
+      run_rom_sandbox( &cpu, reg_block+CALC_REG_BLOCK_SIZE, CALC_MAX_STEPS, &lowest_sp ) )
+  {
+    /* The stub pops the registers, then returns to wherever end-calc would have */
+    write_rom_sandbox_word( reg_block+CALC_REG_RETURN, cpu.pc );
+
+    if( finish_rom_sandbox( &cpu, reg_block, reg_block+CALC_REG_BLOCK_SIZE, lowest_sp ) )
+      status = CALC_STATUS_DONE;
+  }
+
+  if( status == CALC_STATUS_DONE )
+    calc_offload_count++;
+  else
+    calc_fallback_count++;
+
+  __dmb();
+  calc_rom_image[CALC_STATUS] = status;
+}
+
+/*
+ * Put the stub into the patched ROM, point RST 28h at it and set the traps.
+ * Returns false if the offload can't be used.
+ */
+bool init_calc_offload( void )
+{
+  if( !using_rom_traps() )
+    return false;
+
+  uint8_t *image = open_rom_trap_image();
+  if( image == NULL )
+    return false;
+
+  if( memcmp( query_rom_trap_original()+FP_CALC, fp_calc_original, sizeof(fp_calc_original) ) != 0 )
+    return false;
+
+  if( !is_rom_trap_space_free( CALC_STUB, CALC_STUB_AREA_END ) )
+    return false;
+
+  calc_rom_image = image;
+
+  if( add_rom_trap( CALC_ENTRY_TRAP, calc_entry_trap, NULL ) == ROM_TRAP_NONE )
+    return false;
+
+  /* The stub has seen the status, core1 puts it back to busy for next time */
+  if( add_rom_release_trap( CALC_EXIT_TRAP, CALC_STATUS, CALC_STATUS_BUSY ) == ROM_TRAP_NONE )
+    return false;
+
+  memcpy( image+CALC_STUB, calc_stub, sizeof(calc_stub) );
+  image[CALC_STATUS] = CALC_STATUS_BUSY;
+
+  /* RST 28h is already a JP, only its destination changes */
+  __dmb();
+  image[FP_CALC+1] = CALC_STUB & 0xFF;
+  image[FP_CALC+2] = CALC_STUB >> 8;
+
+  return true;
+}
@@ -0,0 +1,39 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __CALC_OFFLOAD_H
+#define __CALC_OFFLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Calculator offload. The ROM's floating point calculator (RST 28h and the
+ * literal stream after it) is run on the RP2350 instead of the Z80. The ROM's
+ * own calculator code is run, in a Z80 sandbox, so the results are exactly
+ * what the Z80 would have got.
+ */
+uint32_t using_calc_offload( void );
+
+bool init_calc_offload( void );
+
+uint32_t query_calc_offload_count( void );
+uint32_t query_calc_fallback_count( void );
+
+#endif
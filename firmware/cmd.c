@@ -23,6 +23,7 @@
 #include "cmd.h"
 #include "dma_engine.h"
 #include "trace_table.h"
+#include "io_register.h"
 
 /*
  * Return a status to the Spectrum in the original DMA command structure. The
@@ -42,8 +43,12 @@ void dma_status_to_zx( ZXCOPRO_STATUS status, ZX_ADDR status_zx_addr, ZX_ADDR er
   if( dma_memory_block( &block, true ) != DMA_STATUS_OK )
   {
     dma_error_to_zx( ZXCOPRO_UNABLE_TO_RETURN_RESPONSE, status_zx_addr, error_zx_addr );
+    return;
   }
 
+  /* The I/O register follows the status in memory, so it's never ahead of it */
+  set_io_register( IO_REG_CMD_STATUS, status );
+
   return;
 }
 
@@ -75,6 +80,9 @@ void dma_error_to_zx( ZXCOPRO_STATUS error_code, ZX_ADDR status_zx_addr, ZX_ADDR
   DMA_BLOCK status_block = { (uint8_t*)&error_status, status_zx_addr, 1, 0 };
   (void)dma_memory_block( &status_block, true );
 
+  set_io_register( IO_REG_CMD_ERROR, error_code );
+  set_io_register( IO_REG_CMD_STATUS, ZXCOPRO_ERROR );
+
   return;
 }
 
@@ -34,6 +34,14 @@ typedef enum
   ZXCOPRO_PXY2SADDR,
 
   ZXCOPRO_MEMSET_LARGE,          // FIXME Still not sure if commands which run on /int should be separate or flagged
+
+  ZXCOPRO_INT_STATS,             // Fetch the missed interrupt statistics
+  ZXCOPRO_ADD_WATCH,             // Run a command when the Z80 writes to an address range
+  ZXCOPRO_REMOVE_WATCH,
+  ZXCOPRO_PAGE_SHADOW_ROM,       // Page one of the writable 16K images in at 0x0000
+  ZXCOPRO_SELECT_ROM_BANK,       // Switch the emulated ROM to a different bank of images
+  ZXCOPRO_FETCH_WRITE_LOG,       // Drain the oldest entries out of the write log
+  ZXCOPRO_SNAPSHOT,              // Make a .SNA or .Z80 snapshot from the mirror
 }
 ZXCOPRO_CMD;
 
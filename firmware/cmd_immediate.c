@@ -23,6 +23,11 @@
 #include "dma_engine.h"
 #include "zx_mirror.h"
 #include "trace_table.h"
+#include "write_watch.h"
+#include "zx_memory_management.h"
+#include "rom_bank.h"
+#include "write_log.h"
+#include "snapshot.h"
 
 /*
  * If the result of the DMA back to the Spectrum was an error, translate that
@@ -53,13 +58,47 @@ static ZXCOPRO_STATUS dma_result_to_response( DMA_STATUS dma_status )
   return ZXCOPRO_UNKNOWN;
 }
 
+/*
+ * The command structure and its arguments are copied out of the mirror once
+ * core1 is known to have caught up with the Z80's writes. The command handlers
+ * work on this copy, so nothing moves under them, and a command at the top of
+ * memory wraps round the way the Z80 sees it.
+ */
+#define CMD_SNAPSHOT_SIZE  32
+
+/* A command whose arguments run past the snapshot would be handled on stale bytes */
+#define CMD_FITS_SNAPSHOT(T) (sizeof(CMD_STRUCT) + sizeof(T) <= CMD_SNAPSHOT_SIZE)
+
+_Static_assert( CMD_FITS_SNAPSHOT(MEMSET_CMD),          "MEMSET_CMD doesn't fit the command snapshot" );
+_Static_assert( CMD_FITS_SNAPSHOT(PXY2SADDR_CMD),       "PXY2SADDR_CMD doesn't fit the command snapshot" );
+_Static_assert( CMD_FITS_SNAPSHOT(INT_STATS_CMD),       "INT_STATS_CMD doesn't fit the command snapshot" );
+_Static_assert( CMD_FITS_SNAPSHOT(ADD_WATCH_CMD),       "ADD_WATCH_CMD doesn't fit the command snapshot" );
+_Static_assert( CMD_FITS_SNAPSHOT(REMOVE_WATCH_CMD),    "REMOVE_WATCH_CMD doesn't fit the command snapshot" );
+_Static_assert( CMD_FITS_SNAPSHOT(PAGE_SHADOW_ROM_CMD), "PAGE_SHADOW_ROM_CMD doesn't fit the command snapshot" );
+_Static_assert( CMD_FITS_SNAPSHOT(SELECT_ROM_BANK_CMD), "SELECT_ROM_BANK_CMD doesn't fit the command snapshot" );
+_Static_assert( CMD_FITS_SNAPSHOT(FETCH_WRITE_LOG_CMD), "FETCH_WRITE_LOG_CMD doesn't fit the command snapshot" );
+_Static_assert( CMD_FITS_SNAPSHOT(SNAPSHOT_CMD),        "SNAPSHOT_CMD doesn't fit the command snapshot" );
+
+static uint8_t cmd_snapshot[CMD_SNAPSHOT_SIZE] __attribute__((aligned(4)));
+
+/*
+ * How long to wait for core1 to mirror the trigger write. It's normally
+ * there within a loop or two of core1, a few hundred ns.
+ */
+#define CMD_SNOOP_TIMEOUT_US  10
+
+static inline const CMD_STRUCT *query_cmd_snapshot( void )
+{
+  return (const CMD_STRUCT*)cmd_snapshot;
+}
+
 static void immediate_cmd_memset( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
 {
   /*
-   * Pick up the address in RP memory of the command structure. This returns a
-   * pointer into RP memory.
+   * Pick up the snapshot of the command structure. This is a pointer into RP
+   * memory.
    */
-  const CMD_STRUCT *cmd_ptr = query_zx_mirror_ptr( cmd_zx_addr );
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
   const uint8_t     flags   = cmd_ptr->flags;
 
   trace_table_set_cmd_args( cmd_ptr->type, flags );
@@ -67,7 +106,7 @@ static void immediate_cmd_memset( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, Z
   /* The memset command structure immediately follows the command structure */
   MEMSET_CMD *memset_cmd_ptr = (MEMSET_CMD*)((uint8_t*)cmd_ptr + sizeof( CMD_STRUCT ));
 
-  /* memset_cmd_ptr is pointing into RP memory which contains the mirror of the Spectrum's RAM */
+  /* memset_cmd_ptr is pointing into RP memory which contains the snapshot of the Spectrum's RAM */
   const ZX_BYTE  *src    = &(memset_cmd_ptr->c);
   const ZX_ADDR   zx_addr = memset_cmd_ptr->zx_addr[0] + memset_cmd_ptr->zx_addr[1]*256;
   const ZX_WORD   n       = memset_cmd_ptr->n[0] + memset_cmd_ptr->n[1]*256;
@@ -125,10 +164,10 @@ static void immediate_cmd_pxy2saddr( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr
   };
 
   /*
-   * Pick up the address in RP memory of the command structure. This returns a
-   * pointer into RP memory.
+   * Pick up the snapshot of the command structure. This is a pointer into RP
+   * memory.
    */
-  const CMD_STRUCT *cmd_ptr = query_zx_mirror_ptr( cmd_zx_addr );
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
   const uint8_t     flags   = cmd_ptr->flags;
 
   trace_table_set_cmd_args( cmd_ptr->type, flags );
@@ -136,7 +175,7 @@ static void immediate_cmd_pxy2saddr( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr
   /* The memset command structure immediately follows the command structure */
   PXY2SADDR_CMD *pxy2saddr_ptr = (PXY2SADDR_CMD*)((uint8_t*)cmd_ptr + sizeof( CMD_STRUCT ));
 
-  /* pxy2saddr_ptr is pointing into RP memory which contains the mirror of the Spectrum's RAM */
+  /* pxy2saddr_ptr is pointing into RP memory which contains the snapshot of the Spectrum's RAM */
   const ZX_BYTE  x          = pxy2saddr_ptr->x;
   const ZX_BYTE  y          = pxy2saddr_ptr->y;
   const ZX_ADDR result_addr = cmd_zx_addr + sizeof( CMD_STRUCT ) + offsetof( PXY2SADDR_CMD, result );
@@ -172,29 +211,320 @@ static void immediate_cmd_pxy2saddr( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr
   }
 }
 
-/*
- * This is the entry point for all coprocessor commands which are executed immediately.
- * The address of the command structure is expected to have been written into the
- * IMMEDIATE_CMD_TRIGGER_REG register and is passed in here.
- */
-void service_immediate_cmd( ZX_ADDR cmd_zx_addr )
+static void immediate_cmd_int_stats( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
+{
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
+  const uint8_t     flags   = cmd_ptr->flags;
+
+  trace_table_set_cmd_args( cmd_ptr->type, flags );
+
+  /* Take a copy, the DMA below could update the statistics as it runs */
+  INT_MONITOR_STATS stats       = *query_int_monitor_stats();
+  const ZX_ADDR     result_addr = cmd_zx_addr + sizeof( CMD_STRUCT ) + offsetof( INT_STATS_CMD, result );
+
+  trace_table_set_dma_args( (uint8_t*)&stats, result_addr, sizeof( stats ) );
+
+  DMA_BLOCK block = { (uint8_t*)&stats, result_addr, sizeof( stats ), 1 };
+  DMA_STATUS status;
+  if( (status=dma_memory_block( &block, true )) == DMA_STATUS_OK )
+  {
+    /* DMA the status into the ZX memory */
+    dma_status_to_zx( ZXCOPRO_OK, status_zx_addr, error_zx_addr );
+  }
+  else
+  {
+    /* DMA the error into the ZX memory */
+    dma_error_to_zx( dma_result_to_response(status), status_zx_addr, error_zx_addr );
+  }
+}
+
+static void immediate_cmd_add_watch( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
+{
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
+  const uint8_t     flags   = cmd_ptr->flags;
+
+  trace_table_set_cmd_args( cmd_ptr->type, flags );
+
+  const ADD_WATCH_CMD *add_watch_ptr = (const ADD_WATCH_CMD*)((uint8_t*)cmd_ptr + sizeof( CMD_STRUCT ));
+
+  const ZX_ADDR start       = add_watch_ptr->start[0]    + add_watch_ptr->start[1]*256;
+  const ZX_ADDR end         = add_watch_ptr->end[0]      + add_watch_ptr->end[1]*256;
+  const ZX_ADDR watched_cmd = add_watch_ptr->cmd_addr[0] + add_watch_ptr->cmd_addr[1]*256;
+  const ZX_ADDR result_addr = cmd_zx_addr + sizeof( CMD_STRUCT ) + offsetof( ADD_WATCH_CMD, result );
+
+  if( add_watch_ptr->match > WATCH_MATCH_CHANGED )
+  {
+    dma_error_to_zx( CMD_ERR_BAD_ARG, status_zx_addr, error_zx_addr );
+    return;
+  }
+
+  uint8_t watch_id = add_write_watch_cmd( start, end, (WATCH_MATCH)add_watch_ptr->match,
+                                          add_watch_ptr->match_value, watched_cmd );
+  if( watch_id == WRITE_WATCH_NONE )
+  {
+    dma_error_to_zx( CMD_ERR_BAD_ARG, status_zx_addr, error_zx_addr );
+    return;
+  }
+
+  trace_table_set_dma_args( &watch_id, result_addr, 1 );
+
+  DMA_BLOCK block = { &watch_id, result_addr, 1, 0 };
+  DMA_STATUS status;
+  if( (status=dma_memory_block( &block, true )) == DMA_STATUS_OK )
+  {
+    dma_status_to_zx( ZXCOPRO_OK, status_zx_addr, error_zx_addr );
+  }
+  else
+  {
+    dma_error_to_zx( dma_result_to_response(status), status_zx_addr, error_zx_addr );
+  }
+}
+
+static void immediate_cmd_remove_watch( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
+{
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
+  const uint8_t     flags   = cmd_ptr->flags;
+
+  trace_table_set_cmd_args( cmd_ptr->type, flags );
+
+  const REMOVE_WATCH_CMD *remove_watch_ptr = (const REMOVE_WATCH_CMD*)((uint8_t*)cmd_ptr + sizeof( CMD_STRUCT ));
+
+  if( remove_write_watch( remove_watch_ptr->watch_id ) )
+  {
+    dma_status_to_zx( ZXCOPRO_OK, status_zx_addr, error_zx_addr );
+  }
+  else
+  {
+    dma_error_to_zx( CMD_ERR_BAD_ARG, status_zx_addr, error_zx_addr );
+  }
+}
+
+static void immediate_cmd_page_shadow_rom( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
+{
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
+  const uint8_t     flags   = cmd_ptr->flags;
+
+  trace_table_set_cmd_args( cmd_ptr->type, flags );
+
+  const PAGE_SHADOW_ROM_CMD *page_shadow_rom_ptr = (const PAGE_SHADOW_ROM_CMD*)((uint8_t*)cmd_ptr + sizeof( CMD_STRUCT ));
+
+  const ZX_ADDR result_addr = cmd_zx_addr + sizeof( CMD_STRUCT ) + offsetof( PAGE_SHADOW_ROM_CMD, result );
+
+  uint8_t previous_image = query_shadow_rom_image();
+
+  if( !page_shadow_rom_image( page_shadow_rom_ptr->image ) )
+  {
+    dma_error_to_zx( CMD_ERR_BAD_ARG, status_zx_addr, error_zx_addr );
+    return;
+  }
+
+  trace_table_set_dma_args( &previous_image, result_addr, 1 );
+
+  DMA_BLOCK block = { &previous_image, result_addr, 1, 0 };
+  DMA_STATUS status;
+  if( (status=dma_memory_block( &block, true )) == DMA_STATUS_OK )
+  {
+    dma_status_to_zx( ZXCOPRO_OK, status_zx_addr, error_zx_addr );
+  }
+  else
+  {
+    dma_error_to_zx( dma_result_to_response(status), status_zx_addr, error_zx_addr );
+  }
+}
+
+static void immediate_cmd_select_rom_bank( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
 {
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
+  const uint8_t     flags   = cmd_ptr->flags;
+
+  trace_table_set_cmd_args( cmd_ptr->type, flags );
+
+  const SELECT_ROM_BANK_CMD *select_rom_bank_ptr = (const SELECT_ROM_BANK_CMD*)((uint8_t*)cmd_ptr + sizeof( CMD_STRUCT ));
+
+  const ZX_ADDR result_addr = cmd_zx_addr + sizeof( CMD_STRUCT ) + offsetof( SELECT_ROM_BANK_CMD, result );
+
+  uint8_t previous_bank = query_rom_bank();
+
+  if( !switch_rom_bank( select_rom_bank_ptr->bank ) )
+  {
+    dma_error_to_zx( CMD_ERR_BAD_ARG, status_zx_addr, error_zx_addr );
+    return;
+  }
+
+  trace_table_set_dma_args( &previous_bank, result_addr, 1 );
+
+  DMA_BLOCK block = { &previous_bank, result_addr, 1, 0 };
+  DMA_STATUS status;
+  if( (status=dma_memory_block( &block, true )) == DMA_STATUS_OK )
+  {
+    dma_status_to_zx( ZXCOPRO_OK, status_zx_addr, error_zx_addr );
+  }
+  else
+  {
+    dma_error_to_zx( dma_result_to_response(status), status_zx_addr, error_zx_addr );
+  }
+
+  /* The status has gone back, the program which asked for this is about to vanish */
+  if( select_rom_bank_ptr->reset )
+    reset_z80();
+}
+
+static void immediate_cmd_fetch_write_log( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
+{
+  static WRITE_LOG_ENTRY entries[WRITE_LOG_MAX_FETCH];
+
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
+  const uint8_t     flags   = cmd_ptr->flags;
+
+  trace_table_set_cmd_args( cmd_ptr->type, flags );
+
+  const FETCH_WRITE_LOG_CMD *fetch_ptr = (const FETCH_WRITE_LOG_CMD*)((uint8_t*)cmd_ptr + sizeof( CMD_STRUCT ));
+
+  const ZX_ADDR zx_addr     = fetch_ptr->zx_addr[0]     + fetch_ptr->zx_addr[1]*256;
+  const ZX_WORD max_entries = fetch_ptr->max_entries[0] + fetch_ptr->max_entries[1]*256;
+  const ZX_ADDR result_addr = cmd_zx_addr + sizeof( CMD_STRUCT ) + offsetof( FETCH_WRITE_LOG_CMD, result );
+
+  if( !using_write_log() || max_entries == 0 || max_entries > WRITE_LOG_MAX_FETCH )
+  {
+    dma_error_to_zx( CMD_ERR_BAD_ARG, status_zx_addr, error_zx_addr );
+    return;
+  }
+
   /*
-   * We have the start of the CMD_STRUCT in the Z80 address space. The status to the ZX from
-   * the copro goes back in a member of that structure, or maybe an error.
+   * The entries are out of the log once they're drained, if the DMA fails they're
+   * lost. The DMA isn't logged, it would only be more to fetch.
    */
-  const ZX_ADDR status_zx_addr =   cmd_zx_addr + offsetof( CMD_STRUCT, status );
-  const ZX_ADDR error_zx_addr  =   cmd_zx_addr + offsetof( CMD_STRUCT, error );
+  const uint32_t num_entries = drain_write_log( entries, max_entries );
+
+  /* ARM is little endian, the count and dropped total go straight back in Z80 order */
+  struct
+  {
+    uint16_t result;
+    uint32_t dropped;
+  } __attribute__((packed)) counts = { num_entries, query_write_log_dropped() };
+
+  skip_write_log_dma( num_entries*sizeof(WRITE_LOG_ENTRY) + sizeof( counts ) );
+
+  DMA_STATUS status = DMA_STATUS_OK;
+
+  if( num_entries != 0 )
+  {
+    trace_table_set_dma_args( (uint8_t*)entries, zx_addr, num_entries*sizeof(WRITE_LOG_ENTRY) );
+
+    DMA_BLOCK block = { .src = (uint8_t*)entries,
+                        .zx_ram_location = zx_addr,
+                        .length = num_entries*sizeof(WRITE_LOG_ENTRY),
+                        .incr = 1,
+                        .ignore_interrupt = (flags & CMD_FLAG_IGNORE_INT) };
+    status = dma_memory_block( &block, true );
+  }
+
+  if( status == DMA_STATUS_OK )
+  {
+    DMA_BLOCK block = { (uint8_t*)&counts, result_addr, sizeof( counts ), 1 };
+    status = dma_memory_block( &block, true );
+  }
+
+  if( status != DMA_STATUS_OK )
+    skip_write_log_dma( 0 );
+
+  if( status == DMA_STATUS_OK )
+  {
+    dma_status_to_zx( ZXCOPRO_OK, status_zx_addr, error_zx_addr );
+  }
+  else
+  {
+    dma_error_to_zx( dma_result_to_response(status), status_zx_addr, error_zx_addr );
+  }
+}
+
+/*
+ * Snapshot sink which keeps nothing, it counts the bytes and runs an Adler-32
+ * over them. Storage or USB would go in here when there is some.
+ */
+typedef struct _snapshot_tally
+{
+  uint32_t length;
+  uint32_t a, b;
+}
+SNAPSHOT_TALLY;
+
+#define ADLER32_MOD  65521
+
+static bool tally_snapshot_chunk( const uint8_t *data, const uint32_t length, void *user_data )
+{
+  SNAPSHOT_TALLY *tally = (SNAPSHOT_TALLY*)user_data;
+
+  for( uint32_t i=0; i < length; i++ )
+  {
+    tally->a = (tally->a + data[i]) % ADLER32_MOD;
+    tally->b = (tally->b + tally->a) % ADLER32_MOD;
+  }
+  tally->length += length;
+
+  return true;
+}
+
+static void immediate_cmd_snapshot( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
+{
+  const CMD_STRUCT *cmd_ptr = query_cmd_snapshot();
+  const uint8_t     flags   = cmd_ptr->flags;
+
+  trace_table_set_cmd_args( cmd_ptr->type, flags );
 
+  const SNAPSHOT_CMD *snapshot_ptr = (const SNAPSHOT_CMD*)((uint8_t*)cmd_ptr + sizeof( CMD_STRUCT ));
+
+  const ZX_ADDR regs_addr   = snapshot_ptr->regs_addr[0] + snapshot_ptr->regs_addr[1]*256;
+  const ZX_ADDR result_addr = cmd_zx_addr + sizeof( CMD_STRUCT ) + offsetof( SNAPSHOT_CMD, length );
+
+  ZX_REGISTERS regs;
+  if( regs_addr != 0 )
+    copy_from_zx_mirror( &regs, regs_addr, sizeof(regs) );
+
+  SNAPSHOT_TALLY tally = { 0, 1, 0 };
+
+  if( write_zx_snapshot( (SNAPSHOT_FORMAT)snapshot_ptr->format, (regs_addr != 0) ? &regs : NULL,
+                         tally_snapshot_chunk, &tally ) != SNAPSHOT_OK )
+  {
+    dma_error_to_zx( CMD_ERR_BAD_ARG, status_zx_addr, error_zx_addr );
+    return;
+  }
+
+  /* ARM is little endian, the results go straight back in Z80 order */
+  struct
+  {
+    uint32_t length;
+    uint32_t checksum;
+  } __attribute__((packed)) result = { tally.length, (tally.b << 16) | tally.a };
+
+  trace_table_set_dma_args( (uint8_t*)&result, result_addr, sizeof(result) );
+
+  DMA_BLOCK block = { (uint8_t*)&result, result_addr, sizeof( result ), 1 };
+  DMA_STATUS status;
+  if( (status=dma_memory_block( &block, true )) == DMA_STATUS_OK )
+  {
+    dma_status_to_zx( ZXCOPRO_OK, status_zx_addr, error_zx_addr );
+  }
+  else
+  {
+    dma_error_to_zx( dma_result_to_response(status), status_zx_addr, error_zx_addr );
+  }
+}
+
+/*
+ * Take a snapshot of the command structure and run whatever command it asks for.
+ * The mirror is expected to be up to date with the Z80's writes.
+ */
+static void dispatch_immediate_cmd( ZX_ADDR cmd_zx_addr, ZX_ADDR status_zx_addr, ZX_ADDR error_zx_addr )
+{
   /*
-   * Pick up the address in RP memory of the command structure and fetch the
+   * Take the snapshot of the command structure and its arguments, and fetch the
    * command type from it
    */
-  const CMD_STRUCT *cmd_ptr   = query_zx_mirror_ptr( cmd_zx_addr );
-  const ZXCOPRO_CMD cmd_type  = cmd_ptr->type;
-  const uint8_t     cmd_flags = cmd_ptr->flags;
+  copy_from_zx_mirror( cmd_snapshot, cmd_zx_addr, CMD_SNAPSHOT_SIZE );
 
-  trace_table_new_entry();
+  const CMD_STRUCT *cmd_ptr   = query_cmd_snapshot();
+  const ZXCOPRO_CMD cmd_type  = cmd_ptr->type;
 
   /*
    * OK, whatever the Z80 program has requested, that's what we want to do.
@@ -212,6 +542,41 @@ void service_immediate_cmd( ZX_ADDR cmd_zx_addr )
       immediate_cmd_pxy2saddr( cmd_zx_addr, status_zx_addr, error_zx_addr );
     }
     break;
+    case ZXCOPRO_INT_STATS:
+    {
+      immediate_cmd_int_stats( cmd_zx_addr, status_zx_addr, error_zx_addr );
+    }
+    break;
+    case ZXCOPRO_ADD_WATCH:
+    {
+      immediate_cmd_add_watch( cmd_zx_addr, status_zx_addr, error_zx_addr );
+    }
+    break;
+    case ZXCOPRO_REMOVE_WATCH:
+    {
+      immediate_cmd_remove_watch( cmd_zx_addr, status_zx_addr, error_zx_addr );
+    }
+    break;
+    case ZXCOPRO_PAGE_SHADOW_ROM:
+    {
+      immediate_cmd_page_shadow_rom( cmd_zx_addr, status_zx_addr, error_zx_addr );
+    }
+    break;
+    case ZXCOPRO_SELECT_ROM_BANK:
+    {
+      immediate_cmd_select_rom_bank( cmd_zx_addr, status_zx_addr, error_zx_addr );
+    }
+    break;
+    case ZXCOPRO_FETCH_WRITE_LOG:
+    {
+      immediate_cmd_fetch_write_log( cmd_zx_addr, status_zx_addr, error_zx_addr );
+    }
+    break;
+    case ZXCOPRO_SNAPSHOT:
+    {
+      immediate_cmd_snapshot( cmd_zx_addr, status_zx_addr, error_zx_addr );
+    }
+    break;
 
     default:
     {
@@ -221,3 +586,50 @@ void service_immediate_cmd( ZX_ADDR cmd_zx_addr )
     break;
   }
 }
+
+/*
+ * This is the entry point for all coprocessor commands which are executed immediately.
+ * The address of the command structure is expected to have been written into the
+ * IMMEDIATE_CMD_TRIGGER_REG register and is passed in here. trigger_seq is the mirror
+ * snoop sequence number from when the low byte of the trigger write was seen.
+ */
+void service_immediate_cmd( ZX_ADDR cmd_zx_addr, uint32_t trigger_seq )
+{
+  /*
+   * We have the start of the CMD_STRUCT in the Z80 address space. The status to the ZX from
+   * the copro goes back in a member of that structure, or maybe an error.
+   */
+  const ZX_ADDR status_zx_addr =   cmd_zx_addr + offsetof( CMD_STRUCT, status );
+  const ZX_ADDR error_zx_addr  =   cmd_zx_addr + offsetof( CMD_STRUCT, error );
+
+  trace_table_new_entry();
+
+  /*
+   * This is called as soon as the trigger write is seen on the bus, and core1 fills
+   * the mirror in parallel. Once core1 has mirrored the trigger's high byte, every
+   * argument the Z80 wrote before it is in the mirror too. If core1 doesn't catch up
+   * the mirror can't be trusted, so the command is refused.
+   */
+  if( !wait_for_zx_mirror_trigger_snoop( trigger_seq, CMD_SNOOP_TIMEOUT_US ) )
+  {
+    dma_error_to_zx( CMD_ERR_BAD_STRUCT, status_zx_addr, error_zx_addr );
+    return;
+  }
+
+  dispatch_immediate_cmd( cmd_zx_addr, status_zx_addr, error_zx_addr );
+}
+
+/*
+ * Entry point for a command which is run because a write watch fired. Core1
+ * only tells core0 about the watched write after it's mirrored it, so the
+ * command structure is already in the mirror and there's no need to wait.
+ */
+void service_watched_cmd( ZX_ADDR cmd_zx_addr )
+{
+  const ZX_ADDR status_zx_addr =   cmd_zx_addr + offsetof( CMD_STRUCT, status );
+  const ZX_ADDR error_zx_addr  =   cmd_zx_addr + offsetof( CMD_STRUCT, error );
+
+  trace_table_new_entry();
+
+  dispatch_immediate_cmd( cmd_zx_addr, status_zx_addr, error_zx_addr );
+}
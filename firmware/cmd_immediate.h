@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include "cmd.h"
 #include "gpios.h"
+#include "int_monitor.h"
 
 /* This is an unused location in the ROM, unlikely to be written to accidently */
 #define IMMEDIATE_CMD_TRIGGER_REG     ((uint64_t)0x386E)
@@ -34,7 +35,8 @@
 #define IMMEDIATE_CMD_TRIGGER_PATTERN_LO (IMMEDIATE_CMD_TRIGGER_REG<<GPIO_ABUS_A0)
 #define IMMEDIATE_CMD_TRIGGER_PATTERN_HI ((IMMEDIATE_CMD_TRIGGER_REG+1)<<GPIO_ABUS_A0)
 
-void    service_immediate_cmd( ZX_ADDR zx_addr );
+void    service_immediate_cmd( ZX_ADDR zx_addr, uint32_t trigger_seq );
+void    service_watched_cmd( ZX_ADDR zx_addr );
 
 /*
  * memset, memory set coprocessor command
@@ -61,4 +63,101 @@ typedef struct _pxy2saddr_cmd
   ZX_ADDR result;       /* 2 byte place to put the result (16 bit address) */
 } PXY2SADDR_CMD;
 
+/*
+ * int_stats, missed interrupt statistics coprocessor command
+ *
+ * The statistics kept by the /INT monitor are DMAed back into the result.
+ */
+typedef struct _int_stats_cmd
+{
+  INT_MONITOR_STATS result;   /* Place to put the statistics */
+} INT_STATS_CMD;
+
+/*
+ * add_watch, add a write watch coprocessor command
+ *
+ * When the Z80 writes into start...end (inclusive) and the match rule is met,
+ * the command structure at cmd_addr is run, exactly as if it had been written
+ * to IMMEDIATE_CMD_TRIGGER_REG. The watch's id goes back in result.
+ */
+typedef struct _add_watch_cmd
+{
+  uint8_t start[2];     /* Z80 16 bit, low endian first watched address */
+  uint8_t end[2];       /* Z80 16 bit, low endian last watched address */
+  uint8_t match;        /* WATCH_MATCH rule */
+  uint8_t match_value;  /* Value for WATCH_MATCH_VALUE */
+  uint8_t cmd_addr[2];  /* Z80 16 bit, low endian address of the command to run */
+  uint8_t result;       /* Watch id, for remove_watch */
+} ADD_WATCH_CMD;
+
+/*
+ * remove_watch, remove a write watch coprocessor command
+ */
+typedef struct _remove_watch_cmd
+{
+  uint8_t watch_id;     /* As returned by add_watch */
+} REMOVE_WATCH_CMD;
+
+/*
+ * page_shadow_rom, page a writable 16K image in at 0x0000 coprocessor command
+ *
+ * Only works when the ROM is being emulated with shadow ROM switched on. The
+ * image which was paged in before goes back in result.
+ */
+typedef struct _page_shadow_rom_cmd
+{
+  uint8_t image;        /* 0 to NUM_SHADOW_ROM_IMAGES-1 */
+  uint8_t result;       /* Previous image */
+} PAGE_SHADOW_ROM_CMD;
+
+/*
+ * select_rom_bank, switch the emulated ROM to another bank coprocessor command
+ *
+ * Only works when the ROM is being served from the ROM bank, i.e. full ROM
+ * emulation without the shadow ROM or the PIO ROM server. If reset is non-zero
+ * the Spectrum is reset after the result has been written back, so it boots
+ * into the new ROM. The bank which was selected before goes back in result.
+ */
+typedef struct _select_rom_bank_cmd
+{
+  uint8_t bank;         /* 0 to NUM_ROM_BANKS-1 */
+  uint8_t reset;        /* Non-zero to reset the Spectrum */
+  uint8_t result;       /* Previous bank */
+} SELECT_ROM_BANK_CMD;
+
+/*
+ * fetch_write_log, drain the write log coprocessor command
+ *
+ * Up to max_entries (no more than WRITE_LOG_MAX_FETCH) of the oldest write
+ * log entries are DMAed to zx_addr, as WRITE_LOG_ENTRYs, and taken out of
+ * the log. The number fetched goes back in result, then the number of writes
+ * which have been dropped because the log was full. Only works with the write
+ * log switched on.
+ */
+typedef struct _fetch_write_log_cmd
+{
+  uint8_t zx_addr[2];      /* Z80 16 bit, low endian address to put the entries */
+  uint8_t max_entries[2];  /* Z80 16 bit, low endian most entries to fetch */
+  uint8_t result[2];       /* Z80 16 bit, low endian number of entries fetched */
+  uint8_t dropped[4];      /* Z80 32 bit, low endian writes dropped so far */
+} FETCH_WRITE_LOG_CMD;
+
+/*
+ * snapshot, make a .SNA or .Z80 snapshot coprocessor command
+ *
+ * The coprocessor can't see the Z80's registers, so the program saves its own
+ * into memory first, laid out as a ZX_REGISTERS (see snapshot.h), with the SP
+ * and PC it wants the snapshot to carry on from. A regs_addr of 0 means they
+ * aren't known. There's nowhere on the board to keep a snapshot yet, so it's
+ * streamed through and measured: its length and Adler-32 go back in length
+ * and checksum.
+ */
+typedef struct _snapshot_cmd
+{
+  uint8_t format;          /* SNAPSHOT_FORMAT */
+  uint8_t regs_addr[2];    /* Z80 16 bit, low endian address of the saved registers */
+  uint8_t length[4];       /* Z80 32 bit, low endian length of the snapshot */
+  uint8_t checksum[4];     /* Z80 32 bit, low endian Adler-32 of the snapshot */
+} SNAPSHOT_CMD;
+
 #endif
@@ -19,6 +19,7 @@
 
 #include "hardware/gpio.h"
 #include "hardware/timer.h"
+#include "hardware/clocks.h"
 
 #include "zx_copro.h"
 #include "dma_engine.h"
@@ -26,11 +27,14 @@
 #include "gpios.h"
 #include "zx_memory_management.h"
 #include "zx_mirror.h"
+#include "machine_profile.h"
 
 #include "hardware/pio.h"
 #include "hardware/dma.h"
 #include "int_unsafe.pio.h"
 #include "trace_table.h"
+#include "int_monitor.h"
+#include "pio_rom_server.h"
 
 /* DMA queue */
 typedef struct _DMA_QUEUE_ENTRY
@@ -38,9 +42,19 @@ typedef struct _DMA_QUEUE_ENTRY
   uint8_t  *src;
   ZX_ADDR   zx_ram_location;
   uint32_t  length;
+  uint32_t  queued_at_us;
 }
 DMA_QUEUE_ENTRY;
 
+/*
+ * Queued DMAs are bulk transfers which aren't in a hurry. They're held back
+ * until core1 sees the Z80 sitting in a HALT, which is where most games spend
+ * the end of each frame waiting for the /INT. Taking the bus then costs the
+ * Z80 program nothing. A program which never HALTs would starve the queue, so
+ * after a couple of frames the DMA goes ahead anyway.
+ */
+#define DMA_QUEUE_HALT_WAIT_US ((uint32_t)40000)
+
 /* Not sure if this queue idea is going anywhere yet */
 static DMA_QUEUE_ENTRY dma_queue[1] = {0};
 void add_dma_to_queue( uint8_t *src, ZX_ADDR zx_ram_location, uint32_t length )
@@ -48,6 +62,7 @@ void add_dma_to_queue( uint8_t *src, ZX_ADDR zx_ram_location, uint32_t length )
   dma_queue[0].src             = src;
   dma_queue[0].zx_ram_location = zx_ram_location;
   dma_queue[0].length          = length;
+  dma_queue[0].queued_at_us    = time_us_32();
 }
 
 uint32_t is_dma_queue_full( void )
@@ -55,7 +70,14 @@ uint32_t is_dma_queue_full( void )
   return (dma_queue[0].src != NULL);
 }
 
-#include "z80_test_image.h"
+uint32_t is_dma_queue_entry_due( void )
+{
+  if( is_z80_halted() )
+    return true;
+
+  return ((time_us_32() - dma_queue[0].queued_at_us) >= DMA_QUEUE_HALT_WAIT_US);
+}
+
 void activate_dma_queue_entry( void )
 {
   if( dma_queue[0].src != NULL )
@@ -68,24 +90,6 @@ void activate_dma_queue_entry( void )
     dma_memory_block( &block, true );
 
     dma_queue[0].src = NULL;
-
-    // FIXME This is wrong, test image shouldn't be exposed here
-    if( 0 && using_z80_test_image() )
-    {
-      // This doesn't work, and can't work. see comments in rom_emulation.c
-      /*
-        * If we're using the Z80 test code and emulating the ROM, reset the Z80
-        * and set the flag which causes the JP 0x8000 at the start of the
-        * emulated ROM.
-        * This isn't really correct, the memory blocked DMAed above might not be
-        * the test code, it might be something else. This all needs working out.
-        */
-      set_initial_jp( 0x8000 );
-    
-      gpio_put( GPIO_RESET_Z80, 1 );
-      busy_wait_us_32( 100 );
-      gpio_put( GPIO_RESET_Z80, 0 );
-    }
   }
 }
 
@@ -96,6 +100,309 @@ void activate_dma_queue_entry( void )
  */
 static volatile uint32_t interrupt_unsafe = 0;
 
+/*
+ * Spin while the int_unsafe PIO program says a DMA now would make the Z80
+ * miss its next /INT.
+ */
+static void wait_for_interrupt_safe( void )
+{
+  /*
+   * A combination of the int_unsafe PIO program and
+   * RP2350 DMA keep this global variable updated
+   */
+  while( interrupt_unsafe )
+  {
+    gpio_put( GPIO_BLIPPER2, 1 );
+    gpio_put( GPIO_BLIPPER2, 0 );
+  };
+}
+
+/*
+ * Request the Z80's bus and, once it's been given up, take over the address,
+ * data and control lines. All the control lines are left inactive.
+ */
+static void take_zx_bus( void )
+{
+  /*
+   * Empirical testing shows the DMA initialiation setup takes at most 8.5us.
+   * That's with a 200MHz overclock, but I'm not sure that makes much difference
+   */
+
+  /* Anything the /INT monitor sees from here on is down to this DMA */
+  int_monitor_start_dma();
+
+  /* Assert bus request */
+  gpio_put( GPIO_Z80_BUSREQ, 0 );
+
+  /*
+   * Spin waiting for Z80 to acknowledge. BUSACK goes active (low) on the 
+   * rising edge of the clock - see fig8 in the Z80 manual
+   */
+  while( gpio_get( GPIO_Z80_BUSACK ) == 1 );
+
+  /* OK, we have the Z80's bus */
+
+  /* If the PIO is serving the ROM it has the data bus pins, borrow them back */
+  pio_rom_server_release_dbus();
+
+  /* RD and IORQ lines are only used by I/O cycles, they start inactive */
+  gpio_set_dir( GPIO_Z80_RD,   GPIO_OUT ); gpio_put( GPIO_Z80_RD,   1 );
+  gpio_set_dir( GPIO_Z80_IORQ, GPIO_OUT ); gpio_put( GPIO_Z80_IORQ, 1 );
+
+  /* Reset Z80 address and data bus GPIOs as outputs */
+  gpio_set_dir_out_masked( GPIO_ABUS_BITMASK );
+  gpio_set_dir_out_masked( GPIO_DBUS_BITMASK );
+
+  /* Set directions of control signals to outputs */
+  gpio_set_dir( GPIO_Z80_MREQ, GPIO_OUT ); gpio_put( GPIO_Z80_MREQ, 1 );
+  gpio_set_dir( GPIO_Z80_WR,   GPIO_OUT ); gpio_put( GPIO_Z80_WR,   1 );
+}
+
+/*
+ * Put the buses back to hi-Z and give them back to the Z80.
+ */
+static void release_zx_bus( void )
+{
+  /*
+   * Empirical testing shows this DMA teardown takes at most 1.6us.
+   */
+
+  /* DMA complete - put the address, data and control buses back to hi-Z */
+  gpio_set_dir_in_masked( GPIO_ABUS_BITMASK );
+  gpio_set_dir_in_masked( GPIO_DBUS_BITMASK );
+
+  gpio_set_dir( GPIO_Z80_MREQ, GPIO_IN );
+  gpio_set_dir( GPIO_Z80_WR,   GPIO_IN );
+  gpio_set_dir( GPIO_Z80_IORQ, GPIO_IN );
+  gpio_set_dir( GPIO_Z80_RD,   GPIO_IN );
+
+  pio_rom_server_reclaim_dbus();
+
+  /* Release bus request */
+  gpio_put( GPIO_Z80_BUSREQ, 1 );
+
+  /* Wait for ack to go inactive again */
+  while( gpio_get( GPIO_Z80_BUSACK ) == 0 );
+
+  /* Indicate DMA process complete, inactive */
+  gpio_put( GPIO_BLIPPER1, 1 );
+}
+
+/*
+ * Run a single Z80 I/O cycle on the bus, which must already be held. This
+ * follows the Z80's own I/O timings (Z80 manual fig 7) exactly, synced to the
+ * clock like the contended memory DMA. The ULA contends I/O to its own (even)
+ * ports by stopping the clock, so following the clock edges keeps the ULA happy
+ * the same way it does for contended memory.
+ *
+ *  T1  port address goes on the bus (and the data, for a write)
+ *  T2  /IORQ and /RD or /WR go low on the rising edge
+ *  TW  the automatically inserted wait state
+ *  T3  a read is sampled on the falling edge, then /IORQ and /RD or /WR go high
+ */
+static void dma_io_cycle( DMA_IO_CYCLE *io_cycle )
+{
+  /* Wait for rising edge of clock, syncs to start of T1 */
+  while( gpio_get( GPIO_Z80_CLK ) == 0 );
+
+  /* The whole 16 bits go on the address bus, the 128K paging and AY ports need the high byte */
+  gpio_put_masked( GPIO_ABUS_BITMASK, (uint32_t)io_cycle->port<<GPIO_ABUS_A0 );
+
+  if( io_cycle->read )
+  {
+    /* Let go of the data bus so the device being read can drive it */
+    gpio_set_dir_in_masked( GPIO_DBUS_BITMASK );
+  }
+  else
+  {
+    gpio_put_masked( GPIO_DBUS_BITMASK, io_cycle->value );
+  }
+
+  /* Falling edge halfway through T1, then rising edge at the start of T2 */
+  while( gpio_get( GPIO_Z80_CLK ) == 1 );
+  while( gpio_get( GPIO_Z80_CLK ) == 0 );
+
+  gpio_put( GPIO_Z80_IORQ, 0 );
+  gpio_put( io_cycle->read ? GPIO_Z80_RD : GPIO_Z80_WR, 0 );
+
+  /* Rising edge at the start of TW, then the rising edge at the start of T3 */
+  while( gpio_get( GPIO_Z80_CLK ) == 1 );
+  while( gpio_get( GPIO_Z80_CLK ) == 0 );
+  while( gpio_get( GPIO_Z80_CLK ) == 1 );
+  while( gpio_get( GPIO_Z80_CLK ) == 0 );
+
+  /* Falling edge halfway through T3 is where the Z80 samples the data bus */
+  while( gpio_get( GPIO_Z80_CLK ) == 1 );
+
+  if( io_cycle->read )
+  {
+    io_cycle->value = (gpio_get_all64() & GPIO_DBUS_BITMASK) >> GPIO_DBUS_D0;
+  }
+
+  gpio_put( GPIO_Z80_RD,   1 );
+  gpio_put( GPIO_Z80_WR,   1 );
+  gpio_put( GPIO_Z80_IORQ, 1 );
+
+  if( io_cycle->read )
+  {
+    /* Data bus back to outputs, that's the way the rest of the DMA code expects it */
+    gpio_set_dir_out_masked( GPIO_DBUS_BITMASK );
+  }
+}
+
+/*
+ * DMA a block into the Spectrum in pieces small enough for the int_unsafe
+ * guard to keep each one clear of /INT, for anything bigger than the guard
+ * allows which is sent while the Z80 has interrupts on. Each piece waits
+ * for the guard and takes the bus separately, so the Z80 runs, and takes
+ * its interrupts, in between.
+ */
+DMA_STATUS dma_memory_block_int_safe( const uint8_t *src, const ZX_ADDR zx_addr, const uint32_t length )
+{
+  uint32_t offset = 0;
+
+  while( offset < length )
+  {
+    uint32_t chunk = length - offset;
+    if( chunk > INT_SAFE_DMA_LENGTH )
+      chunk = INT_SAFE_DMA_LENGTH;
+
+    if( chunk > INT_SAFE_CONTENDED_DMA_LENGTH && zx_range_is_contended( zx_addr+offset, chunk ) )
+      chunk = INT_SAFE_CONTENDED_DMA_LENGTH;
+
+    DMA_BLOCK block = { (uint8_t*)(src+offset), zx_addr+offset, chunk, 1 };
+
+    const DMA_STATUS status = dma_memory_block( &block, true );
+    if( status != DMA_STATUS_OK )
+      return status;
+
+    offset += chunk;
+  }
+
+  return DMA_STATUS_OK;
+}
+
+/*
+ * Run a list of I/O cycles as bus master, writing ports or reading them.
+ * Values read are returned in the DMA_IO_CYCLE structures.
+ */
+DMA_STATUS dma_io_cycles( DMA_IO_CYCLE *io_cycles, const uint32_t num_io_cycles,
+                          const bool int_protection )
+{
+  if( io_cycles == NULL || num_io_cycles == 0 )
+    return DMA_STATUS_BAD_STRUCT;
+
+  if( num_io_cycles > MAX_IO_CYCLES )
+    return DMA_STATUS_TOO_MANY_IO_CYCLES;
+
+  if( int_protection )
+    wait_for_interrupt_safe();
+
+  take_zx_bus();
+
+  for( uint32_t i=0; i < num_io_cycles; i++ )
+  {
+    dma_io_cycle( &io_cycles[i] );
+  }
+
+  release_zx_bus();
+
+  int_monitor_check_dma( DMA_MODE_IO, num_io_cycles );
+
+  return DMA_STATUS_OK;
+}
+
+/*
+ * Run a single Z80 memory read cycle on the bus, which must already be held.
+ * Same idea as the I/O cycle, following the Z80's own timings (Z80 manual
+ * fig 5, the non-M1 read) so the ULA can contend it by stopping the clock.
+ *
+ *  T1  address goes on the bus, /MREQ and /RD go low on the falling edge
+ *  T2  the ULA or the 74LS logic does the RAS/CAS
+ *  T3  data is sampled on the falling edge, then /MREQ and /RD go high
+ *
+ * The data bus has to be inputs.
+ */
+static uint8_t dma_read_cycle( const ZX_ADDR zx_addr )
+{
+  /* Wait for rising edge of clock, syncs to start of T1 */
+  while( gpio_get( GPIO_Z80_CLK ) == 0 );
+
+  gpio_put_masked( GPIO_ABUS_BITMASK, (uint32_t)zx_addr<<GPIO_ABUS_A0 );
+
+  /* Falling edge halfway through T1 */
+  while( gpio_get( GPIO_Z80_CLK ) == 1 );
+
+  gpio_put( GPIO_Z80_MREQ, 0 );
+  gpio_put( GPIO_Z80_RD,   0 );
+
+  /* Rising edges at the start of T2 and T3, then the falling edge halfway through T3 */
+  while( gpio_get( GPIO_Z80_CLK ) == 0 );
+  while( gpio_get( GPIO_Z80_CLK ) == 1 );
+  while( gpio_get( GPIO_Z80_CLK ) == 0 );
+  while( gpio_get( GPIO_Z80_CLK ) == 1 );
+
+  const uint8_t value = (gpio_get_all64() & GPIO_DBUS_BITMASK) >> GPIO_DBUS_D0;
+
+  gpio_put( GPIO_Z80_RD,   1 );
+  gpio_put( GPIO_Z80_MREQ, 1 );
+
+  return value;
+}
+
+/*
+ * Read a block of Spectrum memory as bus master. What's read is the truth, so
+ * the mirror is corrected to match before the bus is given back. That has to
+ * happen while the bus is held, otherwise a write the Z80 made straight after
+ * could be overwritten in the mirror by the value from before it. The number
+ * of bytes which had to be corrected is returned in mirror_corrections, if
+ * it's not NULL.
+ */
+DMA_STATUS dma_read_block( uint8_t *dest, const ZX_ADDR zx_addr, const uint32_t length,
+                           const bool int_protection, uint32_t *mirror_corrections )
+{
+  if( dest == NULL )
+    return DMA_STATUS_BAD_STRUCT;
+
+  if( length == 0 )
+    return DMA_STATUS_TOO_SMALL;
+
+  if( length > MAX_DMA_READ_LENGTH )
+    return DMA_STATUS_TOO_BIG;
+
+  if( int_protection )
+    wait_for_interrupt_safe();
+
+  take_zx_bus();
+
+  /* Let go of the data bus so the RAM can drive it */
+  gpio_set_dir_in_masked( GPIO_DBUS_BITMASK );
+
+  for( uint32_t i=0; i < length; i++ )
+  {
+    dest[i] = dma_read_cycle( (ZX_ADDR)(zx_addr+i) );
+  }
+
+  uint32_t corrections = 0;
+  for( uint32_t i=0; i < length; i++ )
+  {
+    if( get_zx_mirror_byte( (ZX_ADDR)(zx_addr+i) ) != dest[i] )
+    {
+      put_zx_mirror_byte( (ZX_ADDR)(zx_addr+i), dest[i] );
+      corrections++;
+    }
+  }
+
+  release_zx_bus();
+
+  int_monitor_check_dma( DMA_MODE_READ, length );
+
+  if( mirror_corrections != NULL )
+    *mirror_corrections = corrections;
+
+  return DMA_STATUS_OK;
+}
+
 /*
  * I probably need to break this into 2 parts.
  * For DMAs into 0x4000-0x7FFF I need to work at the speed of the ULA. I need to work in top border
@@ -123,17 +430,39 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
   if( data_block->incr > MAX_INCR )
     return DMA_STATUS_BAD_INCR;
 
+  if( data_block->num_io_cycles > MAX_IO_CYCLES )
+    return DMA_STATUS_TOO_MANY_IO_CYCLES;
+
+  if( data_block->num_io_cycles != 0 && data_block->io_cycles == NULL )
+    return DMA_STATUS_BAD_STRUCT;
+
+  /*
+   * With I/O cycles on the end the bus is held for the bytes and the cycles,
+   * so together they have to fit in the int_unsafe guard. Contended bytes
+   * take as long as two and a bit uncontended ones, hence the scaling. If
+   * the guard isn't being waited for (see below) it doesn't matter.
+   */
+  if( data_block->num_io_cycles != 0 && !data_block->ignore_interrupt && int_protection )
+  {
+    uint32_t budget = data_block->length + data_block->num_io_cycles*IO_CYCLE_DMA_BYTES;
+    if( zx_range_is_contended( data_block->zx_ram_location, data_block->length ) )
+      budget = (data_block->length * INT_SAFE_DMA_LENGTH) / INT_SAFE_CONTENDED_DMA_LENGTH +
+               data_block->num_io_cycles*IO_CYCLE_DMA_BYTES;
+
+    if( budget > INT_SAFE_DMA_LENGTH )
+      return DMA_STATUS_TOO_MANY_IO_CYCLES;
+  }
+
   /* The mode to use is worked out with heuristics */
   DMA_MODE mode;
 
   /*
-   * If the start or end is in the contended memory, it's contended. I choose to check the
-   * end as well on the basis that it's possible to do a large transfer across the ROM space.
-   * i.e. start in upper RAM or ROM, end in screen memory, is technically possible
+   * If any of the block is in contended memory, it's contended. It's possible to do a
+   * large transfer across the ROM space, i.e. start in upper RAM or ROM, end in screen
+   * memory. Which RAM is contended depends on the machine, and on a 128K which bank
+   * is paged in.
    */ 
-  if( ((data_block->zx_ram_location >= 0x4000) && (data_block->zx_ram_location <= 0x7FFF))
-      ||
-      ((data_block->zx_ram_location+data_block->length >= 0x4000) && (data_block->zx_ram_location+data_block->length <= 0x7FFF)) )
+  if( zx_range_is_contended( data_block->zx_ram_location, data_block->length ) )
   {
     /* Contended memory, but if it's confirmed as running in top border time that's OK as long as it's small */
     if( data_block->top_border_time == true )
@@ -174,45 +503,9 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
    * and the Z80 cares, spin while it passes
    */
   if( !data_block->ignore_interrupt && int_protection )
-  {
-    /*
-     * A combination of the int_unsafe PIO program and
-     * RP2350 DMA keep this global variable updated
-     */
-    while( interrupt_unsafe )
-    {
-      gpio_put( GPIO_BLIPPER2, 1 );
-      gpio_put( GPIO_BLIPPER2, 0 );
-    };
-  }
-
-  /*
-   * Empirical testing shows the DMA initialiation setup takes at most 8.5us.
-   * That's with a 200MHz overclock, but I'm not sure that makes much difference
-   */
-
-  /* Assert bus request */
-  gpio_put( GPIO_Z80_BUSREQ, 0 );
-
-  /*
-   * Spin waiting for Z80 to acknowledge. BUSACK goes active (low) on the 
-   * rising edge of the clock - see fig8 in the Z80 manual
-   */
-  while( gpio_get( GPIO_Z80_BUSACK ) == 1 );
-
-  /* OK, we have the Z80's bus */
-
-  /* RD and IORQ lines are unused by this DMA process and stay inactive */
-  gpio_set_dir( GPIO_Z80_RD,   GPIO_OUT ); gpio_put( GPIO_Z80_RD,   1 );
-  gpio_set_dir( GPIO_Z80_IORQ, GPIO_OUT ); gpio_put( GPIO_Z80_IORQ, 1 );
-
-  /* Reset Z80 address and data bus GPIOs as outputs */
-  gpio_set_dir_out_masked( GPIO_ABUS_BITMASK );
-  gpio_set_dir_out_masked( GPIO_DBUS_BITMASK );
+    wait_for_interrupt_safe();
 
-  /* Set directions of control signals to outputs */
-  gpio_set_dir( GPIO_Z80_MREQ, GPIO_OUT ); gpio_put( GPIO_Z80_MREQ, 1 );
-  gpio_set_dir( GPIO_Z80_WR,   GPIO_OUT ); gpio_put( GPIO_Z80_WR,   1 );
+  take_zx_bus();
 
   if( mode == DMA_MODE_CONTENDED )
   {
@@ -311,7 +604,8 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
       gpio_put( GPIO_Z80_MREQ, 0 );
 
       /* Put value on the data bus */
-      gpio_put_masked( GPIO_DBUS_BITMASK, *(data_block->src+offset) );
+      const uint8_t data_byte = *(data_block->src+offset);
+      gpio_put_masked( GPIO_DBUS_BITMASK, data_byte );
       offset += data_block->incr;
 
       /*
@@ -334,7 +628,7 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
       while( gpio_get( GPIO_Z80_CLK ) == 1 );   
 
       /* Update local mirror to match the ZX RAM */
-      put_zx_mirror_byte( data_block->zx_ram_location+byte_counter, *(data_block->src+byte_counter) );
+      store_zx_mirror_byte( data_block->zx_ram_location+byte_counter, data_byte );
 
       /* Remove write and memory request */
       gpio_put( GPIO_Z80_WR,   1 );
@@ -372,7 +666,8 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
       gpio_put( GPIO_Z80_MREQ, 0 );
 
       /* Put value on the data bus */
-      gpio_put_masked( GPIO_DBUS_BITMASK, *(data_block->src+offset) );
+      const uint8_t data_byte = *(data_block->src+offset);
+      gpio_put_masked( GPIO_DBUS_BITMASK, data_byte );
       offset += data_block->incr;
 
       /*
@@ -395,7 +690,8 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
        * I need to support both the original 4116s and the modern static RAM
        * memory module boards. It turns out the 4116s are slower.
        * 
-       * Empirical testing shows it needs 37 RP2350 cycles.
+       * Empirical testing shows it needs 37 RP2350 cycles, 185ns at 200MHz,
+       * which is the machine profile's lower_ram_write_ns.
        */
       {
         __asm volatile ("nop");
@@ -446,7 +742,7 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
       /* Mirror and buses reset takes ~100ns */
 
       /* Update local mirror to match the ZX RAM */
-      put_zx_mirror_byte( data_block->zx_ram_location+byte_counter, *(data_block->src+byte_counter) );
+      store_zx_mirror_byte( data_block->zx_ram_location+byte_counter, data_byte );
 
       /* Remove write and memory request */
       gpio_put( GPIO_Z80_WR,   1 );
@@ -490,7 +786,8 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
       gpio_put( GPIO_Z80_MREQ, 0 );
 
       /* Put value on the data bus */
-      gpio_put_masked( GPIO_DBUS_BITMASK, *(data_block->src+offset) );
+      const uint8_t data_byte = *(data_block->src+offset);
+      gpio_put_masked( GPIO_DBUS_BITMASK, data_byte );
       offset += data_block->incr;
 
       /*
@@ -527,6 +824,7 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
       * of NOPs at this point, but I'm inclined to go with the theory.
       * 
       * That's the call then, at 200MHz 55 NOPs is 275ns, so 55 NOPs here.
+      * That 275ns is the machine profile's upper_ram_write_ns.
       * 
       * I would admit this is a bit hand wavy... :)
       * 
@@ -713,7 +1011,7 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
       /* Mirror and buses reset takes ~100ns */
 
       /* Update local mirror to match the ZX RAM */
-      put_zx_mirror_byte( data_block->zx_ram_location+byte_counter, *(data_block->src+byte_counter) );
+      store_zx_mirror_byte( data_block->zx_ram_location+byte_counter, data_byte );
 
       /* Remove write and memory request */
       gpio_put( GPIO_Z80_WR,   1 );
@@ -727,27 +1025,19 @@ DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
     return DMA_STATUS_CONTENTION_FAIL;
   }
 
-  /*
-   * Empirical testing shows this DMA teardown takes at most 1.6us.
-   */
-
-  /* DMA complete - put the address, data and control buses back to hi-Z */
-  gpio_set_dir_in_masked( GPIO_ABUS_BITMASK );
-  gpio_set_dir_in_masked( GPIO_DBUS_BITMASK );
-
-  gpio_set_dir( GPIO_Z80_MREQ, GPIO_IN );
-  gpio_set_dir( GPIO_Z80_WR,   GPIO_IN );
-  gpio_set_dir( GPIO_Z80_IORQ, GPIO_IN );
-  gpio_set_dir( GPIO_Z80_RD,   GPIO_IN );
+  /* Any I/O cycles tacked on the end of the transfer are done while the bus is still held */
+  for( uint32_t i=0; i < data_block->num_io_cycles; i++ )
+  {
+    dma_io_cycle( &data_block->io_cycles[i] );
+  }
 
-  /* Release bus request */
-  gpio_put( GPIO_Z80_BUSREQ, 1 );
+  release_zx_bus();
 
-  /* Wait for ack to go inactive again */
-  while( gpio_get( GPIO_Z80_BUSACK ) == 0 );
+  /* The write loops only store into the mirror, the dirty flags are done here off the clock */
+  mark_zx_mirror_dirty( data_block->zx_ram_location, data_block->length );
 
-  /* Indicate DMA process complete, inactive */
-  gpio_put( GPIO_BLIPPER1, 1 );
+  /* Check the int_unsafe guard did its job */
+  int_monitor_check_dma( mode, data_block->length );
 
   return DMA_STATUS_OK;
 }
@@ -815,8 +1105,18 @@ void init_interrupt_protection( void )
    * is. Or maybe the crystal in the 40 year old Spectrum I'm testing with has wandered
    * a bit. I could reimplement with some sort of dynamic measuring, but I think this
    * is good enough.
-   */  
-  static const uint32_t interval_countdown = 3994000-4000;
+   *
+   * The period is now measured at boot (see machine_profile.c), which also covers the
+   * 128K's 19.99ms. The countdown is that period less the guard, plus the 2,000 cycles
+   * found above, which aren't explained by the period alone, so they're kept as they
+   * were measured. On a 19.97ms frame at 200MHz this comes out at 3,994,000-4,000.
+   */
+  static const uint32_t measured_margin_cycles = 6000-4000;
+
+  const uint32_t cycles_per_us = clock_get_hz( clk_sys ) / 1000000;
+  static uint32_t interval_countdown;
+  interval_countdown = (query_measured_frame_us() - INT_UNSAFE_GUARD_US) * cycles_per_us + measured_margin_cycles;
+
   dma_channel_configure( int_interval_dma_channel,
                          &int_interval_dma_config,
                          &pio0_hw->txf[0],             // Write address, PIO's FIFO
@@ -37,11 +37,24 @@ typedef enum
   DMA_STATUS_TOP_BORDER_TOO_BIG,         // Number of bytes to DMA in top border time is too large
   DMA_STATUS_BAD_INCR,                   // An increment value is way out
   DMA_STATUS_CONTENTION_FAIL,            // DMA would clash with ULA's contention
+  DMA_STATUS_TOO_MANY_IO_CYCLES,         // Number of I/O cycles is too large, alone or with the bytes
 
   DMA_STATUS_LAST
 }
 DMA_STATUS;
 
+/*
+ * This data structure defines a single I/O cycle the DMA engine runs as bus
+ * master. e.g. port 0xFE for the border/beeper, 0x7FFD for 128K paging, or
+ * 0xFFFD/0xBFFD for the AY. For a read, the value read is returned in 'value'.
+ */
+typedef struct _dma_io_cycle
+{
+  ZX_ADDR   port;              // 16 bit port address, the full address bus is driven
+  uint8_t   value;             // Value to write, or value read
+  bool      read;              // True for an IN, false for an OUT
+} DMA_IO_CYCLE;
+
 /*
  * This data structure defines a DMA block to write to the Spectrum.
  */
@@ -54,6 +67,9 @@ typedef struct _dma_block
   bool      ignore_interrupt;  // True if the Z80 is OK to ignore interrupt protection
   bool      top_border_time;   // True if the Z80 has set the DMA to run in top border time
 
+  DMA_IO_CYCLE *io_cycles;     // Optional I/O cycles to run after the bytes, while the bus is held
+  uint32_t  num_io_cycles;     // Number of those, zero for none
+
   struct _dma_block* next_ptr; // Pointer to next one of these
 } DMA_BLOCK;
 
@@ -73,12 +89,18 @@ typedef struct _dma_block
    * uncontended means 0x8000 to 0xFFFF. This is simple and reliable, no contention
    * to worry about. But the DMA needs to run at the speed the 74-series logic chips
    * can drive the 4164s at, which is slower than the ULA drives the 4116s.
+   *
+   * io means a list of I/O cycles (see DMA_IO_CYCLE) with no memory transfer.
+   *
+   * read means reading Spectrum memory back, at Z80 speed, see dma_read_block().
    */
   typedef enum
   {
     DMA_MODE_CONTENDED,
     DMA_MODE_TOP_BORDER,
-    DMA_MODE_UNCONTENDED
+    DMA_MODE_UNCONTENDED,
+    DMA_MODE_IO,
+    DMA_MODE_READ
   }
   DMA_MODE;
 
@@ -102,14 +124,53 @@ typedef struct _dma_block
  */
 #define TOP_BORDER_MAX_LENGTH  ((uint32_t)8192)
 
+/*
+ * How long before the next /INT the int_unsafe PIO program starts holding off
+ * DMAs. See int_unsafe.pio for how this figure was arrived at.
+ */
+#define INT_UNSAFE_GUARD_US  ((uint32_t)30)
+
+/*
+ * The largest memory DMA which fits inside the int_unsafe guard. 64 bytes is
+ * what the guard was sized for (see int_unsafe.pio). Into contended memory
+ * each byte follows the Z80's write timings, about 850ns, so fewer fit.
+ */
+#define INT_SAFE_DMA_LENGTH            ((uint32_t)64)
+#define INT_SAFE_CONTENDED_DMA_LENGTH  ((uint32_t)24)
+
+/*
+ * Each I/O cycle is 4 Z80 T-states, a bit over 1us. This keeps a batch of
+ * them well inside the time the int_unsafe guard allows for.
+ */
+#define MAX_IO_CYCLES  ((uint32_t)16)
+
+/*
+ * An I/O cycle takes about as long as this many uncontended memory bytes. I/O
+ * cycles on the end of a memory DMA share the guard's time with its bytes.
+ */
+#define IO_CYCLE_DMA_BYTES  ((uint32_t)3)
+
+/*
+ * Memory reads follow the Z80's 3 T-state read cycle, so each byte is a bit
+ * under 1us. 24 of them is about 21us which, with the bus request on top,
+ * fits inside the int_unsafe guard the same way the I/O cycles do.
+ */
+#define MAX_DMA_READ_LENGTH  ((uint32_t)24)
+
 void init_dma_engine( void );
 void init_interrupt_protection( void );
 
 void add_dma_to_queue( uint8_t *src, ZX_ADDR zx_ram_location, uint32_t length );
 uint32_t is_dma_queue_full( void );
+uint32_t is_dma_queue_entry_due( void );
 void activate_dma_queue_entry( void );
 
 DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block,
                              const bool int_protection );
+DMA_STATUS dma_memory_block_int_safe( const uint8_t *src, const ZX_ADDR zx_addr, const uint32_t length );
+DMA_STATUS dma_io_cycles( DMA_IO_CYCLE *io_cycles, const uint32_t num_io_cycles,
+                          const bool int_protection );
+DMA_STATUS dma_read_block( uint8_t *dest, const ZX_ADDR zx_addr, const uint32_t length,
+                           const bool int_protection, uint32_t *mirror_corrections );
 
 #endif
@@ -0,0 +1,146 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "hardware/sync.h"
+
+#include "exec_profile.h"
+#include "machine_profile.h"
+
+/*
+ * Profiling is off by default. Core1 has to wait for each write to finish to
+ * count it once, and does a little more in every read and refresh.
+ */
+inline uint32_t using_exec_profile( void )
+{
+#define USE_EXEC_PROFILE 0
+  return USE_EXEC_PROFILE;
+}
+
+/*
+ * The histogram is 66K, so it only exists when profiling is switched on. See
+ * zx_mirror.c for where the rest of the RAM goes.
+ */
+#if USE_EXEC_PROFILE
+
+static EXEC_PROFILE exec_profile;
+
+/*
+ * Set the profile up and start it running. It runs from power on, so there's
+ * nothing for the Z80 program to do to get profiled.
+ */
+void init_exec_profile( void )
+{
+  memset( &exec_profile, 0, sizeof(exec_profile) );
+
+  exec_profile.magic        = EXEC_PROFILE_MAGIC;
+  exec_profile.pc_shift     = EXEC_PROFILE_PC_SHIFT;
+  exec_profile.num_buckets  = NUM_EXEC_PROFILE_BUCKETS;
+  exec_profile.num_pages    = NUM_EXEC_PROFILE_PAGES;
+  exec_profile.cpu_clock_hz = query_machine_profile()->cpu_clock_hz;
+
+  start_exec_profile();
+}
+
+void start_exec_profile( void )
+{
+  __dmb();
+  exec_profile.running = 1;
+}
+
+void stop_exec_profile( void )
+{
+  exec_profile.running = 0;
+  __dmb();
+}
+
+/*
+ * Zero the counts. Core1 is the only writer while it's running, so this only
+ * works with the profile stopped.
+ */
+bool clear_exec_profile( void )
+{
+  if( exec_profile.running )
+    return false;
+
+  memset( exec_profile.fetches,     0, sizeof(exec_profile.fetches) );
+  memset( exec_profile.page_reads,  0, sizeof(exec_profile.page_reads) );
+  memset( exec_profile.page_writes, 0, sizeof(exec_profile.page_writes) );
+
+  return true;
+}
+
+/*
+ * Core1 has seen a read followed by a refresh cycle.
+ */
+void __scratch_x("exec_profile_fetch") exec_profile_fetch( const ZX_ADDR zx_addr )
+{
+  if( exec_profile.running )
+    exec_profile.fetches[zx_addr >> EXEC_PROFILE_PC_SHIFT]++;
+}
+
+/*
+ * Core1 has seen a read which wasn't an opcode fetch.
+ */
+void __scratch_x("exec_profile_read") exec_profile_read( const ZX_ADDR zx_addr )
+{
+  if( exec_profile.running )
+    exec_profile.page_reads[zx_addr >> 8]++;
+}
+
+void __scratch_x("exec_profile_write") exec_profile_write( const ZX_ADDR zx_addr )
+{
+  if( exec_profile.running )
+    exec_profile.page_writes[zx_addr >> 8]++;
+}
+
+#else
+
+/* Switched off. Everything which calls these checks using_exec_profile() first. */
+void init_exec_profile( void )
+{
+}
+
+void start_exec_profile( void )
+{
+}
+
+void stop_exec_profile( void )
+{
+}
+
+bool clear_exec_profile( void )
+{
+  return false;
+}
+
+void exec_profile_fetch( const ZX_ADDR zx_addr )
+{
+}
+
+void exec_profile_read( const ZX_ADDR zx_addr )
+{
+}
+
+void exec_profile_write( const ZX_ADDR zx_addr )
+{
+}
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __EXEC_PROFILE_H
+#define __EXEC_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * Execution profile. An optional histogram of where the Z80 fetches its
+ * instructions from, built by core1 out of the bus cycles it sees anyway, so
+ * it costs the Z80 nothing. Counts of data reads and writes per 256 byte page
+ * are kept alongside. tools/exec_profile_view.c reads a dump of it and puts
+ * the hot spots against the labels from an assembler's symbol file.
+ *
+ * The /M1 line isn't wired to the RP2350, but every opcode fetch is followed
+ * straight away by a refresh cycle, which core1 does see. A read followed by
+ * a refresh is counted as a fetch, any other read as a data read. Prefixed
+ * instructions (CB, DD, ED, FD) fetch more than one opcode byte, so they show
+ * up at the address after the prefix as well. A HALTed Z80 keeps fetching from
+ * the address after the HALT, which is how time spent waiting for an /INT
+ * shows up.
+ *
+ * Addresses are as the Z80 put them on the bus. On a 128K the top 16K is
+ * whichever RAM bank was paged in, and they're all counted together.
+ *
+ * This header is shared with the viewer, so it has to stay plain C.
+ */
+#define EXEC_PROFILE_MAGIC       ((uint32_t)0x5058585A)     // "ZXXP"
+
+/*
+ * Fetches are counted in buckets of 4 bytes, which keeps the histogram down to
+ * 64K. That's enough to tell one loop from another. Exact addresses (shift 0)
+ * need 256K, which there isn't room for alongside everything else.
+ */
+#define EXEC_PROFILE_PC_SHIFT    2
+#define NUM_EXEC_PROFILE_BUCKETS (65536 >> EXEC_PROFILE_PC_SHIFT)
+#define NUM_EXEC_PROFILE_PAGES   256
+
+/*
+ * The whole profile, laid out so a binary dump of it from the debugger has
+ * everything the viewer needs. Only core1 writes the counts. At a million or
+ * so fetches a second a tight loop's bucket wraps after an hour or more.
+ */
+typedef struct _exec_profile
+{
+  uint32_t          magic;
+  uint32_t          pc_shift;
+  uint32_t          num_buckets;
+  uint32_t          num_pages;
+  uint32_t          cpu_clock_hz;
+
+  volatile uint32_t running;
+
+  uint32_t          fetches[NUM_EXEC_PROFILE_BUCKETS];
+  uint32_t          page_reads[NUM_EXEC_PROFILE_PAGES];
+  uint32_t          page_writes[NUM_EXEC_PROFILE_PAGES];
+}
+EXEC_PROFILE;
+
+uint32_t using_exec_profile( void );
+
+void init_exec_profile( void );
+void start_exec_profile( void );
+void stop_exec_profile( void );
+bool clear_exec_profile( void );
+
+/* Core1 side */
+void exec_profile_fetch( const ZX_ADDR zx_addr );
+void exec_profile_read( const ZX_ADDR zx_addr );
+void exec_profile_write( const ZX_ADDR zx_addr );
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "pico.h"
+#include "hardware/sync.h"
+
+#include "fast_boot.h"
+#include "rom_trap.h"
+#include "dma_engine.h"
+#include "zx_mirror.h"
+
+/*
+ * Most of the time the 48K ROM takes to start up goes on its RAM test, which
+ * fills every byte from 0x4000 up with 2 and then counts each one back down to
+ * zero, over half a million instructions. The only thing the rest of the ROM
+ * needs from it is the top of RAM and everything under it cleared, so the test
+ * is diverted to a stub which clears the memory by pushing zeroes, a page at
+ * a time, in a few tens of milliseconds. NEW goes through the same code, with
+ * RAMTOP as the top, so it's quicker too.
+ *
+ * The RAM test is also what finds the top of a 16K machine's RAM. There's no
+ * 16K machine profile, the stub trusts the top the ROM gives it, 0xFFFF at
+ * power on.
+ *
+ * The Z80 can't be loaded while it's held in reset, it doesn't answer /BUSREQ
+ * until it's running, so a program image is loaded once the ROM is done. The
+ * end of the start up, where the copyright message has been printed and the
+ * ROM is about to go into the editor, is diverted to a second stub which
+ * waits for core0 to DMA the image in. The stub then calls the image, with
+ * interrupts on, IY set and the stack where BASIC's will be, much as if it
+ * had been run with USR. If the image returns, or stops with an error report,
+ * BASIC carries on starting up as usual.
+ *
+ * The image only runs on the first start up after it's set, a later NEW or
+ * reset goes straight into BASIC.
+ *
+ *  Clear stub, jumped to from RAM-CHECK with the top of RAM in DE:
+ *
+ *  3B00  48              LD C,B                keep NEW's flag
+ *  3B01  62              LD H,D
+ *  3B02  6B              LD L,E
+ *  3B03  23              INC HL
+ *  3B04  7D              LD A,L                clear bytes down to a page boundary
+ *  3B05  A7              AND A
+ *  3B06  28 05           JR Z,3B0D
+ *  3B08  2B              DEC HL
+ *  3B09  36 00           LD (HL),0
+ *  3B0B  18 F7           JR 3B04
+ *  3B0D  7C              LD A,H                then whole pages down to 0x4000
+ *  3B0E  D6 40           SUB 40h
+ *  3B10  47              LD B,A
+ *  3B11  F9              LD SP,HL
+ *  3B12  21 00 00        LD HL,0
+ *  3B15  3E 04           LD A,4
+ *  3B17  E5 (x32)        PUSH HL
+ *  3B37  3D              DEC A
+ *  3B38  20 DD           JR NZ,3B17
+ *  3B3A  10 D9           DJNZ 3B15
+ *  3B3C  41              LD B,C
+ *  3B3D  62              LD H,D                HL as the RAM test leaves it
+ *  3B3E  6B              LD L,E
+ *  3B3F  23              INC HL
+ *  3B40  C3 EF 11        JP RAM-DONE
+ *
+ *  Run stub, jumped to from the end of the start up:
+ *
+ *  3B50  FD CB 02 EE     SET 5,(TV_FLAG)       what the jump replaced
+ *  3B54  00              NOP                   <- entry trap
+ *  3B55  3A F2 3B        LD A,(STATUS)
+ *  3B58  A7              AND A
+ *  3B59  28 FA           JR Z,3B55
+ *  3B5B  FE 82           CP STATUS_SKIP        <- exit trap
+ *  3B5D  C4 00 00        CALL NZ,entry         written by core0
+ *  3B60  C3 A9 12        JP MAIN-1
+ */
+#define RAM_CHECK              ((ZX_ADDR)0x11DA)
+#define RAM_DONE               ((ZX_ADDR)0x11EF)
+#define START_UP_END           ((ZX_ADDR)0x129C)
+#define MAIN_1                 ((ZX_ADDR)0x12A9)
+
+#define RAMTOP                 ((ZX_ADDR)0x5CB2)
+
+#define FAST_BOOT_CLEAR_STUB   ((ZX_ADDR)0x3B00)
+#define FAST_BOOT_RUN_STUB     ((ZX_ADDR)0x3B50)
+#define FAST_BOOT_ENTRY_TRAP   ((ZX_ADDR)0x3B54)
+#define FAST_BOOT_EXIT_TRAP    ((ZX_ADDR)0x3B5B)
+#define FAST_BOOT_RUN_ENTRY    ((ZX_ADDR)0x3B5E)
+
+/* Written by core0, so it's in the ROM image */
+#define FAST_BOOT_STATUS       ((ZX_ADDR)0x3BF2)
+
+#define FAST_BOOT_AREA_END     ((ZX_ADDR)0x3C00)
+
+#define FAST_BOOT_STATUS_BUSY  0x00
+#define FAST_BOOT_STATUS_RUN   0x81
+#define FAST_BOOT_STATUS_SKIP  0x82
+
+/* LD H,D / LD L,E / LD (HL),2 */
+static const uint8_t ram_check_original[]    = { 0x62, 0x6B, 0x36 };
+
+/* SET 5,(IY+2) */
+static const uint8_t start_up_end_original[] = { 0xFD, 0xCB, 0x02, 0xEE };
+
+#define PUSH_HL_X8   0xE5, 0xE5, 0xE5, 0xE5, 0xE5, 0xE5, 0xE5, 0xE5
+
+static const uint8_t fast_boot_clear_stub[] =
+{
+  0x48,
+  0x62, 0x6B, 0x23,
+  0x7D,
+  0xA7,
+  0x28, 0x05,
+  0x2B,
+  0x36, 0x00,
+  0x18, 0xF7,
+  0x7C,
+  0xD6, 0x40,
+  0x47,
+  0xF9,
+  0x21, 0x00, 0x00,
+  0x3E, 0x04,
+  PUSH_HL_X8, PUSH_HL_X8, PUSH_HL_X8, PUSH_HL_X8,
+  0x3D,
+  0x20, 0xDD,
+  0x10, 0xD9,
+  0x41,
+  0x62, 0x6B, 0x23,
+  0xC3, RAM_DONE & 0xFF, RAM_DONE >> 8,
+};
+
+static const uint8_t fast_boot_run_stub[] =
+{
+  0xFD, 0xCB, 0x02, 0xEE,
+  0x00,
+  0x3A, FAST_BOOT_STATUS & 0xFF, FAST_BOOT_STATUS >> 8,
+  0xA7,
+  0x28, 0xFA,
+  0xFE, FAST_BOOT_STATUS_SKIP,
+  0xC4, 0x00, 0x00,
+  0xC3, MAIN_1 & 0xFF, MAIN_1 >> 8,
+};
+
+/* The patched ROM, shared with the other trap stubs */
+static uint8_t *fast_boot_rom_image = NULL;
+static bool     fast_boot_running   = false;
+
+static const uint8_t *boot_image        = NULL;
+static ZX_ADDR        boot_image_addr   = 0;
+static uint32_t       boot_image_length = 0;
+static ZX_ADDR        boot_image_entry  = 0;
+
+/*
+ * Fast boot is off by default. It needs the ROM traps, and replaces the
+ * active ROM with the patched copy.
+ */
+inline uint32_t using_fast_boot( void )
+{
+#define USE_FAST_BOOT 0
+  return USE_FAST_BOOT;
+}
+
+/*
+ * Set the image to load and run when the ROM next finishes starting up. The
+ * image has to stay put until then. Returns false if fast boot isn't running,
+ * in which case the image will need loading some other way.
+ */
+bool set_fast_boot_image( const uint8_t *image, const ZX_ADDR zx_addr, const uint32_t length, const ZX_ADDR entry )
+{
+  if( !fast_boot_running )
+    return false;
+
+  if( image == NULL || length == 0 || zx_addr < 0x4000 || zx_addr+length > 0x10000 )
+    return false;
+
+  boot_image_addr   = zx_addr;
+  boot_image_length = length;
+  boot_image_entry  = entry;
+
+  __dmb();
+  boot_image = image;
+
+  return true;
+}
+
+bool is_fast_boot_image_pending( void )
+{
+  return (boot_image != NULL);
+}
+
+/*
+ * The image has to fit under RAMTOP, above it is the stack the stub calls
+ * it with, and the UDGs.
+ */
+static bool load_boot_image( void )
+{
+  const uint32_t ramtop = get_zx_mirror_byte( RAMTOP ) | (get_zx_mirror_byte( RAMTOP+1 ) << 8);
+
+  if( boot_image_addr+boot_image_length > ramtop+1 )
+    return false;
+
+  /* The ROM has turned interrupts on by now, so the image goes in pieces */
+  return (dma_memory_block_int_safe( boot_image, boot_image_addr, boot_image_length ) == DMA_STATUS_OK);
+}
+
+/*
+ * The ROM has finished starting up and the Z80 is waiting in the run stub.
+ * Load the image if there is one and have the stub call it.
+ */
+static void fast_boot_entry_trap( const ZX_ADDR zx_addr, void *user_data )
+{
+  if( !is_rom_trap_image_running() )
+    return;
+
+  uint8_t status = FAST_BOOT_STATUS_SKIP;
+
+  if( boot_image != NULL && load_boot_image() )
+  {
+    fast_boot_rom_image[FAST_BOOT_RUN_ENTRY]   = boot_image_entry & 0xFF;
+    fast_boot_rom_image[FAST_BOOT_RUN_ENTRY+1] = boot_image_entry >> 8;
+
+    status = FAST_BOOT_STATUS_RUN;
+  }
+
+  /* Only the once, whether it loaded or not */
+  boot_image = NULL;
+
+  __dmb();
+  fast_boot_rom_image[FAST_BOOT_STATUS] = status;
+}
+
+/*
+ * Put the stubs into the patched ROM, point the RAM test and the end of the
+ * start up at them and set the traps. This has to be done before the Z80
+ * comes out of reset. Returns false if fast boot can't be used.
+ */
+bool init_fast_boot( void )
+{
+  if( !using_rom_traps() )
+    return false;
+
+  uint8_t *image = open_rom_trap_image();
+  if( image == NULL )
+    return false;
+
+  const uint8_t *original = query_rom_trap_original();
+
+  if( memcmp( original+RAM_CHECK, ram_check_original, sizeof(ram_check_original) ) != 0 )
+    return false;
+
+  if( memcmp( original+START_UP_END, start_up_end_original, sizeof(start_up_end_original) ) != 0 )
+    return false;
+
+  if( !is_rom_trap_space_free( FAST_BOOT_CLEAR_STUB, FAST_BOOT_AREA_END ) )
+    return false;
+
+  fast_boot_rom_image = image;
+
+  if( add_rom_trap( FAST_BOOT_ENTRY_TRAP, fast_boot_entry_trap, NULL ) == ROM_TRAP_NONE )
+    return false;
+
+  /* The stub has seen the status, core1 puts it back to busy for next time */
+  if( add_rom_release_trap( FAST_BOOT_EXIT_TRAP, FAST_BOOT_STATUS, FAST_BOOT_STATUS_BUSY ) == ROM_TRAP_NONE )
+    return false;
+
+  memcpy( image+FAST_BOOT_CLEAR_STUB, fast_boot_clear_stub, sizeof(fast_boot_clear_stub) );
+  memcpy( image+FAST_BOOT_RUN_STUB,   fast_boot_run_stub,   sizeof(fast_boot_run_stub) );
+  image[FAST_BOOT_STATUS] = FAST_BOOT_STATUS_BUSY;
+
+  /* The stubs have to be in place before anything goes to them */
+  __dmb();
+  image[RAM_CHECK+1]    = FAST_BOOT_CLEAR_STUB & 0xFF;
+  image[RAM_CHECK+2]    = FAST_BOOT_CLEAR_STUB >> 8;
+  image[RAM_CHECK]      = 0xC3;
+
+  image[START_UP_END+1] = FAST_BOOT_RUN_STUB & 0xFF;
+  image[START_UP_END+2] = FAST_BOOT_RUN_STUB >> 8;
+  image[START_UP_END]   = 0xC3;
+
+  fast_boot_running = true;
+  return true;
+}
@@ -0,0 +1,40 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __FAST_BOOT_H
+#define __FAST_BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * Fast boot. The 48K ROM's RAM test, which is nearly all of the two or three
+ * seconds the Spectrum takes to start, is replaced with a quick clear, and a
+ * program image can be loaded and run as soon as the ROM has finished setting
+ * itself up, instead of some time later on an alarm.
+ */
+uint32_t using_fast_boot( void );
+
+bool init_fast_boot( void );
+
+bool set_fast_boot_image( const uint8_t *image, const ZX_ADDR zx_addr, const uint32_t length, const ZX_ADDR entry );
+bool is_fast_boot_image_pending( void );
+
+#endif
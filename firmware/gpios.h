@@ -80,6 +80,7 @@
 /* Read and write masks */
 #define RD_MASK      ((uint64_t)(0x01 << GPIO_Z80_RD))
 #define WR_MASK      ((uint64_t)(0x01 << GPIO_Z80_WR))
+#define IORQ_MASK    ((uint64_t)(0x01 << GPIO_Z80_IORQ))
 
 /* A memory write is when mem-request and write are both low */
 #define WR_MREQ_MASK ((uint64_t)((0x01 << GPIO_Z80_MREQ) | (0x01 << GPIO_Z80_WR)))
@@ -87,6 +88,15 @@
 /* A memory read is when mem-request and read are both low */
 #define RD_MREQ_MASK ((uint64_t)((0x01 << GPIO_Z80_MREQ) | (0x01 << GPIO_Z80_RD)))
 
+/* Either of the Z80's memory or I/O requests is active when this is masked and found not equal to itself */
+#define MREQ_IORQ_MASK ((uint64_t)((0x01 << GPIO_Z80_MREQ) | (0x01 << GPIO_Z80_IORQ)))
+
+/* Z80 has given up its bus when this bit is masked and found low */
+#define BUSACK_MASK  ((uint64_t)0x01 << GPIO_Z80_BUSACK)
+
+/* /INT, from the ULA */
+#define INT_MASK     ((uint64_t)(0x01 << GPIO_Z80_INT))
+
 /* Z80 is in reset when this bit is masked and found low */
 #define Z80_IN_RESET_MASK ((uint64_t)(0x01 << GPIO_Z80_RESET))
 
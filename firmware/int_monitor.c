@@ -0,0 +1,221 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+
+#include "int_monitor.h"
+#include "dma_engine.h"
+#include "trace_table.h"
+#include "gpios.h"
+
+#include "int_monitor.pio.h"
+
+/*
+ * The PIO program samples 8 pins starting at /INT. This is where BUSACK
+ * appears in those samples.
+ */
+#define BUSACK_SAMPLE_BIT  (GPIO_Z80_BUSACK - GPIO_Z80_INT)
+
+#if BUSACK_SAMPLE_BIT > 7
+#error "BUSACK must be within 8 GPIOs of /INT for the int_monitor PIO program"
+#endif
+
+static PIO      int_monitor_pio;
+static uint     int_monitor_sm;
+
+static INT_MONITOR_STATS int_monitor_stats = {0};
+
+/*
+ * The PIO can't timestamp, so the DMA does it. One channel takes each pair of
+ * samples out of the PIO's FIFO as soon as it's pushed, then chains to another
+ * which copies the timer into the matching slot of a second ring, and chains
+ * back. So each /INT's time is from when it ended, give or take a DMA transfer,
+ * however long the core takes to get round to looking. The rings are a power
+ * of 2 and aligned to their size for the DMA's ring wrap. A ring's worth is
+ * 160ms of /INTs, far longer than the main loop or any DMA leaves it.
+ */
+#define INT_MONITOR_RING_SIZE   8
+#define INT_MONITOR_RING_BYTES  (INT_MONITOR_RING_SIZE*sizeof(uint32_t))
+
+static uint32_t int_samples[INT_MONITOR_RING_SIZE] __attribute__((aligned(INT_MONITOR_RING_BYTES)));
+static uint32_t int_times_us[INT_MONITOR_RING_SIZE] __attribute__((aligned(INT_MONITOR_RING_BYTES)));
+
+static int      int_sample_dma_channel;
+static int      int_time_dma_channel;
+
+/* Next slot of the rings to be counted */
+static uint32_t int_ring_next = 0;
+
+/* Time the last /INT ended, from the timer as the DMA saw it */
+static uint32_t last_int_us = 0;
+
+/* The miss count when the DMA engine last went for the bus */
+static uint16_t missed_at_bus_take = 0;
+
+/*
+ * Count any /INT samples the DMA has put in the rings. A slot's done once its
+ * time has been written, and the time channel goes second, so it's the time
+ * channel's write address which says how far to go. The number of /INTs which
+ * were missed or overlapped by a bus request are returned.
+ */
+static void drain_int_monitor( uint32_t *missed, uint32_t *overlapped )
+{
+  *missed     = 0;
+  *overlapped = 0;
+
+  const uintptr_t written = dma_hw->ch[int_time_dma_channel].write_addr;
+  const uint32_t  end     = ((written - (uintptr_t)int_times_us) / sizeof(uint32_t)) & (INT_MONITOR_RING_SIZE-1);
+
+  while( int_ring_next != end )
+  {
+    const uint32_t samples = int_samples[int_ring_next];
+
+    /* BUSACK is active low */
+    const bool busack_at_start = ((samples >> (8+BUSACK_SAMPLE_BIT)) & 0x01) == 0;
+    const bool busack_at_end   = ((samples >> BUSACK_SAMPLE_BIT)     & 0x01) == 0;
+
+    int_monitor_stats.int_count++;
+    last_int_us = int_times_us[int_ring_next];
+
+    int_ring_next = (int_ring_next + 1) & (INT_MONITOR_RING_SIZE-1);
+
+    if( busack_at_start && busack_at_end )
+    {
+      int_monitor_stats.missed_count++;
+      (*missed)++;
+    }
+    else if( busack_at_start || busack_at_end )
+    {
+      int_monitor_stats.overlap_count++;
+      (*overlapped)++;
+    }
+  }
+}
+
+/*
+ * Called from the main loop. Anything found here happened while no DMA was
+ * running, so it's just counted.
+ */
+void poll_int_monitor( void )
+{
+  uint32_t missed, overlapped;
+  drain_int_monitor( &missed, &overlapped );
+}
+
+/*
+ * Called by the DMA engine just before it asks for the bus. The main loop
+ * only polls now and again, so there can be /INTs from before this DMA
+ * still in the PIO's FIFO. They're counted here, and the miss count noted,
+ * so only the ones which happen from here on are charged to the DMA.
+ */
+void int_monitor_start_dma( void )
+{
+  uint32_t missed, overlapped;
+  drain_int_monitor( &missed, &overlapped );
+
+  missed_at_bus_take = int_monitor_stats.missed_count;
+}
+
+/*
+ * Called by the DMA engine as soon as it's given the bus back. Any /INT the
+ * PIO saw with BUSACK active since the bus was asked for is charged to the
+ * DMA which just ran.
+ */
+void int_monitor_check_dma( const DMA_MODE mode, const uint32_t length )
+{
+  uint32_t missed, overlapped;
+  drain_int_monitor( &missed, &overlapped );
+
+  missed = (uint16_t)(int_monitor_stats.missed_count - missed_at_bus_take);
+
+  if( missed )
+  {
+    int_monitor_stats.last_missed_mode   = mode;
+    int_monitor_stats.last_missed_length = (uint16_t)length;
+
+    trace_table_set_missed_int( missed );
+  }
+}
+
+const INT_MONITOR_STATS *query_int_monitor_stats( void )
+{
+  return &int_monitor_stats;
+}
+
+uint32_t query_last_int_us( void )
+{
+  return last_int_us;
+}
+
+/*
+ * This uses the same PIO as the int_unsafe program, so it expects that to
+ * have been set up first. (That's where the PIO's GPIO base is set.)
+ */
+void init_int_monitor( void )
+{
+  int_monitor_pio = pio0;
+
+  int_monitor_sm   = pio_claim_unused_sm( int_monitor_pio, true );
+  uint offset      = pio_add_program( int_monitor_pio, &int_monitor_program );
+  int_monitor_program_init( int_monitor_pio, int_monitor_sm, offset, GPIO_Z80_INT );
+
+  int_sample_dma_channel = dma_claim_unused_channel( true );
+  int_time_dma_channel   = dma_claim_unused_channel( true );
+  int_ring_next          = 0;
+
+  /* The sample channel waits for the PIO to push, moves the word into the ring, then starts the time channel */
+  dma_channel_config sample_config = dma_channel_get_default_config( int_sample_dma_channel );
+  channel_config_set_transfer_data_size( &sample_config, DMA_SIZE_32 );
+  channel_config_set_read_increment( &sample_config, false );
+  channel_config_set_write_increment( &sample_config, true );
+  channel_config_set_ring( &sample_config, true, __builtin_ctz( INT_MONITOR_RING_BYTES ) );
+  channel_config_set_dreq( &sample_config, pio_get_dreq( int_monitor_pio, int_monitor_sm, false ) );
+  channel_config_set_chain_to( &sample_config, int_time_dma_channel );
+
+  /* The time channel runs straight away, copies the timer into its ring, then hands back */
+  dma_channel_config time_config = dma_channel_get_default_config( int_time_dma_channel );
+  channel_config_set_transfer_data_size( &time_config, DMA_SIZE_32 );
+  channel_config_set_read_increment( &time_config, false );
+  channel_config_set_write_increment( &time_config, true );
+  channel_config_set_ring( &time_config, true, __builtin_ctz( INT_MONITOR_RING_BYTES ) );
+  channel_config_set_chain_to( &time_config, int_sample_dma_channel );
+
+  dma_channel_configure( int_time_dma_channel,
+                         &time_config,
+                         int_times_us,                 // Write address, the time ring
+                         &timer_hw->timerawl,          // Read address, the timer's low word
+                         1,                            // One time per /INT
+                         false                         // Started by the sample channel
+                       );
+
+  dma_channel_configure( int_sample_dma_channel,
+                         &sample_config,
+                         int_samples,                                      // Write address, the sample ring
+                         &int_monitor_pio->rxf[int_monitor_sm],           // Read address, the FIFO register
+                         1,                                                // One word per /INT
+                         true                                              // Start now, it waits for the PIO
+                       );
+
+  pio_sm_set_enabled( int_monitor_pio, int_monitor_sm, true );
+
+  return;
+}
@@ -0,0 +1,48 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __INT_MONITOR_H
+#define __INT_MONITOR_H
+
+#include <stdint.h>
+#include "dma_engine.h"
+
+/*
+ * Missed interrupt statistics, as returned to the Z80. This is DMAed straight
+ * into Z80 memory, so it's packed and the 16 bit values are little endian.
+ */
+typedef struct __attribute__((packed)) _int_monitor_stats
+{
+  uint16_t int_count;              // /INT pulses seen (wraps)
+  uint16_t missed_count;           // /INTs with BUSACK held across the whole pulse
+  uint16_t overlap_count;          // /INTs with BUSACK held at one end of the pulse
+  uint8_t  last_missed_mode;       // DMA_MODE of the DMA which caused the last miss
+  uint16_t last_missed_length;     // Length of the DMA which caused the last miss
+}
+INT_MONITOR_STATS;
+
+void init_int_monitor( void );
+void poll_int_monitor( void );
+void int_monitor_start_dma( void );
+void int_monitor_check_dma( const DMA_MODE mode, const uint32_t length );
+
+const INT_MONITOR_STATS *query_int_monitor_stats( void );
+uint32_t query_last_int_us( void );
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "pico.h"
+
+#include "io_register.h"
+#include "zx_memory_management.h"
+
+/*
+ * Core1 reads these while the Z80's IN is on the bus, core0 and the Z80's
+ * OUTs write them. They're single bytes, so nothing needs locking. Core0
+ * shouldn't set a register the Z80 is writing to.
+ */
+static volatile uint8_t io_registers[256];
+
+/*
+ * The port core1 answers on, IO_REGISTER_PORT_NONE until one's registered.
+ * Core1 looks at it on every I/O cycle, so it's in scratch X.
+ */
+static volatile uint32_t io_register_port __scratch_x("io_register_port") = IO_REGISTER_PORT_NONE;
+
+/*
+ * The I/O registers are off by default. Core1 looks at every IN and OUT
+ * for the port when they're on.
+ */
+inline uint32_t using_io_registers( void )
+{
+#define USE_IO_REGISTERS 0
+  return USE_IO_REGISTERS;
+}
+
+void init_io_registers( void )
+{
+  for( uint32_t i=0; i < 256; i++ )
+    io_registers[i] = 0;
+
+  io_registers[IO_REG_ID]      = ZXCOPRO_IO_ID;
+  io_registers[IO_REG_VERSION] = ZXCOPRO_IO_VERSION;
+
+  io_register_port = IO_REGISTER_PORT_NONE;
+}
+
+/*
+ * Have core1 answer INs and take OUTs on the given port. It's refused if core1
+ * isn't running its bus loop, since nothing would answer, and for even ports,
+ * which the ULA answers.
+ */
+bool register_io_register_port( const uint8_t port )
+{
+  if( !using_io_registers() || !is_core1_running() )
+    return false;
+
+  if( (port & 0x01) == 0 )
+    return false;
+
+  io_register_port = port;
+  return true;
+}
+
+uint32_t query_io_register_port( void )
+{
+  return io_register_port;
+}
+
+void set_io_register( const uint8_t reg, const uint8_t value )
+{
+  io_registers[reg] = value;
+}
+
+uint8_t query_io_register( const uint8_t reg )
+{
+  return io_registers[reg];
+}
+
+/*
+ * Same screen address as the pxy2saddr command. The Y coordinate's bits are
+ * rearranged 76 210 543 into the address's high byte and bits 5-7 of the low.
+ */
+static void __scratch_x("update_io_saddr") update_io_saddr( void )
+{
+  const uint32_t x = io_registers[IO_REG_PXY_X];
+  const uint32_t y = io_registers[IO_REG_PXY_Y];
+
+  uint32_t saddr = 0x0000;
+  if( y <= 191 )
+    saddr = 0x4000 | ((y & 0xC0) << 5) | ((y & 0x07) << 8) | ((y & 0x38) << 2) | (x >> 3);
+
+  io_registers[IO_REG_SADDR_LO] = saddr & 0xFF;
+  io_registers[IO_REG_SADDR_HI] = saddr >> 8;
+}
+
+/*
+ * Core1 calls this for every IN and OUT. Only the low byte of the port picks
+ * the coprocessor, the high byte is the register.
+ */
+bool __scratch_x("is_io_register_port") is_io_register_port( const uint32_t address )
+{
+  return (address & 0xFF) == io_register_port;
+}
+
+/*
+ * Core1 calls this with an IN on the bus, it needs to be quick.
+ */
+inline uint8_t __scratch_x("read_io_register") read_io_register( const uint8_t reg )
+{
+  return io_registers[reg];
+}
+
+/*
+ * Core1 calls this for an OUT to the port. The screen address is worked out
+ * there and then, it's ready long before the Z80 can get an IN in.
+ */
+void __scratch_x("write_io_register") write_io_register( const uint8_t reg, const uint8_t value )
+{
+  if( reg < IO_REG_FIRST_WRITABLE )
+    return;
+
+  io_registers[reg] = value;
+
+  if( reg == IO_REG_PXY_X || reg == IO_REG_PXY_Y )
+    update_io_saddr();
+}
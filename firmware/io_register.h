@@ -0,0 +1,92 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __IO_REGISTER_H
+#define __IO_REGISTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * I/O registers. The coprocessor answers IN instructions on its own port
+ * directly, core1 puts the register's value on the data bus the same way it
+ * serves the ROM. The port's low byte picks the coprocessor, the high byte
+ * is the register number, so from Z80 code it's:
+ *
+ *   LD BC,(IO_REG_SADDR_LO << 8) | ZXCOPRO_IO_PORT
+ *   IN A,(C)
+ *
+ * There's no bus request, so a status or a small answer comes back in the
+ * time of an IN instead of a DMA.
+ *
+ * The port is registered once core1 is running, see register_io_register_port().
+ * The default, 0x7F, has A0 to A6 high, so the ULA (A0), 128K AY (A1), ZX
+ * Printer (A2), Interface 1 (A3, A4) and Kempston joystick (A5) don't answer
+ * it. It's the Fuller box's joystick port though, so with one of those
+ * plugged in pick another odd port nothing else on the bus decodes, and build
+ * the Z80 programs with the same.
+ */
+#define ZXCOPRO_IO_PORT           0x7F
+
+/* No port registered, nothing on the 8 bit port address matches it */
+#define IO_REGISTER_PORT_NONE     ((uint32_t)0x100)
+
+#define ZXCOPRO_IO_ID             0x5A     // 'Z', so a Z80 program can see the coprocessor is there
+#define ZXCOPRO_IO_VERSION        1
+
+/*
+ * The registers below IO_REG_FIRST_WRITABLE can only be read by the Z80. The
+ * rest it can OUT to as well, 0x80 upwards are free for Z80 programs and
+ * firmware features to pass values through.
+ */
+typedef enum
+{
+  IO_REG_ID             = 0x00,
+  IO_REG_VERSION        = 0x01,
+  IO_REG_SADDR_LO       = 0x02,    // Screen address of the pixel at IO_REG_PXY_X,IO_REG_PXY_Y,
+  IO_REG_SADDR_HI       = 0x03,    // 0x0000 if Y is off the screen
+
+  IO_REG_FIRST_WRITABLE = 0x10,
+
+  IO_REG_CMD_STATUS     = 0x10,    // Status of the last command, once it's DMAed back. Clear it first
+  IO_REG_CMD_ERROR      = 0x11,    // Error code, if it failed
+  IO_REG_PXY_X          = 0x12,
+  IO_REG_PXY_Y          = 0x13,
+
+  IO_REG_USER           = 0x80,
+}
+IO_REGISTER;
+
+uint32_t using_io_registers( void );
+
+void init_io_registers( void );
+
+/* Core0 side */
+bool register_io_register_port( const uint8_t port );
+uint32_t query_io_register_port( void );
+void set_io_register( const uint8_t reg, const uint8_t value );
+uint8_t query_io_register( const uint8_t reg );
+
+/* Core1 side */
+bool is_io_register_port( const uint32_t address );
+uint8_t read_io_register( const uint8_t reg );
+void write_io_register( const uint8_t reg, const uint8_t value );
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+
+#include "machine_profile.h"
+#include "gpios.h"
+
+static const ZX_MACHINE_PROFILE machine_profiles[ZX_MACHINE_LAST] =
+{
+  /* Issue 2 and issue 3 boards have the same timings and the same ROM */
+  { .machine            = ZX_MACHINE_48K,
+    .name               = "48K",
+    .cpu_clock_hz       = 3500000,
+    .frame_tstates      = 69888,
+    .tstates_per_line   = 224,
+    .lines_per_frame    = 312,
+    .num_rom_pages      = 1,
+    .rom_checksum       = 0x6414,
+    .num_ram_banks      = 3,
+    .contended_banks    = 0x00,
+    .lower_ram_write_ns = 185,
+    .upper_ram_write_ns = 275 },
+
+  /*
+   * The grey +2 is a 128K in a different case, so this covers both. There's
+   * no 128K ROM image in the tree to take a checksum from, so a 128K is only
+   * ever picked by its frame period.
+   */
+  { .machine            = ZX_MACHINE_128K,
+    .name               = "128K",
+    .cpu_clock_hz       = 3546900,
+    .frame_tstates      = 70908,
+    .tstates_per_line   = 228,
+    .lines_per_frame    = 311,
+    .num_rom_pages      = 2,
+    .rom_checksum       = 0,
+    .num_ram_banks      = 8,
+    .contended_banks    = 0xAA,
+    .lower_ram_write_ns = 185,
+    .upper_ram_write_ns = 275 },
+};
+
+/*
+ * Set this to one of the ZX_MACHINE values to skip the detection and force a
+ * particular profile. Leave it at ZX_MACHINE_LAST to detect at boot.
+ */
+#define MACHINE_PROFILE_OVERRIDE  ZX_MACHINE_LAST
+
+static const ZX_MACHINE_PROFILE *machine_profile = &machine_profiles[ZX_MACHINE_48K];
+
+/* /INT to /INT period as measured at boot, 0 if it couldn't be measured */
+static uint32_t measured_frame_us = 0;
+
+/*
+ * The RAM bank paged in at 0xC000. On a 48K that's always bank 0 (i.e. the
+ * plain 0x8000-0xFFFF RAM). On a 128K it follows the paging latch.
+ */
+static uint8_t paged_ram_bank = 0;
+
+#define FRAME_MEASUREMENT_FRAMES      8
+#define FRAME_MEASUREMENT_TIMEOUT_US  ((uint32_t)100000)
+
+/*
+ * Wait for the next falling edge of the ULA's /INT. Returns false if one
+ * doesn't arrive within the timeout.
+ */
+static bool wait_for_int_falling_edge( void )
+{
+  const uint32_t start_us = time_us_32();
+
+  while( gpio_get( GPIO_Z80_INT ) == 0 )
+  {
+    if( (time_us_32() - start_us) > FRAME_MEASUREMENT_TIMEOUT_US )
+      return false;
+  }
+
+  while( gpio_get( GPIO_Z80_INT ) == 1 )
+  {
+    if( (time_us_32() - start_us) > FRAME_MEASUREMENT_TIMEOUT_US )
+      return false;
+  }
+
+  return true;
+}
+
+/*
+ * Time a few frames worth of /INTs. The ULA generates these whether the Z80 is
+ * in reset or not, so this can be done at boot before the Spectrum is let go.
+ * Returns the average period in microseconds, or 0 if there's no /INT signal.
+ */
+static uint32_t measure_frame_period_us( void )
+{
+  if( !wait_for_int_falling_edge() )
+    return 0;
+
+  const uint32_t start_us = time_us_32();
+
+  for( uint32_t i=0; i < FRAME_MEASUREMENT_FRAMES; i++ )
+  {
+    if( !wait_for_int_falling_edge() )
+      return 0;
+  }
+
+  return (time_us_32() - start_us) / FRAME_MEASUREMENT_FRAMES;
+}
+
+/*
+ * Work out which Spectrum this is. The frame period tells a 48K from a 128K.
+ * The ROM checksum, where it's known (i.e. when the ROM is being emulated),
+ * is used to confirm which ROM is in play. Pass 0 if it isn't known.
+ */
+void select_machine_profile( const uint16_t rom_checksum )
+{
+  measured_frame_us = measure_frame_period_us();
+
+  if( MACHINE_PROFILE_OVERRIDE != ZX_MACHINE_LAST )
+  {
+    machine_profile = &machine_profiles[MACHINE_PROFILE_OVERRIDE];
+    return;
+  }
+
+  /* A ROM checksum which matches one of the profiles is the strongest evidence there is */
+  if( rom_checksum != 0 )
+  {
+    for( uint32_t i=0; i < ZX_MACHINE_LAST; i++ )
+    {
+      if( machine_profiles[i].rom_checksum != 0 && machine_profiles[i].rom_checksum == rom_checksum )
+      {
+        machine_profile = &machine_profiles[i];
+        return;
+      }
+    }
+  }
+
+  if( measured_frame_us > FRAME_PERIOD_128K_THRESHOLD_US )
+    machine_profile = &machine_profiles[ZX_MACHINE_128K];
+  else
+    machine_profile = &machine_profiles[ZX_MACHINE_48K];
+
+  return;
+}
+
+const ZX_MACHINE_PROFILE *query_machine_profile( void )
+{
+  return machine_profile;
+}
+
+/*
+ * The frame period as measured at boot. If it couldn't be measured, this is
+ * the nominal value from the profile.
+ */
+uint32_t query_measured_frame_us( void )
+{
+  if( measured_frame_us != 0 )
+    return measured_frame_us;
+
+  return (uint32_t)(((uint64_t)machine_profile->frame_tstates * 1000000) / machine_profile->cpu_clock_hz);
+}
+
+void set_paged_ram_bank( const uint8_t bank )
+{
+  paged_ram_bank = bank;
+}
+
+/*
+ * Does a range which doesn't wrap (i.e. ends at or before 0xFFFF) touch
+ * contended RAM?
+ */
+static bool zx_span_is_contended( const uint32_t start, const uint32_t end )
+{
+  if( start <= 0x7FFF && end >= 0x4000 )
+    return true;
+
+  if( machine_profile->contended_banks & (1 << paged_ram_bank) )
+  {
+    if( end >= 0xC000 )
+      return true;
+  }
+
+  return false;
+}
+
+/*
+ * Does any part of the given range of Z80 memory fall in RAM the ULA contends?
+ * 0x4000-0x7FFF is always bank 5 on a 128K and the only contended RAM on a
+ * 48K. 0xC000-0xFFFF is contended if the bank paged in there is.
+ *
+ * The DMA wraps at 0xFFFF the way the Z80's address bus does, so a range which
+ * runs off the top is split in two, the part up to 0xFFFF and the part from
+ * 0x0000. 64K or more covers everything, 0x4000 included.
+ */
+bool zx_range_is_contended( const ZX_ADDR zx_addr, const uint32_t length )
+{
+  if( length == 0 )
+    return false;
+
+  if( length >= 0x10000 )
+    return true;
+
+  const uint32_t start = zx_addr;
+  const uint32_t end   = start + length - 1;
+
+  if( end <= 0xFFFF )
+    return zx_span_is_contended( start, end );
+
+  return zx_span_is_contended( start, 0xFFFF ) || zx_span_is_contended( 0x0000, end & 0xFFFF );
+}
@@ -0,0 +1,81 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __MACHINE_PROFILE_H
+#define __MACHINE_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+typedef enum
+{
+  ZX_MACHINE_48K,
+  ZX_MACHINE_128K,
+
+  ZX_MACHINE_LAST
+}
+ZX_MACHINE;
+
+/*
+ * Everything the firmware needs to know about the timings and memory layout of
+ * the Spectrum it's plugged into. The frame timings come from Smith's ULA book
+ * and the 128K technical docs.
+ */
+typedef struct _zx_machine_profile
+{
+  ZX_MACHINE  machine;
+  const char *name;
+
+  uint32_t    cpu_clock_hz;          // Z80 clock
+  uint32_t    frame_tstates;         // T-states from /INT to /INT
+  uint32_t    tstates_per_line;      // T-states per scan line, frame_tstates is this times lines_per_frame
+  uint32_t    lines_per_frame;       // Scan lines from /INT to /INT, borders and retrace included
+
+  uint32_t    num_rom_pages;         // Number of 16K ROMs which can appear at 0x0000
+  uint16_t    rom_checksum;          // 16 bit sum of the (first) ROM, 0 if not known
+
+  uint32_t    num_ram_banks;         // Number of 16K RAM banks
+  uint8_t     contended_banks;       // Bitmask of the contended RAM banks which can be paged in
+                                     // at 0xC000. 0x4000-0x7FFF is always contended.
+
+  /*
+   * DRAM write timings, in ns, for the lower (ULA driven) and upper (74LS logic
+   * driven) RAM. These aren't used by the DMA loops yet, which are tuned with
+   * NOPs against a 48K, but they're what the NOP counts were worked out from.
+   */
+  uint32_t    lower_ram_write_ns;
+  uint32_t    upper_ram_write_ns;
+}
+ZX_MACHINE_PROFILE;
+
+/*
+ * 48K and 128K frames differ by about 24us, so a measured frame period either
+ * side of this tells them apart.
+ */
+#define FRAME_PERIOD_128K_THRESHOLD_US  ((uint32_t)19980)
+
+void select_machine_profile( const uint16_t rom_checksum );
+const ZX_MACHINE_PROFILE *query_machine_profile( void );
+uint32_t query_measured_frame_us( void );
+
+void set_paged_ram_bank( const uint8_t bank );
+bool zx_range_is_contended( const ZX_ADDR zx_addr, const uint32_t length );
+
+#endif
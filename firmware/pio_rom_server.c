@@ -0,0 +1,163 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+
+#include "pio_rom_server.h"
+#include "gpios.h"
+
+#include "pio_rom_server.pio.h"
+
+/*
+ * PIO based ROM serving. See pio_rom_server.pio for how it works.
+ *
+ * Core1's spin loop only just makes the Z80's read deadline at 200MHz. This
+ * has the data on the bus in a fixed 35 or so system clocks from /MREQ, which
+ * is well inside the deadline at the stock clock. Core1 carries on mirroring
+ * writes, but doesn't serve ROM reads when this is in use.
+ */
+inline uint32_t using_pio_rom_server( void )
+{
+#define USE_PIO_ROM_SERVER 0
+  return USE_PIO_ROM_SERVER;
+}
+
+/* pio1 has its GPIO base at 0, so it can reach the data and address buses */
+static PIO  rom_server_pio;
+static uint rom_server_sm;
+
+static int  rom_server_addr_dma_channel;
+static int  rom_server_data_dma_channel;
+
+static bool rom_server_running = false;
+
+/*
+ * A 16K aligned home for a copy of the ROM, for when the image being served
+ * isn't already aligned. Only there when the PIO ROM server is switched on.
+ * See zx_mirror.c for where the rest of the RAM goes.
+ */
+#if USE_PIO_ROM_SERVER
+static uint8_t rom_server_image[PIO_ROM_SERVER_ALIGNMENT] __attribute__((aligned(PIO_ROM_SERVER_ALIGNMENT)));
+#endif
+
+uint8_t *query_pio_rom_server_image( void )
+{
+#if USE_PIO_ROM_SERVER
+  return rom_server_image;
+#else
+  return NULL;
+#endif
+}
+
+/*
+ * Start serving ROM reads from the given image, which has to be 16K aligned.
+ * Returns false if it isn't.
+ */
+bool init_pio_rom_server( const uint8_t *rom_image )
+{
+  if( ((uintptr_t)rom_image & (PIO_ROM_SERVER_ALIGNMENT-1)) != 0 )
+    return false;
+
+  rom_server_pio = pio1;
+
+  rom_server_sm = pio_claim_unused_sm( rom_server_pio, true );
+  uint offset   = pio_add_program( rom_server_pio, &pio_rom_server_program );
+  pio_rom_server_program_init( rom_server_pio, rom_server_sm, offset, GPIO_DBUS_D0, GPIO_Z80_RD );
+
+  rom_server_addr_dma_channel = dma_claim_unused_channel( true );
+  rom_server_data_dma_channel = dma_claim_unused_channel( true );
+
+  /*
+   * The data channel moves one byte from wherever its read address has been set
+   * to the TX FIFO, then chains back to the address channel. The address channel
+   * starts it by writing its read address.
+   */
+  dma_channel_config data_config = dma_channel_get_default_config( rom_server_data_dma_channel );
+  channel_config_set_transfer_data_size( &data_config, DMA_SIZE_8 );
+  channel_config_set_read_increment( &data_config, false );
+  channel_config_set_write_increment( &data_config, false );
+  channel_config_set_dreq( &data_config, pio_get_dreq( rom_server_pio, rom_server_sm, true ) );
+  channel_config_set_chain_to( &data_config, rom_server_addr_dma_channel );
+  channel_config_set_high_priority( &data_config, true );
+
+  dma_channel_configure( rom_server_data_dma_channel,
+                         &data_config,
+                         &rom_server_pio->txf[rom_server_sm],   // Write address, the FIFO register
+                         NULL,                                  // Read address, set by the address channel
+                         1,                                     // One byte per read
+                         false                                  // Don't start yet
+                       );
+
+  /*
+   * The address channel moves one word from the RX FIFO into the data channel's
+   * read address trigger register, which sets the data channel going.
+   */
+  dma_channel_config addr_config = dma_channel_get_default_config( rom_server_addr_dma_channel );
+  channel_config_set_transfer_data_size( &addr_config, DMA_SIZE_32 );
+  channel_config_set_read_increment( &addr_config, false );
+  channel_config_set_write_increment( &addr_config, false );
+  channel_config_set_dreq( &addr_config, pio_get_dreq( rom_server_pio, rom_server_sm, false ) );
+  channel_config_set_high_priority( &addr_config, true );
+
+  dma_channel_configure( rom_server_addr_dma_channel,
+                         &addr_config,
+                         &dma_hw->ch[rom_server_data_dma_channel].al3_read_addr_trig,  // Write address, the data channel
+                         &rom_server_pio->rxf[rom_server_sm],                         // Read address, the FIFO register
+                         1,                                                           // One address per read
+                         true                                                         // Start immediately
+                       );
+
+  /* The PIO program's first job is to pick up the top 18 bits of the image's address */
+  pio_sm_put( rom_server_pio, rom_server_sm, (uintptr_t)rom_image >> 14 );
+
+  pio_sm_set_enabled( rom_server_pio, rom_server_sm, true );
+
+  rom_server_running = true;
+  return true;
+}
+
+/*
+ * The PIO's output enables, one bit per GPIO from its base of 0, so the data
+ * bus is bits 0-7. Core1 watches these to time the PIO's ROM bytes, see
+ * zx_memory_management.c.
+ */
+const volatile uint32_t *query_pio_rom_server_padoe( void )
+{
+  return &pio1->dbg_padoe;
+}
+
+/*
+ * The data bus pins belong to the PIO while it's serving ROM. The DMA engine
+ * drives them from the CPU while it has the Z80's bus, so it borrows them back
+ * with these. The Z80 isn't reading while it's given up its bus, so the PIO
+ * has nothing to serve in the meantime.
+ */
+void pio_rom_server_release_dbus( void )
+{
+  if( rom_server_running )
+    gpio_set_function_masked( GPIO_DBUS_BITMASK, GPIO_FUNC_SIO );
+}
+
+void pio_rom_server_reclaim_dbus( void )
+{
+  if( rom_server_running )
+    gpio_set_function_masked( GPIO_DBUS_BITMASK, GPIO_FUNC_PIO1 );
+}
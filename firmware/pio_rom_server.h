@@ -0,0 +1,39 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __PIO_ROM_SERVER_H
+#define __PIO_ROM_SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The ROM image the PIO serves from has to be aligned to its size */
+#define PIO_ROM_SERVER_ALIGNMENT  ((uint32_t)16384)
+
+uint32_t using_pio_rom_server( void );
+uint8_t *query_pio_rom_server_image( void );
+
+bool init_pio_rom_server( const uint8_t *rom_image );
+
+const volatile uint32_t *query_pio_rom_server_padoe( void );
+
+void pio_rom_server_release_dbus( void );
+void pio_rom_server_reclaim_dbus( void );
+
+#endif
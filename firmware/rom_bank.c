@@ -0,0 +1,123 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stddef.h>
+
+#include "rom_bank.h"
+#include "zx_memory_management.h"
+#include "rom.h"
+
+typedef struct _ROM_BANK
+{
+  const char    *name;
+  const uint8_t *pages[ROM_PAGES_PER_BANK];   // Second one is NULL for a single ROM
+}
+ROM_BANK;
+
+static ROM_BANK rom_banks[NUM_ROM_BANKS] =
+{
+  { .name = "48K", .pages = { _48_original_rom, NULL } },
+};
+
+static volatile uint8_t active_rom_bank = 0;
+
+/*
+ * Add a ROM image, or a pair of them, to the bank. The images have to be 16K
+ * (ROM_IMAGE_SIZE) and stay put. Returns the new bank number, or ROM_BANK_NONE
+ * if there's no room.
+ */
+uint8_t register_rom_bank( const char *name, const uint8_t *page0, const uint8_t *page1 )
+{
+  if( page0 == NULL )
+    return ROM_BANK_NONE;
+
+  for( uint8_t bank=0; bank < NUM_ROM_BANKS; bank++ )
+  {
+    if( rom_banks[bank].pages[0] != NULL )
+      continue;
+
+    rom_banks[bank].name     = name;
+    rom_banks[bank].pages[1] = page1;
+    rom_banks[bank].pages[0] = page0;
+
+    return bank;
+  }
+
+  return ROM_BANK_NONE;
+}
+
+/*
+ * Make a different bank the active one. This only changes which images the
+ * ROM emulation picks from, see switch_rom_bank() for the switch itself.
+ * Refused while the PIO ROM server is running, it can't follow the change.
+ */
+bool select_rom_bank( const uint8_t bank )
+{
+  if( bank >= NUM_ROM_BANKS || rom_banks[bank].pages[0] == NULL )
+    return false;
+
+  if( is_pio_rom_serving() )
+    return false;
+
+  active_rom_bank = bank;
+  return true;
+}
+
+uint8_t query_rom_bank( void )
+{
+  return active_rom_bank;
+}
+
+const char *query_rom_bank_name( const uint8_t bank )
+{
+  if( bank >= NUM_ROM_BANKS )
+    return NULL;
+
+  return rom_banks[bank].name;
+}
+
+/*
+ * The image for the given ROM page of the active bank. A single ROM bank
+ * gives the same image whichever page the 128K paging asks for.
+ */
+const uint8_t *query_rom_bank_page( const uint8_t page )
+{
+  const ROM_BANK *rom_bank = &rom_banks[active_rom_bank];
+
+  if( page < ROM_PAGES_PER_BANK && rom_bank->pages[page] != NULL )
+    return rom_bank->pages[page];
+
+  return rom_bank->pages[0];
+}
+
+/*
+ * 16 bit sum of the active bank's first ROM, used to identify it
+ */
+uint16_t query_rom_bank_checksum( void )
+{
+  const uint8_t *page = query_rom_bank_page( 0 );
+  uint16_t checksum = 0;
+
+  for( uint32_t i=0; i < ROM_IMAGE_SIZE; i++ )
+  {
+    checksum += page[i];
+  }
+
+  return checksum;
+}
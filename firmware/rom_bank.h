@@ -0,0 +1,48 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __ROM_BANK_H
+#define __ROM_BANK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * ROM bank. The ROM images the ROM emulation can serve. Each bank is either a
+ * single 16K ROM (the 48K, or a patched one) or a pair, like the 128K's editor
+ * and 48 BASIC ROMs, which the 128K pages between with bit 4 of port 0x7FFD.
+ *
+ * Bank 0 is the original 48K ROM from rom.h. Any others are registered at
+ * start up by whatever code has the images.
+ */
+#define NUM_ROM_BANKS       4
+#define ROM_BANK_NONE       0xFF
+#define ROM_PAGES_PER_BANK  2
+#define ROM_IMAGE_SIZE      ((uint32_t)16384)
+
+uint8_t register_rom_bank( const char *name, const uint8_t *page0, const uint8_t *page1 );
+
+bool select_rom_bank( const uint8_t bank );
+uint8_t query_rom_bank( void );
+const char *query_rom_bank_name( const uint8_t bank );
+
+const uint8_t *query_rom_bank_page( const uint8_t page );
+uint16_t query_rom_bank_checksum( void );
+
+#endif
@@ -0,0 +1,273 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "pico.h"
+
+#include "rom_sandbox.h"
+#include "rom_trap.h"
+#include "zx_mirror.h"
+#include "dma_engine.h"
+
+/*
+ * The sandbox reads the original ROM, not the patched one, so the ROM's calls
+ * into routines which have stubs go to the real thing. RAM comes from the
+ * overlay if the sandbox has written that page, otherwise from the mirror.
+ *
+ * There are enough overlay pages for a whole screen, display file and
+ * attributes, with plenty over for the system variables and stacks.
+ */
+#define SANDBOX_OVERLAY_PAGES  40
+
+/*
+ * Runs of changed bytes are collected up to this long, then DMAed back in
+ * pieces the interrupt protection can keep clear of /INT.
+ */
+#define SANDBOX_RUN_LENGTH     ((uint32_t)1024)
+
+/* The stub's registers plus whatever it keeps above them */
+#define SANDBOX_REG_BLOCK_MAX  32
+
+typedef struct _ROM_SANDBOX
+{
+  const uint8_t *rom;
+
+  uint8_t  page_map[256];                         // Overlay page+1 for each page of Z80 memory, 0 if none
+  uint8_t  page_high[SANDBOX_OVERLAY_PAGES];      // Which page of Z80 memory each overlay page is
+  uint8_t  pages[SANDBOX_OVERLAY_PAGES][256];
+  uint8_t  dirty[SANDBOX_OVERLAY_PAGES][256/8];
+  uint32_t num_pages;
+  bool     overflow;
+}
+ROM_SANDBOX;
+
+static ROM_SANDBOX rom_sandbox;
+
+static ZX_BYTE sandbox_read( const ZX_ADDR zx_addr, void *user_data )
+{
+  ROM_SANDBOX *sandbox = (ROM_SANDBOX*)user_data;
+
+  if( zx_addr < 0x4000 )
+    return sandbox->rom[zx_addr];
+
+  const uint8_t page = sandbox->page_map[zx_addr >> 8];
+  if( page != 0 )
+    return sandbox->pages[page-1][zx_addr & 0xFF];
+
+  return get_zx_mirror_byte( zx_addr );
+}
+
+static void sandbox_write( const ZX_ADDR zx_addr, const ZX_BYTE value, void *user_data )
+{
+  ROM_SANDBOX *sandbox = (ROM_SANDBOX*)user_data;
+
+  /* The Spectrum ignores writes to the ROM */
+  if( zx_addr < 0x4000 )
+    return;
+
+  uint8_t page = sandbox->page_map[zx_addr >> 8];
+  if( page == 0 )
+  {
+    if( sandbox->num_pages == SANDBOX_OVERLAY_PAGES )
+    {
+      sandbox->overflow = true;
+      return;
+    }
+
+    page = ++sandbox->num_pages;
+    sandbox->page_map[zx_addr >> 8] = page;
+    sandbox->page_high[page-1]      = zx_addr >> 8;
+
+    copy_from_zx_mirror( sandbox->pages[page-1], zx_addr & 0xFF00, 256 );
+    memset( sandbox->dirty[page-1], 0, sizeof(sandbox->dirty[0]) );
+  }
+
+  const uint8_t offset = zx_addr & 0xFF;
+  sandbox->pages[page-1][offset]    = value;
+  sandbox->dirty[page-1][offset>>3] |= 1 << (offset & 7);
+}
+
+ZX_BYTE read_rom_sandbox_byte( const ZX_ADDR zx_addr )
+{
+  return sandbox_read( zx_addr, &rom_sandbox );
+}
+
+ZX_WORD read_rom_sandbox_word( const ZX_ADDR zx_addr )
+{
+  return sandbox_read( zx_addr, &rom_sandbox ) | (sandbox_read( zx_addr+1, &rom_sandbox ) << 8);
+}
+
+void write_rom_sandbox_word( const ZX_ADDR zx_addr, const ZX_WORD value )
+{
+  sandbox_write( zx_addr, value & 0xFF, &rom_sandbox );
+  sandbox_write( zx_addr+1, value >> 8, &rom_sandbox );
+}
+
+/*
+ * Empty the sandbox and set up a CPU to run the original ROM from pc, with the
+ * registers a stub pushed at reg_block.
+ */
+void start_rom_sandbox( Z80_CPU *cpu, const ZX_ADDR reg_block, const ZX_ADDR pc, const ZX_ADDR sp )
+{
+  ROM_SANDBOX *sandbox = &rom_sandbox;
+
+  for( uint32_t i=0; i < sandbox->num_pages; i++ )
+    sandbox->page_map[sandbox->page_high[i]] = 0;
+
+  sandbox->num_pages = 0;
+  sandbox->overflow  = false;
+  sandbox->rom       = query_rom_trap_original();
+
+  cpu->af     = read_rom_sandbox_word( reg_block+SANDBOX_REG_AF );
+  cpu->bc     = read_rom_sandbox_word( reg_block+SANDBOX_REG_BC );
+  cpu->de     = read_rom_sandbox_word( reg_block+SANDBOX_REG_DE );
+  cpu->hl     = read_rom_sandbox_word( reg_block+SANDBOX_REG_HL );
+  cpu->af_alt = read_rom_sandbox_word( reg_block+SANDBOX_REG_AF_ALT );
+  cpu->bc_alt = read_rom_sandbox_word( reg_block+SANDBOX_REG_BC_ALT );
+  cpu->de_alt = read_rom_sandbox_word( reg_block+SANDBOX_REG_DE_ALT );
+  cpu->hl_alt = read_rom_sandbox_word( reg_block+SANDBOX_REG_HL_ALT );
+  cpu->ix     = read_rom_sandbox_word( reg_block+SANDBOX_REG_IX );
+  cpu->iy     = read_rom_sandbox_word( reg_block+SANDBOX_REG_IY );
+  cpu->sp     = sp;
+  cpu->pc     = pc;
+
+  cpu->read      = sandbox_read;
+  cpu->write     = sandbox_write;
+  cpu->user_data = sandbox;
+}
+
+/*
+ * Run until the routine returns, which is when the stack pointer comes back
+ * up to return_sp. Anything which leaves the ROM, or reports an error, stops
+ * it. lowest_sp is how far down the routine took the stack.
+ */
+bool run_rom_sandbox( Z80_CPU *cpu, const ZX_ADDR return_sp, const uint32_t max_steps, ZX_ADDR *lowest_sp )
+{
+  *lowest_sp = cpu->sp;
+
+  for( uint32_t step=0; step < max_steps; step++ )
+  {
+    if( !z80_cpu_step( cpu ) || rom_sandbox.overflow )
+      return false;
+
+    if( cpu->sp < *lowest_sp )
+      *lowest_sp = cpu->sp;
+
+    if( cpu->sp == return_sp )
+      return true;
+
+    /* RST 08h is an error report, the others mean it's gone off the rails */
+    if( cpu->pc == 0x0000 || cpu->pc == 0x0008 || cpu->pc == 0x0038 || cpu->pc >= 0x4000 )
+      return false;
+  }
+
+  return false;
+}
+
+/*
+ * The Z80 is waiting in a stub, usually with interrupts on, so anything more
+ * than a few dozen bytes has to go in pieces.
+ */
+static bool write_back_run( uint8_t *src, const ZX_ADDR zx_addr, const uint32_t length )
+{
+  return dma_memory_block_int_safe( src, zx_addr, length ) == DMA_STATUS_OK;
+}
+
+/*
+ * Put the CPU's registers over the ones the stub pushed, for it to pop, then
+ * copy what the sandbox wrote back into the Spectrum's memory. Only bytes
+ * which are different from the mirror go back, so a routine which rewrites
+ * most of the screen with what's already there costs very little. The stack
+ * below the stub's registers was only ever the routine's scratch space and
+ * is left alone. The registers go last, once everything they refer to is in
+ * place, and that's the point the Z80 can see the results.
+ *
+ * The DMA only fails on a bad request, which this doesn't make. If it did,
+ * part of the results might be in, which is no worse than anything else that
+ * could be done about it.
+ */
+bool finish_rom_sandbox( const Z80_CPU *cpu, const ZX_ADDR reg_block, const ZX_ADDR reg_block_end,
+                         const ZX_ADDR lowest_sp )
+{
+  ROM_SANDBOX *sandbox = &rom_sandbox;
+
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_AF,     cpu->af );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_BC,     cpu->bc );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_DE,     cpu->de );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_HL,     cpu->hl );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_AF_ALT, cpu->af_alt );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_BC_ALT, cpu->bc_alt );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_DE_ALT, cpu->de_alt );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_HL_ALT, cpu->hl_alt );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_IX,     cpu->ix );
+  write_rom_sandbox_word( reg_block+SANDBOX_REG_IY,     cpu->iy );
+
+  if( sandbox->overflow )
+    return false;
+
+  const ZX_ADDR stack_low = (lowest_sp < reg_block) ? lowest_sp : reg_block;
+
+  /* Walk Z80 memory in address order so runs can carry on across pages */
+  uint8_t  run[SANDBOX_RUN_LENGTH];
+  ZX_ADDR  run_start  = 0;
+  uint32_t run_length = 0;
+
+  for( uint32_t high=0x40; high <= 0x100; high++ )
+  {
+    const uint8_t page = (high < 0x100) ? sandbox->page_map[high] : 0;
+
+    for( uint32_t offset=0; offset < 256; offset++ )
+    {
+      const ZX_ADDR zx_addr = (high << 8) + offset;
+
+      const bool wanted = (page != 0) &&
+                          (sandbox->dirty[page-1][offset>>3] & (1 << (offset & 7))) &&
+                          (sandbox->pages[page-1][offset] != get_zx_mirror_byte( zx_addr )) &&
+                          !(zx_addr >= stack_low && zx_addr < reg_block_end);
+      if( wanted )
+      {
+        if( run_length == 0 )
+          run_start = zx_addr;
+        run[run_length++] = sandbox->pages[page-1][offset];
+      }
+
+      if( run_length != 0 && (!wanted || run_length == SANDBOX_RUN_LENGTH) )
+      {
+        if( !write_back_run( run, run_start, run_length ) )
+          return false;
+        run_length = 0;
+      }
+
+      /* Nothing to look at in a page the sandbox didn't write */
+      if( page == 0 )
+        break;
+    }
+  }
+
+  uint8_t registers[SANDBOX_REG_BLOCK_MAX];
+  const uint32_t reg_block_size = (ZX_ADDR)(reg_block_end - reg_block);
+  if( reg_block_size > sizeof(registers) )
+    return false;
+
+  for( uint32_t i=0; i < reg_block_size; i++ )
+    registers[i] = sandbox_read( reg_block+i, sandbox );
+
+  return write_back_run( registers, reg_block, reg_block_size );
+}
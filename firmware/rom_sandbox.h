@@ -0,0 +1,66 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __ROM_SANDBOX_H
+#define __ROM_SANDBOX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+#include "z80_cpu.h"
+
+/*
+ * ROM sandbox. Runs a piece of the original ROM on the RP2350, in the Z80
+ * interpreter, against the Spectrum's RAM as it is in the mirror. Writes are
+ * held back in the sandbox until the run has finished, then the ones which
+ * changed something are DMAed into the Spectrum. A run which can't finish
+ * doesn't change anything, so the Z80 can run the same code itself instead.
+ *
+ * This is for the trap stubs (see rom_trap.h) which divert a ROM routine and
+ * push every register while the Z80 waits. The registers are in this order
+ * from the stub's SP, which is how they come off the stack for these offsets:
+ *
+ *   PUSH AF, PUSH BC, PUSH DE, PUSH HL,
+ *   EXX, PUSH BC, PUSH DE, PUSH HL, EXX,
+ *   EX AF,AF', PUSH AF, EX AF,AF',
+ *   PUSH IX, PUSH IY
+ */
+#define SANDBOX_REG_IY          0
+#define SANDBOX_REG_IX          2
+#define SANDBOX_REG_AF_ALT      4
+#define SANDBOX_REG_HL_ALT      6
+#define SANDBOX_REG_DE_ALT      8
+#define SANDBOX_REG_BC_ALT      10
+#define SANDBOX_REG_HL          12
+#define SANDBOX_REG_DE          14
+#define SANDBOX_REG_BC          16
+#define SANDBOX_REG_AF          18
+#define SANDBOX_REG_BLOCK_SIZE  20
+
+void start_rom_sandbox( Z80_CPU *cpu, const ZX_ADDR reg_block, const ZX_ADDR pc, const ZX_ADDR sp );
+bool run_rom_sandbox( Z80_CPU *cpu, const ZX_ADDR return_sp, const uint32_t max_steps, ZX_ADDR *lowest_sp );
+
+ZX_BYTE read_rom_sandbox_byte( const ZX_ADDR zx_addr );
+ZX_WORD read_rom_sandbox_word( const ZX_ADDR zx_addr );
+void write_rom_sandbox_word( const ZX_ADDR zx_addr, const ZX_WORD value );
+
+bool finish_rom_sandbox( const Z80_CPU *cpu, const ZX_ADDR reg_block, const ZX_ADDR reg_block_end,
+                         const ZX_ADDR lowest_sp );
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "pico.h"
+#include "hardware/sync.h"
+
+#include <string.h>
+
+#include "rom_trap.h"
+#include "rom_bank.h"
+#include "zx_mirror.h"
+#include "zx_memory_management.h"
+
+typedef struct _ROM_TRAP
+{
+  volatile bool     active;
+
+  ZX_ADDR           zx_addr;
+  ROM_TRAP_HANDLER  handler;           // NULL for a release trap...
+  void             *user_data;
+
+  ZX_ADDR           status_addr;       // ...which has core1 put this byte into the image
+  uint8_t           busy_value;
+
+  volatile uint32_t hits;              // Only core1 writes this...
+  uint32_t          serviced;          // ...and only core0 writes this
+}
+ROM_TRAP;
+
+static ROM_TRAP rom_traps[NUM_ROM_TRAPS];
+
+/*
+ * Any trap hit, so core0 can see there's something to do with one compare.
+ * The same one-writer-each arrangement as the per-trap counts.
+ */
+static volatile uint32_t rom_trap_hits     = 0;
+static uint32_t          rom_trap_serviced = 0;
+
+/*
+ * One flag per 256 byte page of the ROM, set if a trap is in that page. This
+ * is all core1 has to look at for most ROM reads, so it's in scratch X with
+ * core1's loop.
+ */
+static volatile uint8_t rom_trap_pages[64] __scratch_x("rom_trap_pages");
+
+/* The patched copy of the ROM which has the 48K BASIC in it, and where it came from */
+static uint8_t        rom_trap_image[ROM_IMAGE_SIZE];
+static const uint8_t *rom_trap_original = NULL;
+static uint8_t        rom_trap_bank     = ROM_BANK_NONE;
+static bool           rom_trap_paged    = false;     // True if it's page 1 of a 128K pair
+
+/*
+ * Traps are off by default. Core1 only looks for them if this is switched on,
+ * it's a few more instructions on every ROM read.
+ */
+inline uint32_t using_rom_traps( void )
+{
+#define USE_ROM_TRAPS 0
+  return USE_ROM_TRAPS;
+}
+
+/*
+ * Rebuild the page flags from the active traps, in the same way as the write
+ * watch page flags.
+ */
+static void rebuild_rom_trap_pages( void )
+{
+  uint8_t pages[64] = {0};
+
+  for( uint32_t i=0; i < NUM_ROM_TRAPS; i++ )
+  {
+    if( rom_traps[i].active )
+      pages[rom_traps[i].zx_addr >> 8] = 1;
+  }
+
+  for( uint32_t page=0; page < 64; page++ )
+    rom_trap_pages[page] = pages[page];
+}
+
+/*
+ * The patched ROM image, made from the active ROM bank the first time it's
+ * asked for. On a 128K the 48K BASIC ROM is the second one. The copy goes
+ * into the ROM bank and the ROM emulation is switched to it, so it needs
+ * full ROM emulation, and core1 serving the ROM rather than the PIO ROM
+ * server, which can't be pointed at it. Returns NULL if it can't be used.
+ */
+uint8_t *open_rom_trap_image( void )
+{
+  if( is_pio_rom_serving() )
+    return NULL;
+
+  if( rom_trap_bank != ROM_BANK_NONE )
+    return rom_trap_image;
+
+  const uint8_t *page0 = query_rom_bank_page( 0 );
+  const uint8_t *page1 = query_rom_bank_page( 1 );
+
+  rom_trap_paged    = (page1 != page0);
+  rom_trap_original = rom_trap_paged ? page1 : page0;
+
+  memcpy( rom_trap_image, rom_trap_original, ROM_IMAGE_SIZE );
+
+  const uint8_t bank = rom_trap_paged ? register_rom_bank( "ROM traps", page0, rom_trap_image )
+                                      : register_rom_bank( "ROM traps", rom_trap_image, NULL );
+  if( bank == ROM_BANK_NONE )
+    return NULL;
+
+  if( !switch_rom_bank( bank ) )
+    return NULL;
+
+  rom_trap_bank = bank;
+  return rom_trap_image;
+}
+
+/*
+ * The ROM the patched image was copied from. Features check their patch
+ * sites against it, and anything which runs ROM code on the RP2350 wants
+ * the original rather than the one with the stubs in.
+ */
+const uint8_t *query_rom_trap_original( void )
+{
+  return rom_trap_original;
+}
+
+/*
+ * The stub addresses are in the 48K ROM's spare space. On a 128K the other
+ * ROM has code there, so traps on stubs only count if the Z80 is running the
+ * patched ROM.
+ */
+bool is_rom_trap_image_running( void )
+{
+  if( rom_trap_bank == ROM_BANK_NONE || query_rom_bank() != rom_trap_bank )
+    return false;
+
+  if( rom_trap_paged )
+    return (query_zx_paging_latch() & ZX_PAGING_ROM_SELECT) != 0;
+
+  return true;
+}
+
+/*
+ * A stub can only go in if the original ROM has nothing there, start to end
+ * exclusive.
+ */
+bool is_rom_trap_space_free( const uint16_t start, const uint16_t end )
+{
+  if( rom_trap_original == NULL )
+    return false;
+
+  for( uint32_t zx_addr=start; zx_addr < end; zx_addr++ )
+  {
+    if( rom_trap_original[zx_addr] != 0xFF )
+      return false;
+  }
+
+  return true;
+}
+
+void init_rom_traps( void )
+{
+  for( uint32_t i=0; i < NUM_ROM_TRAPS; i++ )
+    rom_traps[i].active = false;
+
+  rebuild_rom_trap_pages();
+}
+
+static uint8_t add_trap( const ZX_ADDR zx_addr, ROM_TRAP_HANDLER handler, void *user_data,
+                         const ZX_ADDR status_addr, const uint8_t busy_value )
+{
+  for( uint32_t i=0; i < NUM_ROM_TRAPS; i++ )
+  {
+    if( rom_traps[i].active )
+      continue;
+
+    rom_traps[i].zx_addr     = zx_addr;
+    rom_traps[i].handler     = handler;
+    rom_traps[i].user_data   = user_data;
+    rom_traps[i].status_addr = status_addr;
+    rom_traps[i].busy_value  = busy_value;
+    rom_traps[i].serviced    = rom_traps[i].hits;
+
+    /* The entry has to be complete before core1 can see it's active */
+    __dmb();
+    rom_traps[i].active = true;
+
+    rebuild_rom_trap_pages();
+
+    return (uint8_t)i;
+  }
+
+  return ROM_TRAP_NONE;
+}
+
+uint8_t add_rom_trap( const ZX_ADDR zx_addr, ROM_TRAP_HANDLER handler, void *user_data )
+{
+  if( zx_addr > 0x3FFF || handler == NULL )
+    return ROM_TRAP_NONE;
+
+  return add_trap( zx_addr, handler, user_data, 0, 0 );
+}
+
+/*
+ * The byte goes into the patched image whichever ROM the Z80 is running. On
+ * a 128K the other ROM has code at the trap address, but the Z80 can't be
+ * spinning in the stub while it's running that, so busy is what the status
+ * would be anyway.
+ */
+uint8_t add_rom_release_trap( const ZX_ADDR zx_addr, const ZX_ADDR status_addr, const uint8_t busy_value )
+{
+  if( zx_addr > 0x3FFF || status_addr > 0x3FFF || rom_trap_bank == ROM_BANK_NONE )
+    return ROM_TRAP_NONE;
+
+  return add_trap( zx_addr, NULL, NULL, status_addr, busy_value );
+}
+
+bool remove_rom_trap( const uint8_t trap_id )
+{
+  if( trap_id >= NUM_ROM_TRAPS || !rom_traps[trap_id].active )
+    return false;
+
+  rom_traps[trap_id].active = false;
+  rebuild_rom_trap_pages();
+
+  return true;
+}
+
+/*
+ * Core1 calls this for every ROM read, so it needs to be quick.
+ */
+inline bool __scratch_x("is_rom_trap_page") is_rom_trap_page( const ZX_ADDR zx_addr )
+{
+  return rom_trap_pages[zx_addr >> 8];
+}
+
+/*
+ * Core1 calls this for a read from a trapped page. It only counts the hit,
+ * the handler is run by core0. A release trap is done here and now.
+ */
+void __scratch_x("check_rom_traps") check_rom_traps( const ZX_ADDR zx_addr )
+{
+  for( uint32_t i=0; i < NUM_ROM_TRAPS; i++ )
+  {
+    ROM_TRAP *trap = &rom_traps[i];
+
+    if( !trap->active || trap->zx_addr != zx_addr )
+      continue;
+
+    if( trap->handler == NULL )
+    {
+      rom_trap_image[trap->status_addr] = trap->busy_value;
+      continue;
+    }
+
+    trap->hits++;
+    rom_trap_hits++;
+  }
+}
+
+bool is_rom_trap_pending( void )
+{
+  return rom_trap_hits != rom_trap_serviced;
+}
+
+/*
+ * Core0 calls this from the main loop to run the handlers of any traps core1
+ * has seen hit. A trap hit several times since the last look has its handler
+ * run once.
+ */
+void service_rom_traps( void )
+{
+  rom_trap_serviced = rom_trap_hits;
+
+  for( uint32_t i=0; i < NUM_ROM_TRAPS; i++ )
+  {
+    ROM_TRAP *trap = &rom_traps[i];
+
+    const uint32_t hits = trap->hits;
+    if( hits == trap->serviced )
+      continue;
+
+    trap->serviced = hits;
+
+    if( trap->active && trap->handler != NULL )
+      trap->handler( trap->zx_addr, trap->user_data );
+  }
+}
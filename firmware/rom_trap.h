@@ -0,0 +1,87 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __ROM_TRAP_H
+#define __ROM_TRAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * ROM traps. Core1 sees the address of every read from the ROM area, which
+ * includes the Z80's instruction fetches. A trap is a ROM address which, when
+ * the Z80 reads from it, has core0 run a handler. The Z80 isn't stopped, the
+ * handler runs while it carries on, so anything which needs the Z80 to wait
+ * has to arrange that itself (see tape_trap.c).
+ *
+ * The /M1 line isn't wired to the RP2350, so a data read from a trap address
+ * fires it too. Code doesn't read from the ROM's routine entry points, so it
+ * doesn't come up in practice.
+ */
+#define NUM_ROM_TRAPS  8
+
+/* Value returned when a trap can't be added */
+#define ROM_TRAP_NONE  0xFF
+
+typedef void (*ROM_TRAP_HANDLER)( const ZX_ADDR zx_addr, void *user_data );
+
+uint32_t using_rom_traps( void );
+
+void init_rom_traps( void );
+
+uint8_t add_rom_trap( const ZX_ADDR zx_addr, ROM_TRAP_HANDLER handler, void *user_data );
+
+/*
+ * A release trap has no handler. Core1 itself puts a byte into the patched
+ * ROM image as soon as it sees the address read. A stub which spins on a
+ * status byte has one on the instruction after it's read the status, so the
+ * status is back to busy before the Z80 can get round to the stub again,
+ * however far behind core0 is.
+ */
+uint8_t add_rom_release_trap( const ZX_ADDR zx_addr, const ZX_ADDR status_addr, const uint8_t busy_value );
+bool remove_rom_trap( const uint8_t trap_id );
+
+/*
+ * Trap stubs. A feature which needs the Z80 to wait while core0 does some work
+ * diverts a ROM routine into a stub of its own, which spins until core0 says
+ * it's done. The stubs live in the 48K BASIC ROM's spare space (0x386E to
+ * 0x3CFF is all 0xFF) in a patched copy of the ROM, which is served in place
+ * of the original. Everything shares the one copy, the spare space is shared
+ * out like this:
+ *
+ *   0x3900-0x398F  tape_trap.c
+ *   0x39A0-0x39FF  calc_offload.c
+ *   0x3A00-0x3AFF  screen_offload.c
+ *   0x3B00-0x3BFF  fast_boot.c
+ */
+uint8_t *open_rom_trap_image( void );
+const uint8_t *query_rom_trap_original( void );
+bool is_rom_trap_image_running( void );
+bool is_rom_trap_space_free( const uint16_t start, const uint16_t end );
+
+/* Core1 side */
+bool is_rom_trap_page( const ZX_ADDR zx_addr );
+void check_rom_traps( const ZX_ADDR zx_addr );
+
+/* Core0 side */
+bool is_rom_trap_pending( void );
+void service_rom_traps( void );
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "pico.h"
+#include "hardware/sync.h"
+
+#include "screen_offload.h"
+#include "rom_trap.h"
+#include "rom_sandbox.h"
+#include "zx_mirror.h"
+
+/*
+ * The ROM's screen routines are byte loops which take the Z80 a long time:
+ * clearing the screen, scrolling it, and working out and writing the 8 bytes
+ * and attribute of every character printed. They're diverted to a stub which
+ * pushes the registers and waits while core0 runs the same routine in the ROM
+ * sandbox. Only the bytes which changed are DMAed back into the screen and
+ * system variables, then the stub pops the registers and carries on from
+ * where the routine returned to.
+ *
+ * Each diverted routine has its first instruction replaced with a JP to a
+ * trampoline of its own, which CALLs the shared stub. That leaves the
+ * trampoline's address on the stack, above the registers, which is how core0
+ * knows which routine it was. If the sandbox can't run the routine, the
+ * "scroll?" prompt for instance, which reads the keyboard, the stub returns
+ * into the trampoline. That runs the instruction the JP replaced and jumps
+ * back into the original routine, so the Z80 does it all itself as usual.
+ *
+ * The routines are entered with their return address on the top of the
+ * stack. The sandbox runs one until the stack comes back above that, which is
+ * normally its RET. Wherever it is by then, the Z80 carries on from there with
+ * the sandbox's registers and stack pointer.
+ *
+ *  3A00  F5              PUSH AF
+ *  3A01  C5              PUSH BC
+ *  3A02  D5              PUSH DE
+ *  3A03  E5              PUSH HL
+ *  3A04  D9              EXX
+ *  3A05  C5              PUSH BC
+ *  3A06  D5              PUSH DE
+ *  3A07  E5              PUSH HL
+ *  3A08  D9              EXX
+ *  3A09  08              EX AF,AF'
+ *  3A0A  F5              PUSH AF
+ *  3A0B  08              EX AF,AF'
+ *  3A0C  DD E5           PUSH IX
+ *  3A0E  FD E5           PUSH IY
+ *  3A10  ED 73 F0 3A     LD (PARAMS_SP),SP
+ *  3A14  00              NOP                   <- entry trap
+ *  3A15  3A F2 3A        LD A,(STATUS)
+ *  3A18  A7              AND A
+ *  3A19  28 FA           JR Z,3A15
+ *  3A1B  FE 82           CP STATUS_FALLBACK    <- exit trap
+ *  3A1D  28 13           JR Z,3A32
+ *  3A1F  (pop them all)
+ *  3A2F  33              INC SP                (drop the trampoline address)
+ *  3A30  33              INC SP
+ *  3A31  C9              RET
+ *  3A32  (pop them all)
+ *  3A42  C9              RET                   (into the trampoline)
+ *
+ *  3A50  CD 00 3A        CALL SCREEN_STUB      <- first trampoline
+ *  3A53  xx xx xx        (the routine's first instruction)
+ *  3A56  C3 xx xx        JP routine+3
+ *  3A59                                        <- next trampoline
+ */
+#define SCREEN_STUB              ((ZX_ADDR)0x3A00)
+#define SCREEN_ENTRY_TRAP        ((ZX_ADDR)0x3A14)
+#define SCREEN_EXIT_TRAP         ((ZX_ADDR)0x3A1B)
+#define SCREEN_TRAMPOLINES       ((ZX_ADDR)0x3A50)
+
+/* Written by the stub, so it's in the mirror */
+#define SCREEN_PARAMS_SP         ((ZX_ADDR)0x3AF0)
+
+/* Written by core0, so it's in the ROM image */
+#define SCREEN_STATUS            ((ZX_ADDR)0x3AF2)
+
+#define SCREEN_STUB_AREA_END     ((ZX_ADDR)0x3B00)
+
+#define SCREEN_STATUS_BUSY       0x00
+#define SCREEN_STATUS_DONE       0x81
+#define SCREEN_STATUS_FALLBACK   0x82
+
+/*
+ * Above the stub's registers (see rom_sandbox.h) is the return address of its
+ * CALL, just after the CALL in the trampoline, then the routine's own return
+ * address.
+ */
+#define SCREEN_REG_TRAMPOLINE    SANDBOX_REG_BLOCK_SIZE
+#define SCREEN_REG_RETURN        (SANDBOX_REG_BLOCK_SIZE+2)
+#define SCREEN_REG_BLOCK_SIZE    (SANDBOX_REG_BLOCK_SIZE+4)
+
+/* Each routine's first instruction is 3 bytes, the size of the JP which replaces it */
+#define SCREEN_PATCH_SIZE        3
+#define SCREEN_TRAMPOLINE_SIZE   (3+SCREEN_PATCH_SIZE+3)
+
+#define SCREEN_POP_ALL                               \
+  0xFD, 0xE1,                                        \
+  0xDD, 0xE1,                                        \
+  0x08, 0xF1, 0x08,                                  \
+  0xD9, 0xE1, 0xD1, 0xC1, 0xD9,                      \
+  0xE1, 0xD1, 0xC1, 0xF1
+
+static const uint8_t screen_stub[] =
+{
+  0xF5, 0xC5, 0xD5, 0xE5,
+  0xD9, 0xC5, 0xD5, 0xE5, 0xD9,
+  0x08, 0xF5, 0x08,
+  0xDD, 0xE5,
+  0xFD, 0xE5,
+  0xED, 0x73, SCREEN_PARAMS_SP & 0xFF, SCREEN_PARAMS_SP >> 8,
+  0x00,
+  0x3A, SCREEN_STATUS & 0xFF, SCREEN_STATUS >> 8,
+  0xA7,
+  0x28, 0xFA,
+  0xFE, SCREEN_STATUS_FALLBACK,
+  0x28, 0x13,
+  SCREEN_POP_ALL,
+  0x33, 0x33,
+  0xC9,
+  SCREEN_POP_ALL,
+  0xC9,
+};
+
+typedef struct _SCREEN_ROUTINE
+{
+  ZX_ADDR zx_addr;
+  uint8_t original[SCREEN_PATCH_SIZE];
+}
+SCREEN_ROUTINE;
+
+/*
+ * The routines which are diverted, with their first instructions as a check
+ * it's the ROM that's expected. CL-SCROLL is diverted just after its LD B,17h
+ * because the ROM calls that address too, to scroll the whole screen.
+ */
+static const SCREEN_ROUTINE screen_routines[] =
+{
+  { 0x09F4, { 0xCD, 0x03, 0x0B } },     // PRINT-OUT: CALL PO-FETCH
+  { 0x0DAF, { 0x21, 0x00, 0x00 } },     // CL-ALL:    LD HL,0000h
+  { 0x0E00, { 0xCD, 0x9B, 0x0E } },     // CL-SCROLL: CALL CL-ADDR
+  { 0x22DC, { 0xCD, 0x07, 0x23 } },     // PLOT:      CALL STK-TO-BC
+  { 0x24B7, { 0xCD, 0x07, 0x23 } },     // DRAW-LINE: CALL STK-TO-BC
+};
+
+#define NUM_SCREEN_ROUTINES      (sizeof(screen_routines) / sizeof(screen_routines[0]))
+
+/*
+ * How long the sandbox is allowed. Clearing or scrolling the whole screen is
+ * the longest, at a few tens of thousands of instructions.
+ */
+#define SCREEN_MAX_STEPS         ((uint32_t)500000)
+
+/* The patched ROM, shared with the other trap stubs */
+static uint8_t *screen_rom_image = NULL;
+
+static uint32_t screen_offload_count  = 0;
+static uint32_t screen_fallback_count = 0;
+
+/*
+ * Screen offload is off by default. It needs the ROM traps, and replaces
+ * the active ROM with the patched copy.
+ */
+inline uint32_t using_screen_offload( void )
+{
+#define USE_SCREEN_OFFLOAD 0
+  return USE_SCREEN_OFFLOAD;
+}
+
+uint32_t query_screen_offload_count( void )
+{
+  return screen_offload_count;
+}
+
+uint32_t query_screen_fallback_count( void )
+{
+  return screen_fallback_count;
+}
+
+/*
+ * Work out which routine the Z80 was going into from the trampoline's return
+ * address. Returns NULL if it isn't one of them.
+ */
+static const SCREEN_ROUTINE *find_screen_routine( const ZX_ADDR trampoline_return )
+{
+  for( uint32_t i=0; i < NUM_SCREEN_ROUTINES; i++ )
+  {
+    if( trampoline_return == SCREEN_TRAMPOLINES + i*SCREEN_TRAMPOLINE_SIZE + 3 )
+      return &screen_routines[i];
+  }
+
+  return NULL;
+}
+
+/*
+ * The Z80 has gone into one of the routines and is waiting in the stub with
+ * its registers pushed. Run the routine in the sandbox, from its start with
+ * its return address on the top of the stack.
+ */
+static void screen_entry_trap( const ZX_ADDR zx_addr, void *user_data )
+{
+  if( !is_rom_trap_image_running() )
+    return;
+
+  const ZX_ADDR reg_block = get_zx_mirror_byte( SCREEN_PARAMS_SP ) | (get_zx_mirror_byte( SCREEN_PARAMS_SP+1 ) << 8);
+  uint8_t       status    = SCREEN_STATUS_FALLBACK;
+
+  const SCREEN_ROUTINE *routine = find_screen_routine( get_zx_mirror_byte( reg_block+SCREEN_REG_TRAMPOLINE ) |
+                                                       (get_zx_mirror_byte( reg_block+SCREEN_REG_TRAMPOLINE+1 ) << 8) );
+  if( routine != NULL )
+  {
+    Z80_CPU cpu;
+    start_rom_sandbox( &cpu, reg_block, routine->zx_addr, reg_block+SCREEN_REG_RETURN );
+
+    ZX_ADDR lowest_sp;
+    if( run_rom_sandbox( &cpu, reg_block+SCREEN_REG_BLOCK_SIZE, SCREEN_MAX_STEPS, &lowest_sp ) )
+    {
+      /* The stub pops the registers, drops the trampoline and carries on from here */
+      write_rom_sandbox_word( reg_block+SCREEN_REG_RETURN, cpu.pc );
+
+      if( finish_rom_sandbox( &cpu, reg_block, reg_block+SCREEN_REG_BLOCK_SIZE, lowest_sp ) )
+        status = SCREEN_STATUS_DONE;
+    }
+  }
+
+  if( status == SCREEN_STATUS_DONE )
+    screen_offload_count++;
+  else
+    screen_fallback_count++;
+
+  __dmb();
+  screen_rom_image[SCREEN_STATUS] = status;
+}
+
+/*
+ * Put the stub and trampolines into the patched ROM, divert the routines to
+ * them and set the traps. Returns false if the offload can't be used.
+ */
+bool init_screen_offload( void )
+{
+  if( !using_rom_traps() )
+    return false;
+
+  uint8_t *image = open_rom_trap_image();
+  if( image == NULL )
+    return false;
+
+  const uint8_t *original = query_rom_trap_original();
+
+  for( uint32_t i=0; i < NUM_SCREEN_ROUTINES; i++ )
+  {
+    if( memcmp( original+screen_routines[i].zx_addr, screen_routines[i].original, SCREEN_PATCH_SIZE ) != 0 )
+      return false;
+  }
+
+  if( !is_rom_trap_space_free( SCREEN_STUB, SCREEN_STUB_AREA_END ) )
+    return false;
+
+  screen_rom_image = image;
+
+  if( add_rom_trap( SCREEN_ENTRY_TRAP, screen_entry_trap, NULL ) == ROM_TRAP_NONE )
+    return false;
+
+  /* The stub has seen the status, core1 puts it back to busy for next time */
+  if( add_rom_release_trap( SCREEN_EXIT_TRAP, SCREEN_STATUS, SCREEN_STATUS_BUSY ) == ROM_TRAP_NONE )
+    return false;
+
+  memcpy( image+SCREEN_STUB, screen_stub, sizeof(screen_stub) );
+  image[SCREEN_STATUS] = SCREEN_STATUS_BUSY;
+
+  for( uint32_t i=0; i < NUM_SCREEN_ROUTINES; i++ )
+  {
+    const ZX_ADDR routine    = screen_routines[i].zx_addr;
+    const ZX_ADDR trampoline = SCREEN_TRAMPOLINES + i*SCREEN_TRAMPOLINE_SIZE;
+    uint8_t      *t          = image+trampoline;
+
+    t[0] = 0xCD;
+    t[1] = SCREEN_STUB & 0xFF;
+    t[2] = SCREEN_STUB >> 8;
+    memcpy( t+3, screen_routines[i].original, SCREEN_PATCH_SIZE );
+    t[3+SCREEN_PATCH_SIZE] = 0xC3;
+    t[4+SCREEN_PATCH_SIZE] = (routine+SCREEN_PATCH_SIZE) & 0xFF;
+    t[5+SCREEN_PATCH_SIZE] = (routine+SCREEN_PATCH_SIZE) >> 8;
+  }
+
+  /* The stub and trampolines have to be in place before anything goes to them */
+  __dmb();
+  for( uint32_t i=0; i < NUM_SCREEN_ROUTINES; i++ )
+  {
+    const ZX_ADDR routine    = screen_routines[i].zx_addr;
+    const ZX_ADDR trampoline = SCREEN_TRAMPOLINES + i*SCREEN_TRAMPOLINE_SIZE;
+
+    image[routine+1] = trampoline & 0xFF;
+    image[routine+2] = trampoline >> 8;
+    image[routine]   = 0xC3;
+  }
+
+  return true;
+}
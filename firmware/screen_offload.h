@@ -0,0 +1,38 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __SCREEN_OFFLOAD_H
+#define __SCREEN_OFFLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Screen offload. The 48K ROM's screen routines, CLS, scrolling, printing a
+ * character, PLOT and line drawing, are run on the RP2350 instead of the Z80,
+ * in the same way as the calculator (see calc_offload.h).
+ */
+uint32_t using_screen_offload( void );
+
+bool init_screen_offload( void );
+
+uint32_t query_screen_offload_count( void );
+uint32_t query_screen_fallback_count( void );
+
+#endif
@@ -0,0 +1,353 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "snapshot.h"
+#include "zx_mirror.h"
+#include "machine_profile.h"
+
+/*
+ * Output is gathered into a small buffer and passed to the sink when it fills.
+ * With no sink the bytes are only counted, which is how the compressed size of
+ * a .Z80 page is found before the page itself is written.
+ */
+typedef struct _snapshot_writer
+{
+  SNAPSHOT_SINK sink;
+  void         *user_data;
+  bool          failed;
+  uint32_t      count;
+  uint32_t      used;
+  uint8_t       buffer[256];
+}
+SNAPSHOT_WRITER;
+
+static void flush_snapshot( SNAPSHOT_WRITER *writer )
+{
+  if( writer->sink != NULL && writer->used != 0 && !writer->failed )
+  {
+    if( !writer->sink( writer->buffer, writer->used, writer->user_data ) )
+      writer->failed = true;
+  }
+  writer->used = 0;
+}
+
+static void put_snapshot_byte( SNAPSHOT_WRITER *writer, const uint8_t value )
+{
+  writer->count++;
+
+  if( writer->sink == NULL )
+    return;
+
+  writer->buffer[writer->used++] = value;
+  if( writer->used == sizeof(writer->buffer) )
+    flush_snapshot( writer );
+}
+
+static void put_snapshot_word( SNAPSHOT_WRITER *writer, const uint16_t value )
+{
+  put_snapshot_byte( writer, value & 0xFF );
+  put_snapshot_byte( writer, value >> 8 );
+}
+
+/*
+ * Pass a block of memory straight to the sink in chunks, no copying.
+ */
+static void put_snapshot_block( SNAPSHOT_WRITER *writer, const uint8_t *data, uint32_t length )
+{
+  flush_snapshot( writer );
+
+  while( length != 0 && !writer->failed )
+  {
+    const uint32_t chunk = (length > SNAPSHOT_CHUNK_SIZE) ? SNAPSHOT_CHUNK_SIZE : length;
+
+    if( !writer->sink( data, chunk, writer->user_data ) )
+      writer->failed = true;
+
+    writer->count += chunk;
+    data          += chunk;
+    length        -= chunk;
+  }
+}
+
+/*
+ * The 16K RAM bank which appears at the given address, 0x4000 upwards.
+ */
+static const uint8_t *snapshot_segment( const uint32_t zx_addr )
+{
+  return (const uint8_t*)query_zx_mirror_ptr( (ZX_ADDR)(zx_addr & ~ZX_SEGMENT_MASK) );
+}
+
+static bool is_128k( void )
+{
+  return query_machine_profile()->num_ram_banks == ZX_NUM_RAM_BANKS;
+}
+
+/*
+ * .SNA. 27 byte header then the RAM from 0x4000. A 48K .SNA has no PC in the
+ * header, it's pushed onto the stack. That's done on the fly as the RAM goes
+ * out, the mirror itself isn't touched. A 128K .SNA has the PC and the paging
+ * latch after the first 48K, then the banks which weren't paged in.
+ */
+static SNAPSHOT_STATUS write_sna( SNAPSHOT_WRITER *writer, const ZX_REGISTERS *regs )
+{
+  const bool     large     = is_128k();
+  const uint32_t pushed_sp = (uint16_t)(regs->sp - 2);
+
+  if( !large && (pushed_sp < 0x4000 || pushed_sp > 0xFFFE) )
+    return SNAPSHOT_BAD_STACK;
+
+  put_snapshot_byte( writer, regs->i );
+  put_snapshot_word( writer, regs->hl_alt );
+  put_snapshot_word( writer, regs->de_alt );
+  put_snapshot_word( writer, regs->bc_alt );
+  put_snapshot_word( writer, regs->af_alt );
+  put_snapshot_word( writer, regs->hl );
+  put_snapshot_word( writer, regs->de );
+  put_snapshot_word( writer, regs->bc );
+  put_snapshot_word( writer, regs->iy );
+  put_snapshot_word( writer, regs->ix );
+  put_snapshot_byte( writer, regs->iff2 ? 0x04 : 0x00 );
+  put_snapshot_byte( writer, regs->r );
+  put_snapshot_word( writer, regs->af );
+  put_snapshot_word( writer, large ? regs->sp : pushed_sp );
+  put_snapshot_byte( writer, regs->im );
+  put_snapshot_byte( writer, query_zx_ula_port() & 0x07 );
+
+  if( large )
+  {
+    const uint8_t latch = query_zx_paging_latch();
+    const uint8_t paged = latch & ZX_PAGING_RAM_BANK_MASK;
+
+    put_snapshot_block( writer, query_zx_mirror_bank_ptr( 5 ), ZX_SEGMENT_SIZE );
+    put_snapshot_block( writer, query_zx_mirror_bank_ptr( 2 ), ZX_SEGMENT_SIZE );
+    put_snapshot_block( writer, query_zx_mirror_bank_ptr( paged ), ZX_SEGMENT_SIZE );
+
+    put_snapshot_word( writer, regs->pc );
+    put_snapshot_byte( writer, latch );
+    put_snapshot_byte( writer, 0 );          // TR-DOS not paged
+
+    for( uint8_t bank=0; bank < ZX_NUM_RAM_BANKS; bank++ )
+    {
+      if( bank != 5 && bank != 2 && bank != paged )
+        put_snapshot_block( writer, query_zx_mirror_bank_ptr( bank ), ZX_SEGMENT_SIZE );
+    }
+  }
+  else
+  {
+    /* Everything up to the pushed PC, the PC, then the rest */
+    for( uint32_t zx_addr=0x4000; zx_addr < pushed_sp; )
+    {
+      uint32_t length = ZX_SEGMENT_SIZE - (zx_addr & ZX_SEGMENT_MASK);
+      if( zx_addr + length > pushed_sp )
+        length = pushed_sp - zx_addr;
+
+      put_snapshot_block( writer, snapshot_segment( zx_addr ) + (zx_addr & ZX_SEGMENT_MASK), length );
+      zx_addr += length;
+    }
+
+    put_snapshot_word( writer, regs->pc );
+
+    for( uint32_t zx_addr=pushed_sp+2; zx_addr < ZX_MEMORY_SIZE; )
+    {
+      const uint32_t length = ZX_SEGMENT_SIZE - (zx_addr & ZX_SEGMENT_MASK);
+
+      put_snapshot_block( writer, snapshot_segment( zx_addr ) + (zx_addr & ZX_SEGMENT_MASK), length );
+      zx_addr += length;
+    }
+  }
+
+  flush_snapshot( writer );
+  return SNAPSHOT_OK;
+}
+
+/*
+ * .Z80 compression of one 16K page. Runs of 5 or more of a byte, or 2 or more
+ * EDs, become ED ED count byte. A byte straight after a lone ED is never the
+ * start of a run.
+ */
+static void compress_z80_page( SNAPSHOT_WRITER *writer, const uint8_t *page )
+{
+  uint32_t i = 0;
+
+  while( i < ZX_SEGMENT_SIZE )
+  {
+    const uint8_t value = page[i];
+    uint32_t      run   = 1;
+
+    while( i+run < ZX_SEGMENT_SIZE && page[i+run] == value && run < 255 )
+      run++;
+
+    if( run >= 5 || (value == 0xED && run >= 2) )
+    {
+      put_snapshot_byte( writer, 0xED );
+      put_snapshot_byte( writer, 0xED );
+      put_snapshot_byte( writer, run );
+      put_snapshot_byte( writer, value );
+      i += run;
+    }
+    else if( value == 0xED )
+    {
+      put_snapshot_byte( writer, 0xED );
+      i++;
+
+      if( i < ZX_SEGMENT_SIZE )
+        put_snapshot_byte( writer, page[i++] );
+    }
+    else
+    {
+      put_snapshot_byte( writer, value );
+      i++;
+    }
+  }
+}
+
+/*
+ * A .Z80 page block has the compressed length first. It's found by running
+ * the compression with nothing to write to, then the page is written for real.
+ * Compressing twice is cheaper than finding 16K to compress into. If it doesn't
+ * get any smaller it's stored as is, which a length of 0xFFFF says.
+ */
+static void write_z80_page( SNAPSHOT_WRITER *writer, const uint8_t page_number, const uint8_t *page )
+{
+  SNAPSHOT_WRITER counter = { .sink = NULL };
+  compress_z80_page( &counter, page );
+
+  if( counter.count >= ZX_SEGMENT_SIZE )
+  {
+    put_snapshot_word( writer, 0xFFFF );
+    put_snapshot_byte( writer, page_number );
+    put_snapshot_block( writer, page, ZX_SEGMENT_SIZE );
+  }
+  else
+  {
+    put_snapshot_word( writer, counter.count );
+    put_snapshot_byte( writer, page_number );
+    compress_z80_page( writer, page );
+  }
+}
+
+/*
+ * .Z80 version 3. 30 byte header, 54 byte additional header, then the pages.
+ */
+#define Z80_V3_EXTRA_HEADER_LENGTH  54
+#define Z80_HARDWARE_48K            0
+#define Z80_HARDWARE_128K           4
+
+static SNAPSHOT_STATUS write_z80( SNAPSHOT_WRITER *writer, const ZX_REGISTERS *regs )
+{
+  const bool large = is_128k();
+
+  put_snapshot_byte( writer, regs->af >> 8 );
+  put_snapshot_byte( writer, regs->af & 0xFF );
+  put_snapshot_word( writer, regs->bc );
+  put_snapshot_word( writer, regs->hl );
+  put_snapshot_word( writer, 0 );                 // PC 0 means it's in the additional header
+  put_snapshot_word( writer, regs->sp );
+  put_snapshot_byte( writer, regs->i );
+  put_snapshot_byte( writer, regs->r & 0x7F );
+  put_snapshot_byte( writer, ((regs->r >> 7) & 0x01) | ((query_zx_ula_port() & 0x07) << 1) );
+  put_snapshot_word( writer, regs->de );
+  put_snapshot_word( writer, regs->bc_alt );
+  put_snapshot_word( writer, regs->de_alt );
+  put_snapshot_word( writer, regs->hl_alt );
+  put_snapshot_byte( writer, regs->af_alt >> 8 );
+  put_snapshot_byte( writer, regs->af_alt & 0xFF );
+  put_snapshot_word( writer, regs->iy );
+  put_snapshot_word( writer, regs->ix );
+  put_snapshot_byte( writer, regs->iff1 ? 1 : 0 );
+  put_snapshot_byte( writer, regs->iff2 ? 1 : 0 );
+  put_snapshot_byte( writer, regs->im & 0x03 );
+
+  put_snapshot_word( writer, Z80_V3_EXTRA_HEADER_LENGTH );
+  put_snapshot_word( writer, regs->pc );
+  put_snapshot_byte( writer, large ? Z80_HARDWARE_128K : Z80_HARDWARE_48K );
+  put_snapshot_byte( writer, large ? query_zx_paging_latch() : 0 );
+
+  /* Interface 1, emulation flags, AY, T-states, peripherals: none of it known or relevant */
+  for( uint32_t i=0; i < 25; i++ )
+    put_snapshot_byte( writer, 0 );
+
+  /* 0x0000-0x3FFF is ROM */
+  put_snapshot_byte( writer, 0xFF );
+  put_snapshot_byte( writer, 0xFF );
+
+  /* Joystick mappings, MGT and Disciple settings */
+  for( uint32_t i=0; i < 23; i++ )
+    put_snapshot_byte( writer, 0 );
+
+  if( large )
+  {
+    /* 128K pages are the bank number plus 3 */
+    for( uint8_t bank=0; bank < ZX_NUM_RAM_BANKS; bank++ )
+      write_z80_page( writer, bank+3, query_zx_mirror_bank_ptr( bank ) );
+  }
+  else
+  {
+    write_z80_page( writer, 8, snapshot_segment( 0x4000 ) );
+    write_z80_page( writer, 4, snapshot_segment( 0x8000 ) );
+    write_z80_page( writer, 5, snapshot_segment( 0xC000 ) );
+  }
+
+  flush_snapshot( writer );
+  return SNAPSHOT_OK;
+}
+
+/*
+ * Write a snapshot of the Spectrum in the given format. If regs is NULL the
+ * registers aren't known and they're all zero (so the snapshot resets the
+ * Spectrum when it's loaded, but the memory is all there to be looked at),
+ * apart from SP at the top of RAM and interrupt mode 1.
+ */
+SNAPSHOT_STATUS write_zx_snapshot( const SNAPSHOT_FORMAT format, const ZX_REGISTERS *regs,
+                                   SNAPSHOT_SINK sink, void *user_data )
+{
+  if( sink == NULL )
+    return SNAPSHOT_BAD_ARG;
+
+  ZX_REGISTERS unknown_regs;
+  if( regs == NULL )
+  {
+    memset( &unknown_regs, 0, sizeof(unknown_regs) );
+    unknown_regs.sp = 0xFFFF;
+    unknown_regs.im = 1;
+    regs = &unknown_regs;
+  }
+
+  SNAPSHOT_WRITER writer = { .sink = sink, .user_data = user_data };
+
+  SNAPSHOT_STATUS status;
+  switch( format )
+  {
+  case SNAPSHOT_FORMAT_SNA:
+    status = write_sna( &writer, regs );
+    break;
+  case SNAPSHOT_FORMAT_Z80:
+    status = write_z80( &writer, regs );
+    break;
+  default:
+    return SNAPSHOT_BAD_ARG;
+  }
+
+  if( status == SNAPSHOT_OK && writer.failed )
+    return SNAPSHOT_SINK_FAILED;
+
+  return status;
+}
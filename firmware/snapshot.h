@@ -0,0 +1,84 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __SNAPSHOT_H
+#define __SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * Snapshot writer. Produces a .SNA or .Z80 snapshot of the Spectrum from the
+ * mirror, without stopping the Z80. The file is handed over to a sink function
+ * a chunk at a time as it's made; there's never a full size copy of it in RP2350
+ * memory. The sink is whatever's going to store or send it.
+ *
+ * The mirror keeps changing while the snapshot is made, so unless the Z80 is
+ * sitting still (in a register dump stub, say, or a HALT) the snapshot is a
+ * smear over the few milliseconds it takes.
+ */
+
+typedef enum
+{
+  SNAPSHOT_FORMAT_SNA,
+  SNAPSHOT_FORMAT_Z80,       // Version 3, compressed
+}
+SNAPSHOT_FORMAT;
+
+typedef enum
+{
+  SNAPSHOT_OK = 0,
+  SNAPSHOT_BAD_ARG,
+  SNAPSHOT_BAD_STACK,        // 48K .SNA needs PC pushed, and SP doesn't point into RAM
+  SNAPSHOT_SINK_FAILED,
+}
+SNAPSHOT_STATUS;
+
+/*
+ * The Z80's registers. The coprocessor can't see these, so they have to come
+ * from the Z80 itself: a small stub which saves them into memory and then
+ * runs whatever it likes (e.g. a coprocessor command) before restoring them.
+ * This is the layout the stub writes them in, 16 bit values little endian,
+ * so it can be picked straight out of the mirror with copy_from_zx_mirror().
+ *
+ * sp and pc are where the Z80 is to carry on from when the snapshot is loaded.
+ */
+typedef struct __attribute__((packed)) _zx_registers
+{
+  uint16_t af, bc, de, hl;
+  uint16_t af_alt, bc_alt, de_alt, hl_alt;
+  uint16_t ix, iy;
+  uint16_t sp, pc;
+  uint8_t  i, r;
+  uint8_t  iff1, iff2;
+  uint8_t  im;
+}
+ZX_REGISTERS;
+
+/* Data is passed in chunks no bigger than this */
+#define SNAPSHOT_CHUNK_SIZE  ((uint32_t)1024)
+
+/* Return false to abandon the snapshot */
+typedef bool (*SNAPSHOT_SINK)( const uint8_t *data, const uint32_t length, void *user_data );
+
+SNAPSHOT_STATUS write_zx_snapshot( const SNAPSHOT_FORMAT format, const ZX_REGISTERS *regs,
+                                   SNAPSHOT_SINK sink, void *user_data );
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stddef.h>
+
+#include "pico.h"
+#include "hardware/sync.h"
+
+#include "tape_trap.h"
+#include "rom_trap.h"
+#include "zx_mirror.h"
+#include "zx_memory_management.h"
+#include "dma_engine.h"
+
+/*
+ * The Z80 has to wait while a block is loaded, and LD-BYTES has to return as
+ * if the block came off the tape. The ROM trap engine can only say a ROM
+ * address has been fetched, so the waiting is done by a stub in the ROM's
+ * spare space (0x386E to 0x3CFF is all 0xFF in the 48K ROM), with a copy of
+ * the ROM which has the first instruction of LD-BYTES patched to jump to it.
+ *
+ * The stub writes the registers LD-BYTES was called with into the ROM area.
+ * The Spectrum ignores those writes, but core1 mirrors them, which is how
+ * they get here. Then it spins on a status byte in the ROM image. The ROM
+ * image is ordinary RP2350 memory so core0 sets the status once the block is
+ * loaded, along with the IX and DE LD-BYTES would have left, and the stub
+ * returns the way LD-BYTES does, carry set for success.
+ *
+ * If there's no tape, or it's run out, the stub runs the real LD-BYTES. The
+ * patch replaces INC D / EX AF,AF' / DEC D so the stub does those first.
+ *
+ *  3900  DD 22 80 39     LD (PARAMS_IX),IX
+ *  3904  ED 53 82 39     LD (PARAMS_DE),DE
+ *  3908  D5              PUSH DE
+ *  3909  F5              PUSH AF
+ *  390A  D1              POP DE
+ *  390B  ED 53 84 39     LD (PARAMS_AF),DE
+ *  390F  D1              POP DE
+ *  3910  00              NOP                   <- entry trap
+ *  3911  3A 86 39        LD A,(STATUS)
+ *  3914  A7              AND A
+ *  3915  28 FA           JR Z,3911
+ *  3917  FE 82           CP STATUS_NO_TAPE     <- exit trap
+ *  3919  28 0B           JR Z,3926
+ *  391B  DD 2A 88 39     LD IX,(RESULT_IX)
+ *  391F  ED 5B 8A 39     LD DE,(RESULT_DE)
+ *  3923  1F              RRA
+ *  3924  FB              EI
+ *  3925  C9              RET
+ *  3926  E5              PUSH HL
+ *  3927  2A 8C 39        LD HL,(CALLER_AF)
+ *  392A  E5              PUSH HL
+ *  392B  F1              POP AF
+ *  392C  E1              POP HL
+ *  392D  14              INC D
+ *  392E  08              EX AF,AF'
+ *  392F  15              DEC D
+ *  3930  C3 59 05        JP LD-BYTES+3
+ */
+#define LD_BYTES               ((ZX_ADDR)0x0556)
+
+#define TAPE_STUB              ((ZX_ADDR)0x3900)
+#define TAPE_ENTRY_TRAP        ((ZX_ADDR)0x3910)
+#define TAPE_EXIT_TRAP         ((ZX_ADDR)0x3917)
+
+/* Written by the stub, so they're in the mirror */
+#define TAPE_PARAMS_IX         ((ZX_ADDR)0x3980)
+#define TAPE_PARAMS_DE         ((ZX_ADDR)0x3982)
+#define TAPE_PARAMS_AF         ((ZX_ADDR)0x3984)
+
+/* Written by core0, so they're in the ROM image */
+#define TAPE_STATUS            ((ZX_ADDR)0x3986)
+#define TAPE_RESULT_IX         ((ZX_ADDR)0x3988)
+#define TAPE_RESULT_DE         ((ZX_ADDR)0x398A)
+#define TAPE_CALLER_AF         ((ZX_ADDR)0x398C)
+
+#define TAPE_STUB_AREA_END     ((ZX_ADDR)0x3990)
+
+/* Bit 0 becomes the carry flag */
+#define TAPE_STATUS_BUSY       0x00
+#define TAPE_STATUS_FAILED     0x80
+#define TAPE_STATUS_LOADED     0x81
+#define TAPE_STATUS_NO_TAPE    0x82
+
+static const uint8_t ld_bytes_original[] = { 0x14, 0x08, 0x15, 0xF3 };
+
+static const uint8_t tape_stub[] =
+{
+  0xDD, 0x22, 0x80, 0x39,
+  0xED, 0x53, 0x82, 0x39,
+  0xD5,
+  0xF5,
+  0xD1,
+  0xED, 0x53, 0x84, 0x39,
+  0xD1,
+  0x00,
+  0x3A, 0x86, 0x39,
+  0xA7,
+  0x28, 0xFA,
+  0xFE, TAPE_STATUS_NO_TAPE,
+  0x28, 0x0B,
+  0xDD, 0x2A, 0x88, 0x39,
+  0xED, 0x5B, 0x8A, 0x39,
+  0x1F,
+  0xFB,
+  0xC9,
+  0xE5,
+  0x2A, 0x8C, 0x39,
+  0xE5,
+  0xF1,
+  0xE1,
+  0x14,
+  0x08,
+  0x15,
+  0xC3, 0x59, 0x05,
+};
+
+/* The patched ROM, shared with the other trap stubs */
+static uint8_t *tape_rom_image = NULL;
+
+static const uint8_t *tape_image    = NULL;
+static uint32_t       tape_length   = 0;
+static uint32_t       tape_position = 0;
+
+/*
+ * Instant loading is off by default. It replaces the active ROM with the
+ * patched copy, which changes its checksum.
+ */
+inline uint32_t using_tape_traps( void )
+{
+#define USE_TAPE_TRAPS 0
+  return USE_TAPE_TRAPS;
+}
+
+/*
+ * The tape image has to stay put until it's ejected or another one's inserted.
+ */
+void insert_tape_image( const uint8_t *tap, const uint32_t length )
+{
+  tape_image    = tap;
+  tape_length   = (tap == NULL) ? 0 : length;
+  tape_position = 0;
+}
+
+void eject_tape_image( void )
+{
+  insert_tape_image( NULL, 0 );
+}
+
+uint32_t query_tape_position( void )
+{
+  return tape_position;
+}
+
+static uint16_t get_mirror_word( const ZX_ADDR zx_addr )
+{
+  return get_zx_mirror_byte( zx_addr ) | (get_zx_mirror_byte( zx_addr+1 ) << 8);
+}
+
+static void put_image_word( const ZX_ADDR zx_addr, const uint16_t value )
+{
+  tape_rom_image[zx_addr]   = value & 0xFF;
+  tape_rom_image[zx_addr+1] = value >> 8;
+}
+
+/*
+ * Put the block into Spectrum memory, or compare it with what's there for a
+ * VERIFY. Returns false if the DMA failed or the verify didn't match.
+ */
+static bool load_tape_data( const uint8_t *data, const ZX_ADDR zx_addr, const uint32_t length, const bool load )
+{
+  if( !load )
+  {
+    for( uint32_t i=0; i < length; i++ )
+    {
+      if( get_zx_mirror_byte( zx_addr+i ) != data[i] )
+        return false;
+    }
+    return true;
+  }
+
+  /*
+   * The Z80 is waiting in the stub with interrupts on, LD-BYTES hasn't got as
+   * far as its DI, so the block goes in pieces the interrupt protection can
+   * keep clear of /INT.
+   */
+  return (dma_memory_block_int_safe( data, zx_addr, length ) == DMA_STATUS_OK);
+}
+
+/*
+ * The Z80 has called LD-BYTES and is waiting in the stub. Load the next block
+ * off the tape the way LD-BYTES would: the flag byte has to match A, DE bytes
+ * go to IX, and it only succeeds if the block was exactly that long and the
+ * checksum is right. The tape moves on past the block whatever happens.
+ */
+static void tape_entry_trap( const ZX_ADDR zx_addr, void *user_data )
+{
+  if( !is_rom_trap_image_running() )
+    return;
+
+  const ZX_ADDR  ix = get_mirror_word( TAPE_PARAMS_IX );
+  const uint16_t de = get_mirror_word( TAPE_PARAMS_DE );
+  const uint16_t af = get_mirror_word( TAPE_PARAMS_AF );
+
+  const uint8_t  flag = af >> 8;
+  const bool     load = (af & 0x01) != 0;    // Carry set for LOAD, clear for VERIFY
+
+  put_image_word( TAPE_RESULT_IX, ix );
+  put_image_word( TAPE_RESULT_DE, de );
+  put_image_word( TAPE_CALLER_AF, af );
+
+  uint8_t status = TAPE_STATUS_NO_TAPE;
+
+  if( tape_image != NULL && tape_position+2 <= tape_length )
+  {
+    const uint32_t block_length = tape_image[tape_position] | (tape_image[tape_position+1] << 8);
+    const uint8_t *block        = tape_image + tape_position + 2;
+
+    if( tape_position + 2 + block_length <= tape_length )
+    {
+      tape_position += 2 + block_length;
+      status = TAPE_STATUS_FAILED;
+
+      if( block_length >= 2 && block[0] == flag )
+      {
+        const uint32_t data_length = block_length - 2;
+
+        /* It stops at the top of memory, same as the ROM would (more or less) */
+        uint32_t length = (de < data_length) ? de : data_length;
+        if( ix + length > 0x10000 )
+          length = 0x10000 - ix;
+
+        uint8_t parity = 0;
+        for( uint32_t i=0; i < block_length; i++ )
+          parity ^= block[i];
+
+        const bool transferred = (length == 0) || load_tape_data( block+1, ix, length, load );
+
+        put_image_word( TAPE_RESULT_IX, (ix + length) & 0xFFFF );
+        put_image_word( TAPE_RESULT_DE, de - length );
+
+        if( transferred && de == data_length && parity == 0 )
+          status = TAPE_STATUS_LOADED;
+      }
+    }
+  }
+
+  /* The results have to be in place before the stub sees the status */
+  __dmb();
+  tape_rom_image[TAPE_STATUS] = status;
+}
+
+/*
+ * Put the stub into the patched ROM, divert LD-BYTES to it and set the traps.
+ * Needs full ROM emulation and the ROM traps, and the ROM has to be one the
+ * patch fits. Returns false if instant loading can't be used.
+ */
+bool init_tape_traps( void )
+{
+  if( !using_rom_traps() )
+    return false;
+
+  uint8_t *image = open_rom_trap_image();
+  if( image == NULL )
+    return false;
+
+  if( memcmp( query_rom_trap_original()+LD_BYTES, ld_bytes_original, sizeof(ld_bytes_original) ) != 0 )
+    return false;
+
+  if( !is_rom_trap_space_free( TAPE_STUB, TAPE_STUB_AREA_END ) )
+    return false;
+
+  tape_rom_image = image;
+
+  if( add_rom_trap( TAPE_ENTRY_TRAP, tape_entry_trap, NULL ) == ROM_TRAP_NONE )
+    return false;
+
+  /* The stub has seen the status, core1 puts it back to busy for next time */
+  if( add_rom_release_trap( TAPE_EXIT_TRAP, TAPE_STATUS, TAPE_STATUS_BUSY ) == ROM_TRAP_NONE )
+    return false;
+
+  memcpy( image+TAPE_STUB, tape_stub, sizeof(tape_stub) );
+  memset( image+TAPE_PARAMS_IX, 0, TAPE_STUB_AREA_END-TAPE_PARAMS_IX );
+
+  /* The stub has to be in place before anything can jump to it */
+  __dmb();
+  image[LD_BYTES+1] = TAPE_STUB & 0xFF;
+  image[LD_BYTES+2] = TAPE_STUB >> 8;
+  __dmb();
+  image[LD_BYTES]   = 0xC3;
+
+  return true;
+}
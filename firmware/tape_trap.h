@@ -0,0 +1,41 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __TAPE_TRAP_H
+#define __TAPE_TRAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Instant tape loading. The ROM's LD-BYTES routine is diverted, via a ROM
+ * trap, to the coprocessor which DMAs the next block of a .TAP image straight
+ * into the Spectrum's memory. Anything which loads through LD-BYTES, i.e.
+ * LOAD from BASIC and most loaders which aren't turbo loaders, loads in
+ * milliseconds.
+ */
+uint32_t using_tape_traps( void );
+
+bool init_tape_traps( void );
+
+void insert_tape_image( const uint8_t *tap, const uint32_t length );
+void eject_tape_image( void );
+uint32_t query_tape_position( void );
+
+#endif
@@ -33,6 +33,7 @@ typedef enum
   
   TRACE_TABLE_ZXCOPRO_STATUS_SET = 0x08,
   TRACE_TABLE_ZXCOPRO_ERROR_SET  = 0x10,
+  TRACE_TABLE_MISSED_INT_SET     = 0x20,
 }
 TRACE_TABLE_ENTRY_STATUS;
 
@@ -55,6 +56,8 @@ typedef struct _TRACE_TABLE_ENTRY
 
   DMA_STATUS     dma_status;
   CMD_ERROR      error;
+
+  uint32_t       missed_ints;
 }
 TRACE_TABLE_ENTRY;
 
@@ -109,4 +112,11 @@ void trace_table_set_dma_mode(  const DMA_MODE dma_mode )
 {
   trace_table[current_entry_index].dma_mode        = dma_mode;
 
+}
+
+void trace_table_set_missed_int( const uint32_t missed_ints )
+{
+  trace_table[current_entry_index].missed_ints     = missed_ints;
+
+  trace_table[current_entry_index].entry_status    |= TRACE_TABLE_MISSED_INT_SET;
 }
\ No newline at end of file
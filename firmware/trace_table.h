@@ -31,6 +31,7 @@ void trace_table_set_dma_args(  const uint8_t *src, const ZX_ADDR zx_ram_locatio
 void trace_table_set_dma_mode(  const DMA_MODE dma_mode );
 void trace_table_set_status(  const ZXCOPRO_STATUS status );
 void trace_table_set_error(  const ZXCOPRO_STATUS error );
+void trace_table_set_missed_int( const uint32_t missed_ints );
 
 
 #endif
@@ -0,0 +1,223 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+
+#include "write_log.h"
+#include "machine_profile.h"
+#include "zx_mirror.h"
+
+inline uint32_t using_write_log( void )
+{
+#define USE_WRITE_LOG 0
+  return USE_WRITE_LOG;
+}
+
+/*
+ * The log is 128K, half entries and half the start image, so it only exists
+ * when it's switched on. See zx_mirror.c
+ * for where the rest of the RAM goes.
+ */
+#if USE_WRITE_LOG
+
+static WRITE_LOG write_log;
+
+/*
+ * Core1's idea of the current frame. The frame starts at the falling edge of
+ * /INT, which core1 spots in the bus samples it's taking anyway. The T-state
+ * is worked out from the time since then. The timer's only good to 1us, which
+ * is 3 or 4 T-states, so that's as accurate as it gets.
+ */
+static uint32_t write_log_frame          = 0;
+static uint32_t write_log_frame_start_us = 0;
+
+/* T-states per microsecond, in 24.8 fixed point so core1 doesn't have to divide */
+static uint32_t tstates_per_us_x256      = 0;
+
+void init_write_log( void )
+{
+  const ZX_MACHINE_PROFILE *profile = query_machine_profile();
+
+  memset( &write_log, 0, sizeof(write_log) );
+
+  write_log.magic            = WRITE_LOG_MAGIC;
+  write_log.entry_size       = sizeof(WRITE_LOG_ENTRY);
+  write_log.num_entries      = NUM_WRITE_LOG_ENTRIES;
+  write_log.cpu_clock_hz     = profile->cpu_clock_hz;
+  write_log.frame_tstates    = profile->frame_tstates;
+  write_log.tstates_per_line = profile->tstates_per_line;
+
+  tstates_per_us_x256 = (uint32_t)(((uint64_t)profile->cpu_clock_hz * 256) / 1000000);
+
+  write_log_frame          = 0;
+  write_log_frame_start_us = time_us_32();
+}
+
+/*
+ * Core1 has seen /INT go low.
+ */
+void __scratch_x("write_log_new_frame") write_log_new_frame( void )
+{
+  write_log_frame++;
+  write_log_frame_start_us = time_us_32();
+}
+
+/*
+ * Core1 has snooped a write. Log it if there's room.
+ */
+void __scratch_x("write_log_zx_write") write_log_zx_write( const ZX_ADDR zx_addr, const ZX_BYTE value, const uint8_t flags )
+{
+  if( !write_log.armed )
+    return;
+
+  /* The fetch command's own DMA would fill the log as fast as it's drained */
+  if( (flags & WRITE_LOG_FLAG_DMA) && write_log.skip_dma )
+  {
+    write_log.skip_dma--;
+    return;
+  }
+
+  const uint32_t head = write_log.head;
+  const uint32_t next = (head + 1) % NUM_WRITE_LOG_ENTRIES;
+
+  if( next == write_log.tail )
+  {
+    write_log.dropped++;
+    return;
+  }
+
+  uint32_t tstate = ((time_us_32() - write_log_frame_start_us) * tstates_per_us_x256) >> 8;
+  if( tstate > WRITE_LOG_TSTATE_MASK )
+    tstate = WRITE_LOG_TSTATE_MASK;
+
+  WRITE_LOG_ENTRY *entry = &write_log.entries[head];
+
+  entry->frame_tstate = ((write_log_frame & WRITE_LOG_FRAME_MASK) << WRITE_LOG_TSTATE_BITS) | tstate;
+  entry->address      = zx_addr;
+  entry->value        = value;
+  entry->flags        = flags;
+
+  /* The entry has to be complete before core0 can see it */
+  __dmb();
+  write_log.head = next;
+}
+
+/*
+ * Start logging. Core1 is told first, then the memory is copied. A write
+ * which lands while the copy's being taken may be in the image as well as
+ * the log, which doesn't matter, replaying it again gives the same byte.
+ * The other way round a write could be in neither.
+ */
+void arm_write_log( void )
+{
+  write_log.armed = 1;
+  __dmb();
+
+  copy_from_zx_mirror( write_log.start_image, 0, WRITE_LOG_IMAGE_SIZE );
+}
+
+bool is_write_log_armed( void )
+{
+  return write_log.armed;
+}
+
+/*
+ * Don't log the next num_writes DMA writes. Only the fetch command does this,
+ * for the DMA which hands the entries back. It's a count rather than an on
+ * and off so it doesn't matter how far behind the bus core1 is. 0 cancels
+ * what's left, e.g. if the DMA was refused.
+ */
+void skip_write_log_dma( const uint32_t num_writes )
+{
+  write_log.skip_dma = num_writes;
+  __dmb();
+}
+
+/*
+ * Copy up to max_entries of the oldest entries out of the log, freeing the
+ * space they took. Returns the number copied.
+ */
+uint32_t drain_write_log( WRITE_LOG_ENTRY *dest, const uint32_t max_entries )
+{
+  const uint32_t head = write_log.head;
+  uint32_t       tail = write_log.tail;
+  uint32_t       count = 0;
+
+  __dmb();
+
+  while( (tail != head) && (count < max_entries) )
+  {
+    dest[count++] = write_log.entries[tail];
+    tail = (tail + 1) % NUM_WRITE_LOG_ENTRIES;
+  }
+
+  /* Core1 mustn't reuse the space until the copies are done */
+  __dmb();
+  write_log.tail = tail;
+
+  return count;
+}
+
+uint32_t query_write_log_dropped( void )
+{
+  return write_log.dropped;
+}
+
+#else
+
+/* Switched off. Everything which calls these checks using_write_log() first. */
+void init_write_log( void )
+{
+}
+
+void write_log_new_frame( void )
+{
+}
+
+void write_log_zx_write( const ZX_ADDR zx_addr, const ZX_BYTE value, const uint8_t flags )
+{
+}
+
+void arm_write_log( void )
+{
+}
+
+bool is_write_log_armed( void )
+{
+  return false;
+}
+
+void skip_write_log_dma( const uint32_t num_writes )
+{
+}
+
+uint32_t drain_write_log( WRITE_LOG_ENTRY *dest, const uint32_t max_entries )
+{
+  return 0;
+}
+
+uint32_t query_write_log_dropped( void )
+{
+  return 0;
+}
+
+#endif
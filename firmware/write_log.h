@@ -0,0 +1,117 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __WRITE_LOG_H
+#define __WRITE_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * Write log. An optional record of every write core1 snoops, with the frame
+ * and the T-state within the frame it happened at. It's for working out what
+ * a game does with its memory, and for building realistic workloads to try
+ * the DMA paths against. tools/write_log_replay.c rebuilds the memory image
+ * from a dump of it.
+ *
+ * Nothing's logged until the ROM has finished booting, its RAM test would
+ * fill the log on its own. When logging starts the memory is copied into the
+ * log, which is where the replay starts from. The Z80 drains the log with
+ * the fetch_write_log command, anything left can be dumped from the debugger.
+ *
+ * This header is shared with the replayer, so it has to stay plain C.
+ */
+#define WRITE_LOG_MAGIC          ((uint32_t)0x4C57585A)     // "ZXWL"
+#define NUM_WRITE_LOG_ENTRIES    8192
+#define WRITE_LOG_IMAGE_SIZE     65536
+
+/* Most entries the fetch_write_log command hands back in one go */
+#define WRITE_LOG_MAX_FETCH      128
+
+/*
+ * The frame number and T-state share a word. 17 bits covers the longest
+ * frame (70908 T-states on a 128K), which leaves 15 for the frame number.
+ * That wraps after about 11 minutes, the replayer unwraps it.
+ */
+#define WRITE_LOG_TSTATE_BITS    17
+#define WRITE_LOG_TSTATE_MASK    ((1UL << WRITE_LOG_TSTATE_BITS) - 1)
+#define WRITE_LOG_FRAME_MASK     (0xFFFFFFFFUL >> WRITE_LOG_TSTATE_BITS)
+
+#define WRITE_LOG_FRAME(E)       ((E)->frame_tstate >> WRITE_LOG_TSTATE_BITS)
+#define WRITE_LOG_TSTATE(E)      ((E)->frame_tstate & WRITE_LOG_TSTATE_MASK)
+
+typedef enum
+{
+  WRITE_LOG_FLAG_NONE = 0x00,
+  WRITE_LOG_FLAG_DMA  = 0x01,    // Written by the DMA engine, not the Z80
+}
+WRITE_LOG_FLAG;
+
+typedef struct _write_log_entry
+{
+  uint32_t  frame_tstate;
+  ZX_ADDR   address;
+  ZX_BYTE   value;
+  uint8_t   flags;
+}
+WRITE_LOG_ENTRY;
+
+/*
+ * The whole log, laid out so a binary dump of it from the debugger has
+ * everything the replayer needs. Core1 fills it at head, core0 drains it
+ * from tail. When it's full new writes are counted as dropped, not logged.
+ * start_image is the memory as it was when the log was armed.
+ */
+typedef struct _write_log
+{
+  uint32_t          magic;
+  uint32_t          entry_size;
+  uint32_t          num_entries;
+  uint32_t          cpu_clock_hz;
+  uint32_t          frame_tstates;
+  uint32_t          tstates_per_line;
+
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t dropped;
+  volatile uint32_t armed;
+  volatile uint32_t skip_dma;
+
+  uint8_t           start_image[WRITE_LOG_IMAGE_SIZE];
+  WRITE_LOG_ENTRY   entries[NUM_WRITE_LOG_ENTRIES];
+}
+WRITE_LOG;
+
+uint32_t using_write_log( void );
+
+void init_write_log( void );
+
+/* Core1 side */
+void write_log_new_frame( void );
+void write_log_zx_write( const ZX_ADDR zx_addr, const ZX_BYTE value, const uint8_t flags );
+
+/* Core0 side */
+void     arm_write_log( void );
+bool     is_write_log_armed( void );
+void     skip_write_log_dma( const uint32_t num_writes );
+uint32_t drain_write_log( WRITE_LOG_ENTRY *dest, const uint32_t max_entries );
+uint32_t query_write_log_dropped( void );
+
+#endif
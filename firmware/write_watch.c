@@ -0,0 +1,209 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+#include "write_watch.h"
+#include "cmd_immediate.h"
+
+typedef struct _WRITE_WATCH
+{
+  volatile bool        active;
+
+  ZX_ADDR              start;
+  ZX_ADDR              end;            // Inclusive
+  WATCH_MATCH          match;
+  ZX_BYTE              match_value;
+
+  WRITE_WATCH_CALLBACK callback;       // Either this is called...
+  void                *user_data;
+  ZX_ADDR              cmd_zx_addr;    // ...or the command at this Z80 address is run
+}
+WRITE_WATCH;
+
+static WRITE_WATCH write_watches[NUM_WRITE_WATCHES];
+
+/*
+ * One flag per 256 byte page of Z80 memory, set if any watch covers part of
+ * that page. This is all core1 has to look at for the vast majority of writes,
+ * so it's in scratch X with core1's loop.
+ */
+static volatile uint8_t write_watch_pages[256] __scratch_x("write_watch_pages");
+
+/* Events core1 couldn't post because core0 wasn't keeping up */
+static volatile uint32_t write_watch_events_dropped = 0;
+
+/*
+ * Events go from core1 to core0 through the inter-core FIFO, one 32 bit
+ * word each: watch id in the top byte, value written, then the address.
+ */
+#define WATCH_EVENT(ID,VALUE,ADDR)  (((uint32_t)(ID)<<24) | ((uint32_t)(VALUE)<<16) | (ADDR))
+#define WATCH_EVENT_ID(EVENT)       ((uint8_t)((EVENT)>>24))
+#define WATCH_EVENT_VALUE(EVENT)    ((ZX_BYTE)((EVENT)>>16))
+#define WATCH_EVENT_ADDR(EVENT)     ((ZX_ADDR)(EVENT))
+
+/*
+ * Rebuild the page flags from the active watches. A page flag only changes
+ * if the watches covering that page have changed, so core1 never sees a page
+ * flag go missing which an unchanged watch still needs.
+ */
+static void rebuild_write_watch_pages( void )
+{
+  uint8_t pages[256] = {0};
+
+  for( uint32_t i=0; i < NUM_WRITE_WATCHES; i++ )
+  {
+    if( !write_watches[i].active )
+      continue;
+
+    for( uint32_t page=(write_watches[i].start >> 8); page <= (uint32_t)(write_watches[i].end >> 8); page++ )
+      pages[page] = 1;
+  }
+
+  for( uint32_t page=0; page < 256; page++ )
+    write_watch_pages[page] = pages[page];
+}
+
+static uint8_t add_write_watch( const WRITE_WATCH *watch )
+{
+  if( watch->end < watch->start )
+    return WRITE_WATCH_NONE;
+
+  for( uint32_t i=0; i < NUM_WRITE_WATCHES; i++ )
+  {
+    if( write_watches[i].active )
+      continue;
+
+    write_watches[i] = *watch;
+
+    /* The entry has to be complete before core1 can see it's active */
+    __dmb();
+    write_watches[i].active = true;
+
+    rebuild_write_watch_pages();
+
+    return (uint8_t)i;
+  }
+
+  return WRITE_WATCH_NONE;
+}
+
+uint8_t add_write_watch_callback( const ZX_ADDR start, const ZX_ADDR end,
+                                  const WATCH_MATCH match, const ZX_BYTE match_value,
+                                  WRITE_WATCH_CALLBACK callback, void *user_data )
+{
+  if( callback == NULL )
+    return WRITE_WATCH_NONE;
+
+  const WRITE_WATCH watch = { .active = false, .start = start, .end = end,
+                              .match = match, .match_value = match_value,
+                              .callback = callback, .user_data = user_data };
+  return add_write_watch( &watch );
+}
+
+uint8_t add_write_watch_cmd( const ZX_ADDR start, const ZX_ADDR end,
+                             const WATCH_MATCH match, const ZX_BYTE match_value,
+                             const ZX_ADDR cmd_zx_addr )
+{
+  const WRITE_WATCH watch = { .active = false, .start = start, .end = end,
+                              .match = match, .match_value = match_value,
+                              .callback = NULL, .cmd_zx_addr = cmd_zx_addr };
+  return add_write_watch( &watch );
+}
+
+bool remove_write_watch( const uint8_t watch_id )
+{
+  if( watch_id >= NUM_WRITE_WATCHES || !write_watches[watch_id].active )
+    return false;
+
+  write_watches[watch_id].active = false;
+  rebuild_write_watch_pages();
+
+  return true;
+}
+
+/*
+ * Core1 calls this for every write it snoops, so it needs to be quick.
+ */
+inline bool __scratch_x("is_write_watched_page") is_write_watched_page( const ZX_ADDR zx_addr )
+{
+  return write_watch_pages[zx_addr >> 8];
+}
+
+/*
+ * Core1 calls this for a write into a watched page. old_value is what the
+ * mirror held before the write.
+ */
+void __scratch_x("check_write_watches") check_write_watches( const ZX_ADDR zx_addr, const ZX_BYTE value, const ZX_BYTE old_value )
+{
+  for( uint32_t i=0; i < NUM_WRITE_WATCHES; i++ )
+  {
+    const WRITE_WATCH *watch = &write_watches[i];
+
+    if( !watch->active || zx_addr < watch->start || zx_addr > watch->end )
+      continue;
+
+    if( (watch->match == WATCH_MATCH_VALUE && value != watch->match_value)
+        ||
+        (watch->match == WATCH_MATCH_CHANGED && value == old_value) )
+      continue;
+
+    /* Don't hold core1 up, if core0 isn't keeping up the event is lost */
+    if( multicore_fifo_wready() )
+      multicore_fifo_push_blocking_inline( WATCH_EVENT( i, value, zx_addr ) );
+    else
+      write_watch_events_dropped++;
+  }
+}
+
+/*
+ * Core0 calls this from the main loop to run the actions of any watches core1
+ * has seen fire.
+ */
+void service_write_watch_events( void )
+{
+  while( multicore_fifo_rvalid() )
+  {
+    const uint32_t event = multicore_fifo_pop_blocking();
+    const uint8_t  id    = WATCH_EVENT_ID( event );
+
+    /* It could have been removed since core1 matched it */
+    if( id >= NUM_WRITE_WATCHES || !write_watches[id].active )
+      continue;
+
+    if( write_watches[id].callback != NULL )
+    {
+      write_watches[id].callback( WATCH_EVENT_ADDR( event ), WATCH_EVENT_VALUE( event ),
+                                  write_watches[id].user_data );
+    }
+    else
+    {
+      service_watched_cmd( write_watches[id].cmd_zx_addr );
+    }
+  }
+}
+
+void init_write_watches( void )
+{
+  for( uint32_t i=0; i < NUM_WRITE_WATCHES; i++ )
+    write_watches[i].active = false;
+
+  rebuild_write_watch_pages();
+}
@@ -0,0 +1,66 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __WRITE_WATCH_H
+#define __WRITE_WATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * Write watches. Core1 checks every write it snoops against a small table of
+ * address ranges. When one matches, core0 is told and runs the watch's action,
+ * either a firmware callback or a coprocessor command structure in Z80 memory.
+ * That lets a Z80 program trigger work just by writing to a variable it was
+ * going to write to anyway.
+ */
+#define NUM_WRITE_WATCHES  8
+
+/* Value returned when a watch can't be added */
+#define WRITE_WATCH_NONE   0xFF
+
+typedef enum
+{
+  WATCH_MATCH_ANY     = 0,    // Any write into the range
+  WATCH_MATCH_VALUE   = 1,    // A write of a particular value into the range
+  WATCH_MATCH_CHANGED = 2,    // A write which changes the value in the range
+}
+WATCH_MATCH;
+
+typedef void (*WRITE_WATCH_CALLBACK)( const ZX_ADDR zx_addr, const ZX_BYTE value, void *user_data );
+
+void init_write_watches( void );
+
+uint8_t add_write_watch_callback( const ZX_ADDR start, const ZX_ADDR end,
+                                  const WATCH_MATCH match, const ZX_BYTE match_value,
+                                  WRITE_WATCH_CALLBACK callback, void *user_data );
+uint8_t add_write_watch_cmd( const ZX_ADDR start, const ZX_ADDR end,
+                             const WATCH_MATCH match, const ZX_BYTE match_value,
+                             const ZX_ADDR cmd_zx_addr );
+bool remove_write_watch( const uint8_t watch_id );
+
+/* Core1 side */
+bool is_write_watched_page( const ZX_ADDR zx_addr );
+void check_write_watches( const ZX_ADDR zx_addr, const ZX_BYTE value, const ZX_BYTE old_value );
+
+/* Core0 side */
+void service_write_watch_events( void );
+
+#endif
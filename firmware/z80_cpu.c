@@ -0,0 +1,762 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "z80_cpu.h"
+
+/*
+ * Decoded the usual way, opcode bits xxyyyzzz with y split into ppq. See
+ * "Decoding Z80 Opcodes" by Cristian Dinu, which the tables below follow.
+ */
+typedef enum
+{
+  INDEX_HL,
+  INDEX_IX,
+  INDEX_IY
+}
+INDEX_MODE;
+
+#define SZ53_MASK  (Z80_FLAG_S | Z80_FLAG_Y | Z80_FLAG_X)
+
+static inline ZX_BYTE fetch_byte( Z80_CPU *cpu )
+{
+  return cpu->read( cpu->pc++, cpu->user_data );
+}
+
+static inline ZX_WORD fetch_word( Z80_CPU *cpu )
+{
+  const ZX_BYTE lo = fetch_byte( cpu );
+  return lo | (fetch_byte( cpu ) << 8);
+}
+
+static inline ZX_WORD read_word( Z80_CPU *cpu, const ZX_ADDR zx_addr )
+{
+  return cpu->read( zx_addr, cpu->user_data ) | (cpu->read( (ZX_ADDR)(zx_addr+1), cpu->user_data ) << 8);
+}
+
+static inline void write_word( Z80_CPU *cpu, const ZX_ADDR zx_addr, const ZX_WORD value )
+{
+  cpu->write( zx_addr, value & 0xFF, cpu->user_data );
+  cpu->write( (ZX_ADDR)(zx_addr+1), value >> 8, cpu->user_data );
+}
+
+static inline void push_word( Z80_CPU *cpu, const ZX_WORD value )
+{
+  cpu->sp -= 2;
+  write_word( cpu, cpu->sp, value );
+}
+
+static inline ZX_WORD pop_word( Z80_CPU *cpu )
+{
+  const ZX_WORD value = read_word( cpu, cpu->sp );
+  cpu->sp += 2;
+  return value;
+}
+
+static inline ZX_BYTE get_a( const Z80_CPU *cpu ) { return cpu->af >> 8; }
+static inline ZX_BYTE get_f( const Z80_CPU *cpu ) { return cpu->af & 0xFF; }
+static inline void    set_a( Z80_CPU *cpu, const ZX_BYTE a ) { cpu->af = (cpu->af & 0x00FF) | (a << 8); }
+static inline void    set_f( Z80_CPU *cpu, const ZX_BYTE f ) { cpu->af = (cpu->af & 0xFF00) | f; }
+
+static inline ZX_BYTE sz53( const ZX_BYTE value )
+{
+  return (value & SZ53_MASK) | (value == 0 ? Z80_FLAG_Z : 0);
+}
+
+static inline ZX_BYTE sz53p( const ZX_BYTE value )
+{
+  return sz53( value ) | ((__builtin_parity( value ) == 0) ? Z80_FLAG_PV : 0);
+}
+
+static inline ZX_WORD *index_reg( Z80_CPU *cpu, const INDEX_MODE mode )
+{
+  if( mode == INDEX_IX ) return &cpu->ix;
+  if( mode == INDEX_IY ) return &cpu->iy;
+  return &cpu->hl;
+}
+
+/* 8 bit registers in the r[] order, B C D E H L - A. H and L become IXH/IXL etc with a prefix */
+static ZX_BYTE get_reg8( Z80_CPU *cpu, const uint32_t r, const INDEX_MODE mode )
+{
+  switch( r )
+  {
+    case 0: return cpu->bc >> 8;
+    case 1: return cpu->bc & 0xFF;
+    case 2: return cpu->de >> 8;
+    case 3: return cpu->de & 0xFF;
+    case 4: return *index_reg( cpu, mode ) >> 8;
+    case 5: return *index_reg( cpu, mode ) & 0xFF;
+    default: return get_a( cpu );
+  }
+}
+
+static void set_reg8( Z80_CPU *cpu, const uint32_t r, const INDEX_MODE mode, const ZX_BYTE value )
+{
+  ZX_WORD *reg;
+
+  switch( r )
+  {
+    case 0: cpu->bc = (cpu->bc & 0x00FF) | (value << 8); return;
+    case 1: cpu->bc = (cpu->bc & 0xFF00) | value;        return;
+    case 2: cpu->de = (cpu->de & 0x00FF) | (value << 8); return;
+    case 3: cpu->de = (cpu->de & 0xFF00) | value;        return;
+    case 4: reg = index_reg( cpu, mode ); *reg = (*reg & 0x00FF) | (value << 8); return;
+    case 5: reg = index_reg( cpu, mode ); *reg = (*reg & 0xFF00) | value;        return;
+    default: set_a( cpu, value ); return;
+  }
+}
+
+/* rp[] is BC DE HL SP, rp2[] has AF instead of SP */
+static ZX_WORD *reg16( Z80_CPU *cpu, const uint32_t p, const INDEX_MODE mode, const bool af )
+{
+  switch( p )
+  {
+    case 0: return &cpu->bc;
+    case 1: return &cpu->de;
+    case 2: return index_reg( cpu, mode );
+    default: return af ? &cpu->af : &cpu->sp;
+  }
+}
+
+static bool condition( const Z80_CPU *cpu, const uint32_t cc )
+{
+  const ZX_BYTE f = get_f( cpu );
+
+  switch( cc )
+  {
+    case 0: return !(f & Z80_FLAG_Z);
+    case 1: return   f & Z80_FLAG_Z;
+    case 2: return !(f & Z80_FLAG_C);
+    case 3: return   f & Z80_FLAG_C;
+    case 4: return !(f & Z80_FLAG_PV);
+    case 5: return   f & Z80_FLAG_PV;
+    case 6: return !(f & Z80_FLAG_S);
+    default: return  f & Z80_FLAG_S;
+  }
+}
+
+/* alu[] is ADD ADC SUB SBC AND XOR OR CP */
+static void alu8( Z80_CPU *cpu, const uint32_t op, const ZX_BYTE value )
+{
+  const ZX_BYTE a     = get_a( cpu );
+  const uint32_t carry = get_f( cpu ) & Z80_FLAG_C;
+  uint32_t result;
+
+  switch( op )
+  {
+    case 0:
+    case 1:
+      result = a + value + ((op == 1) ? carry : 0);
+      set_a( cpu, result );
+      set_f( cpu, sz53( result & 0xFF ) |
+                  ((a ^ value ^ result) & Z80_FLAG_H) |
+                  ((((a ^ result) & (value ^ result)) & 0x80) ? Z80_FLAG_PV : 0) |
+                  ((result & 0x100) ? Z80_FLAG_C : 0) );
+      return;
+
+    case 2:
+    case 3:
+    case 7:
+      result = a - value - ((op == 3) ? carry : 0);
+      set_f( cpu, ((op == 7) ? ((value & (Z80_FLAG_Y | Z80_FLAG_X)) | (result & Z80_FLAG_S) | (((result & 0xFF) == 0) ? Z80_FLAG_Z : 0))
+                             : sz53( result & 0xFF )) |
+                  Z80_FLAG_N |
+                  ((a ^ value ^ result) & Z80_FLAG_H) |
+                  ((((a ^ value) & (a ^ result)) & 0x80) ? Z80_FLAG_PV : 0) |
+                  ((result & 0x100) ? Z80_FLAG_C : 0) );
+      if( op != 7 )
+        set_a( cpu, result );
+      return;
+
+    case 4:
+      result = a & value;
+      set_a( cpu, result );
+      set_f( cpu, sz53p( result ) | Z80_FLAG_H );
+      return;
+
+    case 5:
+      result = a ^ value;
+      set_a( cpu, result );
+      set_f( cpu, sz53p( result ) );
+      return;
+
+    default:
+      result = a | value;
+      set_a( cpu, result );
+      set_f( cpu, sz53p( result ) );
+      return;
+  }
+}
+
+static ZX_BYTE inc8( Z80_CPU *cpu, const ZX_BYTE value )
+{
+  const ZX_BYTE result = value + 1;
+
+  set_f( cpu, (get_f( cpu ) & Z80_FLAG_C) | sz53( result ) |
+              (((value & 0x0F) == 0x0F) ? Z80_FLAG_H : 0) |
+              ((value == 0x7F) ? Z80_FLAG_PV : 0) );
+  return result;
+}
+
+static ZX_BYTE dec8( Z80_CPU *cpu, const ZX_BYTE value )
+{
+  const ZX_BYTE result = value - 1;
+
+  set_f( cpu, (get_f( cpu ) & Z80_FLAG_C) | Z80_FLAG_N | sz53( result ) |
+              (((value & 0x0F) == 0x00) ? Z80_FLAG_H : 0) |
+              ((value == 0x80) ? Z80_FLAG_PV : 0) );
+  return result;
+}
+
+/* rot[] is RLC RRC RL RR SLA SRA SLL SRL, flags as the CB prefixed versions set them */
+static ZX_BYTE rot8( Z80_CPU *cpu, const uint32_t op, const ZX_BYTE value )
+{
+  const uint32_t carry_in = get_f( cpu ) & Z80_FLAG_C;
+  uint32_t carry;
+  ZX_BYTE  result;
+
+  switch( op )
+  {
+    case 0:  carry = value >> 7;  result = (value << 1) | carry;          break;
+    case 1:  carry = value & 1;   result = (value >> 1) | (carry << 7);   break;
+    case 2:  carry = value >> 7;  result = (value << 1) | carry_in;       break;
+    case 3:  carry = value & 1;   result = (value >> 1) | (carry_in << 7); break;
+    case 4:  carry = value >> 7;  result = value << 1;                     break;
+    case 5:  carry = value & 1;   result = (value >> 1) | (value & 0x80);  break;
+    case 6:  carry = value >> 7;  result = (value << 1) | 1;               break;
+    default: carry = value & 1;   result = value >> 1;                     break;
+  }
+
+  set_f( cpu, sz53p( result ) | (carry ? Z80_FLAG_C : 0) );
+  return result;
+}
+
+static ZX_WORD add16( Z80_CPU *cpu, const ZX_WORD a, const ZX_WORD b )
+{
+  const uint32_t result = a + b;
+
+  set_f( cpu, (get_f( cpu ) & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV)) |
+              ((result >> 8) & (Z80_FLAG_Y | Z80_FLAG_X)) |
+              (((a ^ b ^ result) >> 8) & Z80_FLAG_H) |
+              ((result & 0x10000) ? Z80_FLAG_C : 0) );
+  return result;
+}
+
+static ZX_WORD adc_sbc16( Z80_CPU *cpu, const ZX_WORD a, const ZX_WORD b, const bool subtract )
+{
+  const uint32_t carry  = get_f( cpu ) & Z80_FLAG_C;
+  const uint32_t result = subtract ? (uint32_t)(a - b - carry) : (uint32_t)(a + b + carry);
+  const uint32_t overflow = subtract ? ((a ^ b) & (a ^ result)) : ((a ^ result) & (b ^ result));
+
+  set_f( cpu, ((result >> 8) & SZ53_MASK) |
+              (((result & 0xFFFF) == 0) ? Z80_FLAG_Z : 0) |
+              (((a ^ b ^ result) >> 8) & Z80_FLAG_H) |
+              ((overflow & 0x8000) ? Z80_FLAG_PV : 0) |
+              (subtract ? Z80_FLAG_N : 0) |
+              ((result & 0x10000) ? Z80_FLAG_C : 0) );
+  return result;
+}
+
+static void daa( Z80_CPU *cpu )
+{
+  const ZX_BYTE a = get_a( cpu );
+  const ZX_BYTE f = get_f( cpu );
+  ZX_BYTE correction = 0;
+  ZX_BYTE carry      = f & Z80_FLAG_C;
+
+  if( (f & Z80_FLAG_H) || ((a & 0x0F) > 9) )
+    correction |= 0x06;
+
+  if( carry || (a > 0x99) )
+  {
+    correction |= 0x60;
+    carry = Z80_FLAG_C;
+  }
+
+  const ZX_BYTE result = (f & Z80_FLAG_N) ? a - correction : a + correction;
+
+  set_a( cpu, result );
+  set_f( cpu, sz53p( result ) | carry | (f & Z80_FLAG_N) | ((a ^ result) & Z80_FLAG_H) );
+}
+
+/*
+ * The CB prefixed instructions. With an index prefix the displacement comes
+ * before the opcode and the operand is always (IX+d); the undocumented forms
+ * which also copy the result into a register do that too.
+ */
+static bool step_cb( Z80_CPU *cpu, const INDEX_MODE mode )
+{
+  ZX_ADDR zx_addr = cpu->hl;
+
+  if( mode != INDEX_HL )
+    zx_addr = *index_reg( cpu, mode ) + (int8_t)fetch_byte( cpu );
+
+  const ZX_BYTE  op = fetch_byte( cpu );
+  const uint32_t x  = op >> 6;
+  const uint32_t y  = (op >> 3) & 7;
+  const uint32_t z  = op & 7;
+
+  const bool memory = (z == 6) || (mode != INDEX_HL);
+  const ZX_BYTE value = memory ? cpu->read( zx_addr, cpu->user_data ) : get_reg8( cpu, z, INDEX_HL );
+  ZX_BYTE result;
+
+  switch( x )
+  {
+    case 0:
+      result = rot8( cpu, y, value );
+      break;
+
+    case 1:
+    {
+      const bool bit_set = value & (1 << y);
+      set_f( cpu, (get_f( cpu ) & Z80_FLAG_C) | Z80_FLAG_H |
+                  ((memory ? (zx_addr >> 8) : value) & (Z80_FLAG_Y | Z80_FLAG_X)) |
+                  (bit_set ? 0 : (Z80_FLAG_Z | Z80_FLAG_PV)) |
+                  ((bit_set && y == 7) ? Z80_FLAG_S : 0) );
+      return true;
+    }
+
+    case 2:
+      result = value & ~(1 << y);
+      break;
+
+    default:
+      result = value | (1 << y);
+      break;
+  }
+
+  if( memory )
+    cpu->write( zx_addr, result, cpu->user_data );
+
+  if( z != 6 )
+    set_reg8( cpu, z, INDEX_HL, result );
+
+  return true;
+}
+
+/* Block transfers and compares, one step of them. The repeating ones go back over themselves */
+static void block_ld( Z80_CPU *cpu, const int32_t direction, const bool repeat )
+{
+  const ZX_BYTE value = cpu->read( cpu->hl, cpu->user_data );
+  cpu->write( cpu->de, value, cpu->user_data );
+
+  cpu->hl += direction;
+  cpu->de += direction;
+  cpu->bc--;
+
+  const ZX_BYTE n = value + get_a( cpu );
+  set_f( cpu, (get_f( cpu ) & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_C)) |
+              ((n & 0x02) ? Z80_FLAG_Y : 0) | (n & Z80_FLAG_X) |
+              ((cpu->bc != 0) ? Z80_FLAG_PV : 0) );
+
+  if( repeat && cpu->bc != 0 )
+    cpu->pc -= 2;
+}
+
+static void block_cp( Z80_CPU *cpu, const int32_t direction, const bool repeat )
+{
+  const ZX_BYTE value  = cpu->read( cpu->hl, cpu->user_data );
+  const ZX_BYTE a      = get_a( cpu );
+  const ZX_BYTE result = a - value;
+  const ZX_BYTE half   = (a ^ value ^ result) & Z80_FLAG_H;
+
+  cpu->hl += direction;
+  cpu->bc--;
+
+  const ZX_BYTE n = result - (half ? 1 : 0);
+  set_f( cpu, (get_f( cpu ) & Z80_FLAG_C) | Z80_FLAG_N | half |
+              (result & Z80_FLAG_S) | ((result == 0) ? Z80_FLAG_Z : 0) |
+              ((n & 0x02) ? Z80_FLAG_Y : 0) | (n & Z80_FLAG_X) |
+              ((cpu->bc != 0) ? Z80_FLAG_PV : 0) );
+
+  if( repeat && cpu->bc != 0 && result != 0 )
+    cpu->pc -= 2;
+}
+
+/*
+ * The ED prefixed instructions. I/O, the interrupt mode and return
+ * instructions, and I and R stop the sandbox.
+ */
+static bool step_ed( Z80_CPU *cpu )
+{
+  const ZX_BYTE  op = fetch_byte( cpu );
+  const uint32_t x  = op >> 6;
+  const uint32_t y  = (op >> 3) & 7;
+  const uint32_t z  = op & 7;
+  const uint32_t p  = y >> 1;
+  const uint32_t q  = y & 1;
+
+  if( x == 1 )
+  {
+    switch( z )
+    {
+      case 0:
+      case 1:
+        return false;
+
+      case 2:
+        cpu->hl = adc_sbc16( cpu, cpu->hl, *reg16( cpu, p, INDEX_HL, false ), q == 0 );
+        return true;
+
+      case 3:
+      {
+        const ZX_ADDR zx_addr = fetch_word( cpu );
+        if( q == 0 )
+          write_word( cpu, zx_addr, *reg16( cpu, p, INDEX_HL, false ) );
+        else
+          *reg16( cpu, p, INDEX_HL, false ) = read_word( cpu, zx_addr );
+        return true;
+      }
+
+      case 4:
+      {
+        const ZX_BYTE a = get_a( cpu );
+        set_a( cpu, 0 );
+        alu8( cpu, 2, a );
+        return true;
+      }
+
+      case 5:
+      case 6:
+        return false;
+
+      default:
+        if( y == 4 || y == 5 )
+        {
+          /* RRD and RLD */
+          const ZX_BYTE a     = get_a( cpu );
+          const ZX_BYTE value = cpu->read( cpu->hl, cpu->user_data );
+          ZX_BYTE result_a, result_mem;
+
+          if( y == 4 )
+          {
+            result_a   = (a & 0xF0) | (value & 0x0F);
+            result_mem = (value >> 4) | (a << 4);
+          }
+          else
+          {
+            result_a   = (a & 0xF0) | (value >> 4);
+            result_mem = (value << 4) | (a & 0x0F);
+          }
+
+          cpu->write( cpu->hl, result_mem, cpu->user_data );
+          set_a( cpu, result_a );
+          set_f( cpu, (get_f( cpu ) & Z80_FLAG_C) | sz53p( result_a ) );
+          return true;
+        }
+
+        /* LD I,A / LD R,A / LD A,I / LD A,R, and the two which do nothing */
+        return y >= 6;
+    }
+  }
+
+  if( x == 2 && y >= 4 && z <= 1 )
+  {
+    const int32_t direction = (y & 1) ? -1 : 1;
+    const bool    repeat    = y >= 6;
+
+    if( z == 0 )
+      block_ld( cpu, direction, repeat );
+    else
+      block_cp( cpu, direction, repeat );
+
+    return true;
+  }
+
+  if( x == 2 && y >= 4 )
+    return false;
+
+  /* Everything else is a NOP */
+  return true;
+}
+
+bool z80_cpu_step( Z80_CPU *cpu )
+{
+  INDEX_MODE mode = INDEX_HL;
+  ZX_BYTE    op   = fetch_byte( cpu );
+
+  while( op == 0xDD || op == 0xFD )
+  {
+    mode = (op == 0xDD) ? INDEX_IX : INDEX_IY;
+    op   = fetch_byte( cpu );
+  }
+
+  if( op == 0xCB )
+    return step_cb( cpu, mode );
+
+  if( op == 0xED )
+    return step_ed( cpu );
+
+  const uint32_t x = op >> 6;
+  const uint32_t y = (op >> 3) & 7;
+  const uint32_t z = op & 7;
+  const uint32_t p = y >> 1;
+  const uint32_t q = y & 1;
+
+  ZX_WORD *hl_reg = index_reg( cpu, mode );
+
+  /* The address of (HL), or (IX+d) with the displacement fetched, for the instructions which use it */
+#define OPERAND_ADDR() ((mode == INDEX_HL) ? cpu->hl : (ZX_ADDR)(*hl_reg + (int8_t)fetch_byte( cpu )))
+
+  switch( x )
+  {
+    case 0:
+      switch( z )
+      {
+        case 0:
+          if( y == 0 )
+          {
+            /* NOP */
+          }
+          else if( y == 1 )
+          {
+            const ZX_WORD af = cpu->af;
+            cpu->af = cpu->af_alt;  cpu->af_alt = af;
+          }
+          else
+          {
+            const int8_t displacement = (int8_t)fetch_byte( cpu );
+            bool jump;
+
+            if( y == 2 )
+            {
+              cpu->bc -= 0x0100;
+              jump = (cpu->bc >> 8) != 0;
+            }
+            else
+            {
+              jump = (y == 3) || condition( cpu, y - 4 );
+            }
+
+            if( jump )
+              cpu->pc += displacement;
+          }
+          return true;
+
+        case 1:
+          if( q == 0 )
+            *reg16( cpu, p, mode, false ) = fetch_word( cpu );
+          else
+            *hl_reg = add16( cpu, *hl_reg, *reg16( cpu, p, mode, false ) );
+          return true;
+
+        case 2:
+        {
+          ZX_ADDR zx_addr;
+
+          switch( p )
+          {
+            case 0:  zx_addr = cpu->bc; break;
+            case 1:  zx_addr = cpu->de; break;
+            default: zx_addr = fetch_word( cpu ); break;
+          }
+
+          if( p == 2 )
+          {
+            if( q == 0 ) write_word( cpu, zx_addr, *hl_reg );
+            else         *hl_reg = read_word( cpu, zx_addr );
+          }
+          else
+          {
+            if( q == 0 ) cpu->write( zx_addr, get_a( cpu ), cpu->user_data );
+            else         set_a( cpu, cpu->read( zx_addr, cpu->user_data ) );
+          }
+          return true;
+        }
+
+        case 3:
+          if( q == 0 ) (*reg16( cpu, p, mode, false ))++;
+          else         (*reg16( cpu, p, mode, false ))--;
+          return true;
+
+        case 4:
+        case 5:
+        case 6:
+          if( y == 6 )
+          {
+            const ZX_ADDR zx_addr = OPERAND_ADDR();
+            const ZX_BYTE value   = cpu->read( zx_addr, cpu->user_data );
+
+            if( z == 4 )      cpu->write( zx_addr, inc8( cpu, value ), cpu->user_data );
+            else if( z == 5 ) cpu->write( zx_addr, dec8( cpu, value ), cpu->user_data );
+            else              cpu->write( zx_addr, fetch_byte( cpu ), cpu->user_data );
+          }
+          else
+          {
+            const ZX_BYTE value = get_reg8( cpu, y, mode );
+
+            if( z == 4 )      set_reg8( cpu, y, mode, inc8( cpu, value ) );
+            else if( z == 5 ) set_reg8( cpu, y, mode, dec8( cpu, value ) );
+            else              set_reg8( cpu, y, mode, fetch_byte( cpu ) );
+          }
+          return true;
+
+        default:
+        {
+          const ZX_BYTE a = get_a( cpu );
+          const ZX_BYTE f = get_f( cpu );
+          const ZX_BYTE keep = f & (Z80_FLAG_S | Z80_FLAG_Z | Z80_FLAG_PV);
+          ZX_BYTE result;
+
+          switch( y )
+          {
+            case 0: result = (a << 1) | (a >> 7);               set_f( cpu, keep | (a >> 7) );                break;
+            case 1: result = (a >> 1) | (a << 7);               set_f( cpu, keep | (a & 1) );                 break;
+            case 2: result = (a << 1) | (f & Z80_FLAG_C);       set_f( cpu, keep | (a >> 7) );                break;
+            case 3: result = (a >> 1) | ((f & Z80_FLAG_C) << 7); set_f( cpu, keep | (a & 1) );                break;
+            case 4: daa( cpu ); return true;
+            case 5: result = ~a; set_f( cpu, (f & (keep | Z80_FLAG_C)) | Z80_FLAG_H | Z80_FLAG_N );        break;
+            case 6: result = a;  set_f( cpu, keep | Z80_FLAG_C );                                           break;
+            default:
+              result = a;
+              set_f( cpu, keep | ((f & Z80_FLAG_C) ? Z80_FLAG_H : Z80_FLAG_C) );
+              break;
+          }
+
+          set_a( cpu, result );
+          set_f( cpu, (get_f( cpu ) & ~(Z80_FLAG_Y | Z80_FLAG_X)) | (result & (Z80_FLAG_Y | Z80_FLAG_X)) );
+          return true;
+        }
+      }
+
+    case 1:
+      if( z == 6 && y == 6 )
+      {
+        /* HALT */
+        return false;
+      }
+
+      if( z == 6 )
+        set_reg8( cpu, y, INDEX_HL, cpu->read( OPERAND_ADDR(), cpu->user_data ) );
+      else if( y == 6 )
+        cpu->write( OPERAND_ADDR(), get_reg8( cpu, z, INDEX_HL ), cpu->user_data );
+      else
+        set_reg8( cpu, y, mode, get_reg8( cpu, z, mode ) );
+      return true;
+
+    case 2:
+      alu8( cpu, y, (z == 6) ? cpu->read( OPERAND_ADDR(), cpu->user_data ) : get_reg8( cpu, z, mode ) );
+      return true;
+
+    default:
+      switch( z )
+      {
+        case 0:
+          if( condition( cpu, y ) )
+            cpu->pc = pop_word( cpu );
+          return true;
+
+        case 1:
+          if( q == 0 )
+          {
+            *reg16( cpu, p, mode, true ) = pop_word( cpu );
+          }
+          else if( p == 0 )
+          {
+            cpu->pc = pop_word( cpu );
+          }
+          else if( p == 1 )
+          {
+            ZX_WORD swap;
+            swap = cpu->bc; cpu->bc = cpu->bc_alt; cpu->bc_alt = swap;
+            swap = cpu->de; cpu->de = cpu->de_alt; cpu->de_alt = swap;
+            swap = cpu->hl; cpu->hl = cpu->hl_alt; cpu->hl_alt = swap;
+          }
+          else if( p == 2 )
+          {
+            cpu->pc = *hl_reg;
+          }
+          else
+          {
+            cpu->sp = *hl_reg;
+          }
+          return true;
+
+        case 2:
+        {
+          const ZX_ADDR zx_addr = fetch_word( cpu );
+          if( condition( cpu, y ) )
+            cpu->pc = zx_addr;
+          return true;
+        }
+
+        case 3:
+          switch( y )
+          {
+            case 0:
+              cpu->pc = fetch_word( cpu );
+              return true;
+
+            case 4:
+            {
+              const ZX_WORD value = read_word( cpu, cpu->sp );
+              write_word( cpu, cpu->sp, *hl_reg );
+              *hl_reg = value;
+              return true;
+            }
+
+            case 5:
+            {
+              const ZX_WORD de = cpu->de;
+              cpu->de = cpu->hl;  cpu->hl = de;
+              return true;
+            }
+
+            default:
+              /* OUT, IN, DI and EI */
+              return false;
+          }
+
+        case 4:
+        {
+          const ZX_ADDR zx_addr = fetch_word( cpu );
+          if( condition( cpu, y ) )
+          {
+            push_word( cpu, cpu->pc );
+            cpu->pc = zx_addr;
+          }
+          return true;
+        }
+
+        case 5:
+          if( q == 0 )
+          {
+            push_word( cpu, *reg16( cpu, p, mode, true ) );
+          }
+          else
+          {
+            /* Only CALL gets here, the prefixes were dealt with above */
+            const ZX_ADDR zx_addr = fetch_word( cpu );
+            push_word( cpu, cpu->pc );
+            cpu->pc = zx_addr;
+          }
+          return true;
+
+        case 6:
+          alu8( cpu, y, fetch_byte( cpu ) );
+          return true;
+
+        default:
+          push_word( cpu, cpu->pc );
+          cpu->pc = y * 8;
+          return true;
+      }
+  }
+
+#undef OPERAND_ADDR
+}
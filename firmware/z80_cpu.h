@@ -0,0 +1,64 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __Z80_CPU_H
+#define __Z80_CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * A Z80 interpreter, for running pieces of the Spectrum's ROM on the RP2350
+ * instead of on the Z80 (see calc_offload.c). It's a sandbox rather than an
+ * emulator: memory goes through the caller's functions, and anything with an
+ * effect outside the memory (I/O, HALT, the interrupt instructions, reading R)
+ * stops it rather than being run. There's no timing.
+ *
+ * Flags are exact for the documented bits. Bits 3 and 5 follow the usual
+ * rules for the common instructions but nothing should be relying on them.
+ */
+typedef ZX_BYTE (*Z80_READ_FN)( const ZX_ADDR zx_addr, void *user_data );
+typedef void    (*Z80_WRITE_FN)( const ZX_ADDR zx_addr, const ZX_BYTE value, void *user_data );
+
+typedef struct _Z80_CPU
+{
+  ZX_WORD af, bc, de, hl;
+  ZX_WORD af_alt, bc_alt, de_alt, hl_alt;
+  ZX_WORD ix, iy, sp, pc;
+
+  Z80_READ_FN   read;
+  Z80_WRITE_FN  write;
+  void         *user_data;
+}
+Z80_CPU;
+
+/* Flag bits */
+#define Z80_FLAG_C   0x01
+#define Z80_FLAG_N   0x02
+#define Z80_FLAG_PV  0x04
+#define Z80_FLAG_X   0x08
+#define Z80_FLAG_H   0x10
+#define Z80_FLAG_Y   0x20
+#define Z80_FLAG_Z   0x40
+#define Z80_FLAG_S   0x80
+
+bool z80_cpu_step( Z80_CPU *cpu );
+
+#endif
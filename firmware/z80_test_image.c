@@ -23,6 +23,7 @@
 #include "pico/stdlib.h"
 
 #include "dma_engine.h"
+#include "fast_boot.h"
 
 /*
  * A test program, z80 machine code, expected to be ORGed at 0x8000.
@@ -76,6 +77,11 @@ void z80_test_image_set_pending( void )
   z80_test.load_to_z80_pending = true;
 }
 
+bool z80_test_image_set_fast_boot( void )
+{
+  return set_fast_boot_image( z80_test.z80_code, z80_test.dest, z80_test.length, z80_test.dest );
+}
+
 uint32_t is_z80_test_ready( void )
 {
   return (z80_test.prepared && z80_test.load_to_z80_pending);
@@ -21,6 +21,7 @@
 #define __Z80_TEST_IMAGE_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 uint32_t  using_z80_test_image( void );
 
@@ -32,5 +33,8 @@ void z80_test_image_set_pending( void );
 
 uint32_t is_z80_test_ready( void );
 
+/* This hands the test image to the fast boot, to be run as soon as the ROM has started */
+bool z80_test_image_set_fast_boot( void );
+
 
 #endif
\ No newline at end of file
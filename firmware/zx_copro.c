@@ -44,6 +44,19 @@
 #include "zx_mirror.h"
 #include "z80_test_image.h"
 #include "cmd_immediate.h"
+#include "machine_profile.h"
+#include "int_monitor.h"
+#include "write_watch.h"
+#include "write_log.h"
+#include "exec_profile.h"
+#include "zx_mirror_sync.h"
+#include "rom_trap.h"
+#include "tape_trap.h"
+#include "calc_offload.h"
+#include "screen_offload.h"
+#include "fast_boot.h"
+#include "boot_ready.h"
+#include "io_register.h"
 
 #include "gpios.h"
 
@@ -58,18 +71,16 @@ static void test_blipper( void )
 }
 
 
+#define OVERCLOCK 200000
+
 /*
- * Test routine, called on alarm a few secs after the zx has booted up.
- * This isn't called if we're not using the test program
+ * The main loop looks at the trigger pins every pass, and at everything else
+ * (the DMA queue included) every MAIN_LOOP_HOUSEKEEPING_PASSES passes, which
+ * is every couple of microseconds. The /INT monitor's FIFO only needs draining
+ * now and again. Both are powers of 2.
  */
-static int64_t load_test_program( alarm_id_t id, void *user_data )
-{
-  z80_test_image_set_pending();
-
-  return 0;
-}
-
-#define OVERCLOCK 200000
+#define MAIN_LOOP_HOUSEKEEPING_PASSES  16
+#define MAIN_LOOP_INT_MONITOR_PASSES   1024
 
 void main( void )
 {
@@ -126,7 +137,35 @@ void main( void )
 
   /* Zero mirror memory */
   initialise_zx_mirror();
+
+  /*
+   * Work out which Spectrum this is, the interrupt protection needs its frame period.
+   * The ULA runs its /INTs while the Z80 is held in reset, so this can be done now.
+   */
+  select_machine_profile( using_rom_emulation() ? query_emulated_rom_checksum() : 0 );
+
+  /* Only a 128K has the paging latch for the mirror to follow */
+  enable_zx_mirror_paging( query_machine_profile()->num_ram_banks == ZX_NUM_RAM_BANKS );
   init_interrupt_protection();
+  init_int_monitor();
+
+  /* No write watches until something asks for them, this needs doing before core1 starts */
+  init_write_watches();
+
+  /* Same for the ROM traps */
+  init_rom_traps();
+
+  /* And the I/O registers, core1 answers INs from them once their port's registered */
+  if( using_io_registers() )
+    init_io_registers();
+
+  /* The write log takes its frame timings from the machine profile */
+  if( using_write_log() )
+    init_write_log();
+
+  /* Same for the execution profile, which starts counting straight away */
+  if( using_exec_profile() )
+    init_exec_profile();
 
   /* Take over the ZX ROM */
   if( using_rom_emulation() )
@@ -134,6 +173,22 @@ void main( void )
     /* We're emulating ROM, hold ROMCS permanently high and start the emulation running */
     gpio_init( GPIO_ROMCS ); gpio_set_dir( GPIO_ROMCS, GPIO_OUT ); gpio_put( GPIO_ROMCS, 1 );
     start_rom_emulation( FULL_ROM_EMULATION );
+
+    /* Instant tape loading swaps in a patched copy of the ROM, so it only works if the ROM is emulated */
+    if( using_tape_traps() )
+      init_tape_traps();
+
+    /* Same for running the ROM's calculator on the RP2350 */
+    if( using_calc_offload() )
+      init_calc_offload();
+
+    /* And the ROM's screen routines */
+    if( using_screen_offload() )
+      init_screen_offload();
+
+    /* And skipping the RAM test at start up, this has to be in place before the Z80 comes out of reset */
+    if( using_fast_boot() )
+      init_fast_boot();
   }
   else
   {
@@ -145,23 +200,43 @@ void main( void )
   /* Give the other core a moment to initialise */
   sleep_ms( 100 );
 
+  /* Core1's answering I/O cycles now, it can take the I/O registers' port */
+  if( using_io_registers() )
+    register_io_register_port( ZXCOPRO_IO_PORT );
+
   if( using_z80_test_image() )
   {
     init_z80_test_image();
 
-    /* The DMA stuff starts in a few seconds */
-    add_alarm_in_ms( 3000, load_test_program, NULL, 0 );
+    /*
+     * With fast boot the image is loaded and run as soon as the ROM has started,
+     * otherwise it's queued and the DMA starts once the ROM is ready
+     */
+    if( !(using_fast_boot() && z80_test_image_set_fast_boot()) )
+      z80_test_image_set_pending();
   }
 
+  /* Start watching for the ROM getting to the editor, nothing's DMAed until it has */
+  init_boot_ready();
 
   /* Let the Spectrum run */
   gpio_put( GPIO_RESET_Z80, 0 );
 
+  /*
+   * The mirror started off as zeroes, fill it in from the real RAM. The Z80
+   * has to be running to hand over its bus, which is why it's done now.
+   */
+  bootstrap_zx_mirror();
+
   const uint64_t immediate_cmd_trigger_mask       = IMMEDIATE_CMD_TRIGGER_MASK;
   const uint64_t immediate_cmd_trigger_pattern_hi = IMMEDIATE_CMD_TRIGGER_PATTERN_HI;
   const uint64_t immediate_cmd_trigger_pattern_lo = IMMEDIATE_CMD_TRIGGER_PATTERN_LO;
 
-  uint8_t cmd_address_lo;
+  uint8_t  cmd_address_lo;
+  uint32_t cmd_trigger_seq = 0;
+
+  /* Counts passes round the loop, for the housekeeping cadence */
+  uint32_t loop_pass_counter = 0;
 
   /*
    * The IRQ handler stuff is nowhere near fast enough to handle this. The Z80's
@@ -178,6 +253,9 @@ void main( void )
     {
       /* Z80 is writing to the immediate command register low byte, stash value */
       cmd_address_lo = (gpios>>GPIO_DBUS_D0) & GPIO_DBUS_BITMASK;
+
+      /* Note how far core1 has got, so the command can wait for it to mirror the high byte */
+      cmd_trigger_seq = query_zx_mirror_snoop_seq();
     }
     else if( (gpios & immediate_cmd_trigger_mask) == immediate_cmd_trigger_pattern_hi )
     {
@@ -189,15 +267,79 @@ void main( void )
        * value is now available. The rule is that the low byte has to be
        * written first.
        */
-      service_immediate_cmd( (ZX_ADDR)(cmd_address_hi << 8) + cmd_address_lo );
+      service_immediate_cmd( (ZX_ADDR)(cmd_address_hi << 8) + cmd_address_lo, cmd_trigger_seq );
     }
 
     /*
-     * If there's something in the DMA queue, activate it.
+     * Everything else is housekeeping. A pass spent on it is a pass the trigger
+     * write isn't being looked for, and the Z80 only has /WR low for about a
+     * T-state, under 300ns. So it only gets a look in every
+     * MAIN_LOOP_HOUSEKEEPING_PASSES passes, and then each item is a flag test
+     * unless there's work to do.
+     */
+    if( (++loop_pass_counter & (MAIN_LOOP_HOUSEKEEPING_PASSES-1)) != 0 )
+      continue;
+
+    /*
+     * If there's something in the DMA queue, activate it. Not until the ROM
+     * has started, and preferably while the Z80 is halted, see
+     * is_dma_queue_entry_due(). An entry can wait tens of milliseconds for a
+     * HALT, so the queue flag is tested first and the rest only while it's set.
      */
     if( is_dma_queue_full() )
     {
-      activate_dma_queue_entry();
+      if( is_boot_ready() && is_dma_queue_entry_due() )
+        activate_dma_queue_entry();
+    }
+
+    /*
+     * Run the actions for any write watches core1 has seen fire. Core1 posts
+     * them through the inter-core FIFO, which is quick to check from here.
+     */
+    if( multicore_fifo_rvalid() )
+    {
+      service_write_watch_events();
+    }
+
+    /*
+     * Start the write log once the ROM has finished booting. Its RAM test writes
+     * every byte, which is nothing to do with whatever's run afterwards.
+     */
+    if( using_write_log() && !is_write_log_armed() )
+    {
+      if( is_boot_ready() )
+        arm_write_log();
+    }
+
+    /* Run the handlers for any ROM traps core1 has seen the Z80 fetch from */
+    if( using_rom_traps() && is_rom_trap_pending() )
+    {
+      service_rom_traps();
+    }
+
+    /*
+     * Check a bit more of the mirror against the real RAM, only while the Z80
+     * is halted. Waiting for the int_unsafe window to pass can let the /INT
+     * wake it, and it might write the trigger while this isn't looking. Core1
+     * will have mirrored that write, so it's looked for there afterwards.
+     */
+    if( using_mirror_scrubber() && !is_dma_queue_full() && is_z80_halted() )
+    {
+      const uint32_t scrub_seq = query_zx_mirror_snoop_seq();
+
+      scrub_zx_mirror_step();
+
+      if( has_zx_mirror_snooped_trigger( scrub_seq ) )
+      {
+        const ZX_ADDR cmd_zx_addr = get_zx_mirror_byte( IMMEDIATE_CMD_TRIGGER_REG ) |
+                                    (get_zx_mirror_byte( IMMEDIATE_CMD_TRIGGER_REG+1 ) << 8);
+        service_immediate_cmd( cmd_zx_addr, scrub_seq );
+      }
+    }
+
+    if( (loop_pass_counter & (MAIN_LOOP_INT_MONITOR_PASSES-1)) == 0 )
+    {
+      poll_int_monitor();
     }
   }
 
@@ -22,11 +22,18 @@
 #include "hardware/gpio.h"
 #include "pico/multicore.h"
 #include "hardware/clocks.h"
+#include "hardware/structs/m33.h"
 
 #include "zx_memory_management.h"
-#include "rom.h"
+#include "rom_bank.h"
 #include "zx_mirror.h"
-#include "z80_test_image.h"
+#include "write_watch.h"
+#include "write_log.h"
+#include "pio_rom_server.h"
+#include "rom_trap.h"
+#include "io_register.h"
+#include "exec_profile.h"
+#include "machine_profile.h"
 
 #include "gpios.h"
 
@@ -44,24 +51,215 @@
  * are based on a 200MHz overclock.
  */
 
-static uint16_t initial_jp_destination = 0;
+/*
+ * Memory placement. Both cores run out of SRAM (this is a copy-to-RAM build)
+ * and the main 512K of SRAM is two blocks of 4 banks, word striped. Core0's
+ * code, stack and data are spread across all of one block at least, so if
+ * core1 was fetching its instructions from there too the two would keep
+ * bumping into each other on the same bank. Each collision costs core1 a
+ * cycle at just the wrong moment.
+ *
+ * So core1's loop, and everything it calls from the loop (the mirror and
+ * port snoops, the ROM trap and write watch checks, the write log and the
+ * execution profile), live in scratch X (SRAM8), which nothing else uses
+ * apart from core1's stack. So do the little tables core1 looks at on every
+ * cycle, including its own copy of the mirror's segment table. Core0 has
+ * scratch Y for its stack, and only goes into scratch X on rare paths. The
+ * ROM image and the mirror are still in main SRAM, but core1 only touches
+ * those once per bus cycle rather than on every instruction. If scratch X
+ * overflows the link fails, it's 4K with core1's 2K stack at the top.
+ *
+ * MEASURE_ROM_LATENCY times every ROM byte served, from /MREQ going low to
+ * the byte being driven onto the data bus, in RP2350 cycles. It's on all the
+ * time, so the headroom is there to look at whatever the clock or firmware
+ * change. It costs core1 a read of its DWT cycle counter on each pass round
+ * the spin loop, and a few cycles after each byte is on the bus.
+ *
+ * The edge is timestamped from the spin loop. Each pass notes the cycle count
+ * before it samples the GPIOs, so the edge came after the pass before the one
+ * which saw /MREQ low, less the GPIO input synchronisers' 2 cycles. That's
+ * the start of the time, which makes it pessimistic by up to one pass, but
+ * never optimistic. If the very first pass sees /MREQ already low core1 was
+ * busy when the edge came, there's no start time, and the byte's counted as
+ * unseen rather than timed.
+ *
+ * With core1 serving the ROM the end is when it has set the data bus to
+ * outputs. With the PIO ROM server core1 only watches, and the end is when it
+ * sees the PIO's output enables for the data bus go on, so both are covered.
+ *
+ * The times go into a histogram, one RP2350 cycle per slot, which gives the
+ * percentiles. Each is also checked against the deadline: an M1 fetch's data
+ * is sampled on the rising clock edge 1.5 Z80 cycles after MREQ goes low, and
+ * has to be there the Z80's setup time before that. Reads other than M1 have
+ * another half cycle, but core1 can't tell them apart, so everything is held
+ * to the M1 deadline. Any that miss it are counted. The lot can be looked at
+ * with the query functions, or with the debugger as rom_serve_timing.
+ */
+#define MEASURE_ROM_LATENCY 1
+
+#if MEASURE_ROM_LATENCY
+
+#define Z80_DATA_SETUP_NS        35      // Z80A, data to rising clock edge in M1
+#define GPIO_INPUT_SYNC_CYCLES   2       // RP2350 GPIO input synchronisers
+#define ROM_SERVE_HISTOGRAM_SIZE 128     // Last slot is that many cycles or more
+
+typedef struct _rom_serve_timing
+{
+  uint32_t          deadline_cycles;
+  volatile uint32_t count;
+  volatile uint32_t late;
+  volatile uint32_t unseen;
+  volatile uint32_t worst_cycles;
+  volatile uint32_t histogram[ROM_SERVE_HISTOGRAM_SIZE];
+}
+ROM_SERVE_TIMING;
+
+static ROM_SERVE_TIMING rom_serve_timing;
+
+/*
+ * The deadline, in RP2350 cycles from /MREQ going low, for the Z80's clock
+ * and the RP2350's. Core1 starts its own DWT cycle counter for the timings.
+ */
+static void init_rom_serve_timing( void )
+{
+  const uint64_t sys_hz   = clock_get_hz( clk_sys );
+  const uint64_t z80_hz   = query_machine_profile()->cpu_clock_hz;
+  const uint64_t m1_ns    = (1500000000ULL + z80_hz/2) / z80_hz;
+  const uint64_t budget   = m1_ns - Z80_DATA_SETUP_NS;
+
+  memset( &rom_serve_timing, 0, sizeof(rom_serve_timing) );
+  rom_serve_timing.deadline_cycles = (uint32_t)((budget * sys_hz) / 1000000000ULL);
+
+  m33_hw->demcr    |= M33_DEMCR_TRCENA_BITS;
+  m33_hw->dwt_cyccnt = 0;
+  m33_hw->dwt_ctrl |= M33_DWT_CTRL_CYCCNTENA_BITS;
+}
+
+/*
+ * Core1, with the byte on the bus. idle_at is the cycle count from the last
+ * pass of the spin loop which saw /MREQ high, or the same as request_at if
+ * there wasn't one.
+ */
+static __force_inline void record_rom_serve_time( const uint32_t idle_at, const uint32_t request_at )
+{
+  ROM_SERVE_TIMING *timing = &rom_serve_timing;
+
+  if( idle_at == request_at )
+  {
+    timing->unseen++;
+    return;
+  }
+
+  const uint32_t serve_cycles = m33_hw->dwt_cyccnt - idle_at + GPIO_INPUT_SYNC_CYCLES;
+
+  timing->histogram[(serve_cycles < ROM_SERVE_HISTOGRAM_SIZE) ? serve_cycles : ROM_SERVE_HISTOGRAM_SIZE-1]++;
+  timing->count++;
+
+  if( serve_cycles > timing->deadline_cycles )
+    timing->late++;
+
+  if( serve_cycles > timing->worst_cycles )
+    timing->worst_cycles = serve_cycles;
+}
+
+uint32_t query_rom_serve_worst_cycles( void )
+{
+  return rom_serve_timing.worst_cycles;
+}
+
+uint32_t query_rom_serve_deadline_cycles( void )
+{
+  return rom_serve_timing.deadline_cycles;
+}
+
+uint32_t query_rom_serve_count( void )
+{
+  return rom_serve_timing.count;
+}
+
+uint32_t query_rom_serve_late_count( void )
+{
+  return rom_serve_timing.late;
+}
+
+uint32_t query_rom_serve_unseen_count( void )
+{
+  return rom_serve_timing.unseen;
+}
+
+/*
+ * The time, in RP2350 cycles, which the given percentage of ROM bytes were
+ * served within. Core1 carries on counting while this looks, so it's only
+ * near enough, which is all it needs to be.
+ */
+uint32_t query_rom_serve_percentile_cycles( const uint32_t percent )
+{
+  uint64_t total = 0;
+  for( uint32_t i=0; i < ROM_SERVE_HISTOGRAM_SIZE; i++ )
+    total += rom_serve_timing.histogram[i];
+
+  const uint64_t wanted = (total * percent + 99) / 100;
+
+  uint64_t seen = 0;
+  for( uint32_t i=0; i < ROM_SERVE_HISTOGRAM_SIZE; i++ )
+  {
+    seen += rom_serve_timing.histogram[i];
+    if( seen >= wanted && seen != 0 )
+      return i;
+  }
+
+  return 0;
+}
+
+#else
+
+/* Switched off, there's nothing to report */
+uint32_t query_rom_serve_worst_cycles( void )
+{
+  return 0;
+}
+
+uint32_t query_rom_serve_deadline_cycles( void )
+{
+  return 0;
+}
+
+uint32_t query_rom_serve_count( void )
+{
+  return 0;
+}
 
-void set_initial_jp( uint16_t dest )
+uint32_t query_rom_serve_late_count( void )
 {
-  initial_jp_destination = dest;
+  return 0;
 }
 
-void reset_initial_jp( void )
+uint32_t query_rom_serve_unseen_count( void )
 {
-  initial_jp_destination = 0;
+  return 0;
 }
 
+uint32_t query_rom_serve_percentile_cycles( const uint32_t percent )
+{
+  return 0;
+}
+
+#endif
+
 inline uint32_t using_rom_emulation( void )
 {
 #define EMULATE_ROM 0
   return EMULATE_ROM;
 }
 
+/*
+ * 16 bit sum of the ROM image being served, used to identify it
+ */
+uint16_t query_emulated_rom_checksum( void )
+{
+  return query_rom_bank_checksum();
+}
+
 /*
  * As things stand:
  * ROM emulation can be on of off. It's only really used for testing.
@@ -69,55 +267,365 @@ inline uint32_t using_rom_emulation( void )
  */
 static EMULATION_MODE emulation_mode;
 
-static void core1_rom_emulation( void )
+/*
+ * Shadow ROM. With the ROM being emulated core1 answers every read from
+ * 0x0000-0x3FFF, and it already mirrors the writes there. Serving those reads
+ * from a writable buffer, the one the writes go into, turns the ROM area into
+ * 16K of RAM. Each image starts off as a copy of the ROM, and any of them can
+ * be paged in, for overlays. The RP2350 side can write an image directly, no
+ * bus cycles needed, via query_shadow_rom_image_ptr().
+ *
+ * Image 0 is the mirror's ROM area, so the PIO bus snooper (which only knows
+ * about the 64K mirror) puts writes in the right place as long as image 0 is
+ * the one paged in.
+ */
+inline uint32_t using_shadow_rom( void )
+{
+#define USE_SHADOW_ROM 0
+  return USE_SHADOW_ROM;
+}
+
+static uint8_t  shadow_rom_extra_images[NUM_SHADOW_ROM_IMAGES-1][ZX_SEGMENT_SIZE];
+static uint8_t *shadow_rom_images[NUM_SHADOW_ROM_IMAGES];
+static uint8_t  shadow_rom_image = 0;
+
+/*
+ * True if the PIO is serving the ROM reads rather than core1. It serves from
+ * a fixed, 16K aligned, image: a copy of the ROM, or shadow ROM image 0 (which
+ * is in the 64K aligned mirror). Shadow ROM paging isn't supported with it.
+ */
+static bool pio_rom_serving = false;
+
+/*
+ * Where core1 serves ROM reads from. A ROM from the ROM bank unless the shadow
+ * ROM is in use. Looked at on every ROM read, so it's in scratch X.
+ */
+static const uint8_t * volatile served_rom_image __scratch_x("served_rom_image") = NULL;
+
+/*
+ * Point core1 at the active ROM bank's image for the ROM the 128K paging latch
+ * has selected. A single word store, so core1 sees the old ROM or the new one,
+ * never a mix. The shadow ROM and the PIO ROM server have their own images and
+ * aren't affected.
+ */
+static void __scratch_x("select_served_rom") select_served_rom( void )
+{
+  if( emulation_mode != FULL_ROM_EMULATION || using_shadow_rom() || pio_rom_serving )
+    return;
+
+  const uint8_t page = (query_zx_paging_latch() & ZX_PAGING_ROM_SELECT) ? 1 : 0;
+  served_rom_image = query_rom_bank_page( page );
+}
+
+/*
+ * The PIO ROM server only ever serves the image it was started with, so
+ * nothing which changes the ROM can work while it's running.
+ */
+bool is_pio_rom_serving( void )
+{
+  return pio_rom_serving;
+}
+
+/* Set by core1 once it's into its bus loop */
+static volatile bool core1_running = false;
+
+bool is_core1_running( void )
+{
+  return core1_running;
+}
+
+/*
+ * Switch to a different bank of ROMs, e.g. from the 48K ROM to a patched one,
+ * while the Spectrum runs. Returns false if the bank doesn't exist or the ROM
+ * isn't being served from the bank.
+ */
+bool switch_rom_bank( const uint8_t bank )
+{
+  if( emulation_mode != FULL_ROM_EMULATION || using_shadow_rom() || pio_rom_serving )
+    return false;
+
+  if( !select_rom_bank( bank ) )
+    return false;
+
+  select_served_rom();
+  return true;
+}
+
+/*
+ * Reset the Spectrum, e.g. so it boots into a different ROM. The 128K paging
+ * latch goes back to 0 with it.
+ */
+void reset_z80( void )
+{
+  gpio_put( GPIO_RESET_Z80, 1 );
+  sleep_ms( 10 );
+
+  reset_zx_mirror_paging();
+  select_served_rom();
+
+  gpio_put( GPIO_RESET_Z80, 0 );
+}
+
+static void init_shadow_rom( void )
+{
+  shadow_rom_images[0] = query_zx_mirror_rom_area();
+  for( uint32_t i=1; i < NUM_SHADOW_ROM_IMAGES; i++ )
+    shadow_rom_images[i] = shadow_rom_extra_images[i-1];
+
+  for( uint32_t i=0; i < NUM_SHADOW_ROM_IMAGES; i++ )
+    memcpy( shadow_rom_images[i], query_rom_bank_page( 0 ), ZX_SEGMENT_SIZE );
+
+  shadow_rom_image = 0;
+  set_zx_mirror_rom_segment( shadow_rom_images[0] );
+  served_rom_image = shadow_rom_images[0];
+}
+
+/*
+ * Page a shadow ROM image in at 0x0000. Writes are pointed at it before reads
+ * are, so there's no moment where a write goes to an image that's not being
+ * read from. Returns false if the shadow ROM isn't in use or the image number
+ * is out of range.
+ */
+bool page_shadow_rom_image( const uint8_t image )
+{
+  if( !using_shadow_rom() || emulation_mode != FULL_ROM_EMULATION || image >= NUM_SHADOW_ROM_IMAGES )
+    return false;
+
+  if( pio_rom_serving )
+    return false;
+
+  set_zx_mirror_rom_segment( shadow_rom_images[image] );
+  served_rom_image = shadow_rom_images[image];
+  shadow_rom_image = image;
+
+  return true;
+}
+
+uint8_t query_shadow_rom_image( void )
+{
+  return shadow_rom_image;
+}
+
+uint8_t *query_shadow_rom_image_ptr( const uint8_t image )
+{
+  if( !using_shadow_rom() || emulation_mode != FULL_ROM_EMULATION || image >= NUM_SHADOW_ROM_IMAGES )
+    return NULL;
+
+  return shadow_rom_images[image];
+}
+
+/*
+ * HALT detection. When the Z80 executes a HALT it sits there doing M1 fetches
+ * from the same address over and over (with a refresh cycle in between each one)
+ * until an interrupt arrives. Normal code never reads the same address several
+ * times in a row like that; even a tight JR $ loop alternates between two
+ * addresses. So a run of reads from one address, with no other reads or writes
+ * in between, means the Z80 is halted and a bus request won't cost the running
+ * program anything.
+ *
+ * The /HALT line isn't wired to the RP2350, which is why it's done this way.
+ */
+#define HALT_DETECT_REPEAT_COUNT  3
+
+static volatile uint32_t z80_halted = 0;
+static uint32_t          last_read_address   = 0xFFFFFFFF;
+static uint32_t          read_repeat_counter = 0;
+
+uint32_t is_z80_halted( void )
+{
+  return z80_halted;
+}
+
+static inline void track_read_for_halt( const uint32_t address )
+{
+  if( address == last_read_address )
+  {
+    if( ++read_repeat_counter >= HALT_DETECT_REPEAT_COUNT )
+      z80_halted = 1;
+  }
+  else
+  {
+    last_read_address   = address;
+    read_repeat_counter = 0;
+    z80_halted          = 0;
+  }
+}
+
+static inline void track_write_for_halt( void )
+{
+  /* Any write, the interrupt pushing PC for example, means the Z80 is running */
+  last_read_address   = 0xFFFFFFFF;
+  read_repeat_counter = 0;
+  z80_halted          = 0;
+}
+
+/*
+ * For the profiler, a read which isn't followed by a refresh wasn't an opcode
+ * fetch. Core1's loop holds the last read in a local until it knows.
+ */
+#define PROFILE_NO_READ  ((uint32_t)0xFFFFFFFF)
+
+static inline void profile_write( const ZX_ADDR zx_addr, const uint64_t gpios, uint32_t *profile_read )
+{
+  if( *profile_read != PROFILE_NO_READ )
+  {
+    exec_profile_read( *profile_read );
+    *profile_read = PROFILE_NO_READ;
+  }
+
+  /* Writes made by the DMA engine don't count */
+  if( gpios & BUSACK_MASK )
+    exec_profile_write( zx_addr );
+}
+
+static void __scratch_x("core1_rom_emulation") core1_rom_emulation( void )
 {
   irq_set_mask_enabled( 0xFFFFFFFF, 0 );
 
-  initial_jp_destination = 0;
+  /* If the PIO is serving the ROM, reads are only watched here, like RAM reads */
+  const bool serve_rom     = (emulation_mode == FULL_ROM_EMULATION) && !pio_rom_serving;
+
+#if MEASURE_ROM_LATENCY
+  init_rom_serve_timing();
+
+  /* The PIO's bytes are timed too, by watching for it to drive the data bus */
+  const bool               time_pio_rom  = (emulation_mode == FULL_ROM_EMULATION) && pio_rom_serving;
+  const volatile uint32_t *pio_rom_padoe = query_pio_rom_server_padoe();
+#endif
+
+  /* Logging writes costs time on every bus cycle, so it's only done if asked for */
+  const bool write_log     = using_write_log();
+  uint64_t   last_int_level = INT_MASK;
+
+  /* ROM traps are checked for once the read has finished */
+  const bool rom_traps     = using_rom_traps();
+
+  /* INs from the coprocessor's port are answered here, OUTs to it are stored */
+  const bool io_registers  = using_io_registers();
+
+  /*
+   * The profiler needs to know what follows each read. The last read is held
+   * here until the next cycle shows whether it was an opcode fetch.
+   */
+  const bool exec_profile  = using_exec_profile();
+  uint32_t   profile_read  = PROFILE_NO_READ;
+
+  /* Core0 can hand things over to the loop now, the I/O register port for one */
+  core1_running = true;
 
   while( 1 )
   {
-    const uint64_t mreq_mask = MREQ_MASK;
-    const uint64_t rd_mask   = RD_MASK;
-    const uint64_t wr_mask   = WR_MASK;
+    const uint64_t mreq_mask      = MREQ_MASK;
+    const uint64_t iorq_mask      = IORQ_MASK;
+    const uint64_t mreq_iorq_mask = MREQ_IORQ_MASK;
+    const uint64_t rd_mask        = RD_MASK;
+    const uint64_t wr_mask        = WR_MASK;
 
     uint64_t gpios;
     
-    /* Spin, waiting for a memory request. (Approx 90ns to 100ns)  */
-    while( ((gpios = gpio_get_all64()) & mreq_mask) );
+    /* Spin, waiting for a memory or I/O request. (Approx 90ns to 100ns)  */
+#if MEASURE_ROM_LATENCY
+    uint32_t request_at = m33_hw->dwt_cyccnt;
+    uint32_t idle_at    = request_at;
+    while( ((gpios = gpio_get_all64()) & mreq_iorq_mask) == mreq_iorq_mask )
+    {
+      idle_at    = request_at;
+      request_at = m33_hw->dwt_cyccnt;
+    }
+#else
+    while( ((gpios = gpio_get_all64()) & mreq_iorq_mask) == mreq_iorq_mask );
+#endif
+
+    /* The write log needs to know when each frame starts */
+    if( write_log )
+    {
+      const uint64_t int_level = gpios & INT_MASK;
+      if( int_level != last_int_level )
+      {
+        last_int_level = int_level;
+        if( int_level == 0 )
+          write_log_new_frame();
+      }
+    }
 
     /* Pick up the address being accessed (approx 20ns) */
     uint64_t address = (gpios & GPIO_ABUS_BITMASK) >> GPIO_ABUS_A0;
 
+    /*
+     * MREQ is high so it's an I/O cycle. OUTs are snooped for the 128K paging
+     * latch and the ULA's port, the address bus has the port number on it.
+     * /IORQ and /WR go low together, so it might take a second time round
+     * to see the /WR. An interrupt acknowledge has /IORQ low with neither
+     * /RD nor /WR, that just goes round until it's finished.
+     */
+    if( gpios & mreq_mask )
+    {
+      if( exec_profile && profile_read != PROFILE_NO_READ )
+      {
+        exec_profile_read( profile_read );
+        profile_read = PROFILE_NO_READ;
+      }
+
+      if( (gpios & wr_mask) == 0 )
+      {
+        snoop_zx_port_write( address, (gpios & GPIO_DBUS_BITMASK) & 0xFF );
+
+        if( io_registers && is_io_register_port( address ) )
+          write_io_register( address >> 8, (gpios & GPIO_DBUS_BITMASK) & 0xFF );
+
+        /* On a 128K the write might have been to the paging latch's ROM select bit */
+        if( serve_rom && (address & 0x8002) == 0 )
+          select_served_rom();
+        while( (gpio_get_all64() & iorq_mask) == 0 );
+      }
+      else if( (gpios & rd_mask) == 0 )
+      {
+        /*
+         * An IN from the coprocessor's port. I/O cycles have a wait state built
+         * in, the Z80 reads the data bus about 700ns after /IORQ goes low, which
+         * is a lot longer than a ROM read gives. There's no need for /WAIT.
+         * The DMA engine's own I/O reads are left alone.
+         */
+        if( io_registers && is_io_register_port( address ) && (gpios & BUSACK_MASK) )
+        {
+          const uint8_t data = read_io_register( address >> 8 );
+
+          gpio_set_dir_out_masked64( GPIO_DBUS_BITMASK );
+          gpio_put_masked64( GPIO_DBUS_BITMASK, (uint64_t)data << GPIO_DBUS_D0 );
+
+          while( (gpio_get_all64() & iorq_mask) == 0 );
+
+          gpio_set_dir_in_masked64( GPIO_DBUS_BITMASK );
+        }
+        else
+        {
+          while( (gpio_get_all64() & iorq_mask) == 0 );
+        }
+      }
+
+      continue;
+    }
+
     /* Is it a read that's happening? (Approx 35ns) */
     if( (gpios & rd_mask) == 0 )
     {
-      if( emulation_mode == FULL_ROM_EMULATION )
+      if( serve_rom )
       {
         /* Ignore reads from anywhere other than ROM, the Spectrum still reads its own RAM (Approx 15ns) */
         if( address <= 0x3FFF )
         {
-          /* Pick up ROM byte from local image */
-          uint8_t data = *(_48_original_rom+address);
-#if 0
-          if( using_z80_test_image() )
-          {
-            /* Inject JP to the z80 test code into bytes 0, 1 and 2 */
-            if( initial_jp_destination != 0 )
-            {
-              if(      address == 0x0000 ) data = 0xc3;
-              else if( address == 0x0001 ) data = (uint8_t)(initial_jp_destination & 0xFF);
-              else if( address == 0x0002 ) data = (uint8_t)((initial_jp_destination >> 8) & 0xFF);
-              }
-            }
-          }
-#endif
+          /* Pick up ROM byte from local image, or the shadow ROM */
+          uint8_t data = *(served_rom_image+address);
           /* Set the data bus to outputs */
           gpio_set_dir_out_masked64( GPIO_DBUS_BITMASK );
 
           /* Write the value out to the Z80 */
           gpio_put_masked64( GPIO_DBUS_BITMASK, (data & 0xFF) << GPIO_DBUS_D0 );
 
+#if MEASURE_ROM_LATENCY
+          record_rom_serve_time( idle_at, request_at );
+#endif
+
           /*
            * As of this point the data is on the bus ready for the CPU to read it.
            * The read happens 428ns after MREQ goes low. This point is reached
@@ -143,7 +651,37 @@ static void core1_rom_emulation( void )
       }
       else
       {
-        /* It's a read, but we're not emulating the ZX ROM. Ignore it. */
+        /*
+         * It's a read, but we're not emulating the ZX ROM, or the PIO is. The
+         * Spectrum or the PIO handles it. Wait for it to finish so it's only
+         * counted once by the HALT check.
+         */
+#if MEASURE_ROM_LATENCY
+        /* A PIO which hasn't driven the bus by the end of the read times as late */
+        if( time_pio_rom && (address <= 0x3FFF) )
+        {
+          while( ((*pio_rom_padoe & GPIO_DBUS_BITMASK) == 0) && ((gpio_get_all64() & mreq_mask) == 0) );
+          record_rom_serve_time( idle_at, request_at );
+        }
+#endif
+        while( (gpio_get_all64() & mreq_mask) == 0 );
+      }
+
+      /* The read has finished, there's time to see if it was from a trapped ROM address */
+      if( rom_traps && (address <= 0x3FFF) && is_rom_trap_page( address ) )
+        check_rom_traps( address );
+
+      /* And to see if the Z80 is sitting in a HALT */
+      track_read_for_halt( address );
+
+      /* Hold on to it for the profiler, once the one before it has been counted */
+      if( exec_profile )
+      {
+        if( profile_read != PROFILE_NO_READ )
+          exec_profile_read( profile_read );
+
+        /* Reads the DMA engine makes don't count */
+        profile_read = (gpios & BUSACK_MASK) ? (uint32_t)address : PROFILE_NO_READ;
       }
     }
     else if( (gpios & wr_mask) == 0 )
@@ -151,12 +689,51 @@ static void core1_rom_emulation( void )
       /*
        * Pick the value being written from the data bus and mirror it.
        * Writes to ROM will be written into the mirror, but they're not
-       * accessed from there. The code above uses its own ROM image.
+       * accessed from there unless the shadow ROM is in use, in which
+       * case this is how the shadow ROM gets written. The code above
+       * otherwise uses its own ROM image.
        * I did it this way for speed. There's not enough time here to
        * check if address is < 0x4000.
        */
       uint8_t data = (gpios & GPIO_DBUS_BITMASK) & 0xFF;
-      put_zx_mirror_byte( address, data );
+
+      /*
+       * Writes into a page with a write watch on it get checked against the watches.
+       * Writes made by the DMA engine (i.e. while the Z80 has given up its bus) don't
+       * count, the watches are for the Z80 program.
+       */
+      if( is_write_watched_page( address ) && (gpios & BUSACK_MASK) )
+      {
+        const uint8_t old_value = snoop_watched_zx_mirror_byte( address, data );
+
+        check_write_watches( address, data, old_value );
+
+        /* This one does wait for the write to finish, so the watch only fires once */
+        while( (gpio_get_all64() & mreq_mask) == 0 );
+      }
+      else
+      {
+        snoop_zx_mirror_byte( address, data );
+      }
+
+      /*
+       * The log has to see each write once, so this does wait for the write to
+       * finish. Writes while BUSACK is low are the DMA engine's.
+       */
+      if( write_log )
+      {
+        write_log_zx_write( address, data, (gpios & BUSACK_MASK) ? WRITE_LOG_FLAG_NONE : WRITE_LOG_FLAG_DMA );
+        while( (gpio_get_all64() & mreq_mask) == 0 );
+      }
+
+      /* The profiler counts each write once, so this has to wait for it to finish too */
+      if( exec_profile )
+      {
+        profile_write( address, gpios, &profile_read );
+        while( (gpio_get_all64() & mreq_mask) == 0 );
+      }
+
+      track_write_for_halt();
 
       /*
        * I don't attempt to wait for the MREQ to finish. The timing is too
@@ -172,7 +749,45 @@ static void core1_rom_emulation( void )
        * timing is too tight, it's quicker just to let it go back to the
        * top of the loop and drop through here several times while the
        * refresh completes.
+       *
+       * I looked at slotting single byte DMA writes into these refresh
+       * windows, so small status writes wouldn't need a BUSREQ. It can't
+       * be done on this board. The M1 cycle model (Z80 manual fig 5) is:
+       *
+       *  T1-T2  /MREQ and /RD low, PC on the address bus, opcode read
+       *  T3     /RFSH low, IR on the address bus, /MREQ low again from
+       *         the falling edge of T3 (about 1.5 cycles, 430ns at 3.5MHz)
+       *  T4     /MREQ goes high halfway through, /RFSH at the end
+       *
+       * The data bus is idle during T3-T4, but the address bus isn't. The
+       * Z80 is actively driving the refresh address onto A0-A15, and it
+       * drives /WR high, it doesn't let it float. The RP2350 would have to
+       * fight the Z80's drivers to put a different address and a /WR on
+       * the bus, and the ULA and the 74LS RAS/CAS logic only ever see the
+       * refresh address anyway. Only BUSACK floats those lines, so every
+       * write into the Spectrum's memory still needs a bus request.
        */
+      if( exec_profile && profile_read != PROFILE_NO_READ )
+      {
+        /*
+         * A read followed by a refresh was an opcode fetch. The start of a
+         * write looks like a refresh too, /MREQ goes low a T-state before /WR,
+         * and so can the start of a read if /RD is a little behind. So see
+         * how this one turns out: a refresh ends without either of them.
+         */
+        uint64_t cycle;
+        do
+        {
+          cycle = gpio_get_all64();
+        }
+        while( (cycle & (mreq_mask|rd_mask|wr_mask)) == (rd_mask|wr_mask) );
+
+        if( cycle & mreq_mask )
+        {
+          exec_profile_fetch( profile_read );
+          profile_read = PROFILE_NO_READ;
+        }
+      }
     }
   } /* End infinite loop */
 }
@@ -181,5 +796,24 @@ static void core1_rom_emulation( void )
 void start_rom_emulation( EMULATION_MODE mode )
 {
   emulation_mode = mode;
+
+  select_served_rom();
+
+  if( mode == FULL_ROM_EMULATION && using_shadow_rom() )
+    init_shadow_rom();
+
+  if( mode == FULL_ROM_EMULATION && using_pio_rom_server() )
+  {
+    const uint8_t *image = query_pio_rom_server_image();
+
+    if( using_shadow_rom() )
+      image = query_shadow_rom_image_ptr( 0 );
+    else
+      memcpy( query_pio_rom_server_image(), query_rom_bank_page( 0 ), ZX_SEGMENT_SIZE );
+
+    /* If it can't be started for some reason, core1 serves the ROM as usual */
+    pio_rom_serving = init_pio_rom_server( image );
+  }
+
   multicore_launch_core1( core1_rom_emulation );
 }
@@ -21,6 +21,7 @@
 #define __ZX_MEMORY_MANAGEMENT_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "pico/sync.h"
 
@@ -31,10 +32,33 @@ typedef enum
 }
 EMULATION_MODE;
 
+/*
+ * Shadow ROM, writable 16K images served in place of the ROM. Image 0 is
+ * the mirror's own ROM area, the others are held separately.
+ */
+#define NUM_SHADOW_ROM_IMAGES  3
+
 uint32_t using_rom_emulation( void );
+uint32_t using_shadow_rom( void );
+uint16_t query_emulated_rom_checksum( void );
+
+bool page_shadow_rom_image( const uint8_t image );
+uint8_t query_shadow_rom_image( void );
+uint8_t *query_shadow_rom_image_ptr( const uint8_t image );
 
 void start_rom_emulation( EMULATION_MODE );
-void set_initial_jp( uint16_t dest );
-void reset_initial_jp( void );
+
+bool is_pio_rom_serving( void );
+bool is_core1_running( void );
+bool switch_rom_bank( const uint8_t bank );
+void reset_z80( void );
+
+uint32_t is_z80_halted( void );
+uint32_t query_rom_serve_worst_cycles( void );
+uint32_t query_rom_serve_deadline_cycles( void );
+uint32_t query_rom_serve_count( void );
+uint32_t query_rom_serve_late_count( void );
+uint32_t query_rom_serve_unseen_count( void );
+uint32_t query_rom_serve_percentile_cycles( const uint32_t percent );
 
 #endif
@@ -19,29 +19,430 @@
 
 #include <string.h>
 
+#include "pico/platform.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+
 #include "zx_mirror.h"
+#include "machine_profile.h"
+#include "cmd_immediate.h"
 
 /*
  * Local copy of the ZX memory, 64K including the ROM. The ROM area in this
  * image is unused. The ROM emulation code uses its own buffer for that. 
  * The $0000 to $3FFF area here will be updated if anything writes to ROM
  * (which some code in the Spectrum ROM does do). But it will be ignored.
+ *
+ * It's 64K aligned so the PIO bus snooper can make the address of a byte in
+ * here by sticking the Z80 address on the bottom of the mirror's base address.
+ *
+ * The 16K segments of this are the ROM area, then RAM banks 5, 2 and 0, i.e.
+ * the 48K layout, which is also what a 128K has at power on. The other 128K
+ * RAM banks are held separately. The PIO snooper only knows about this 64K,
+ * so it's no good on a 128K which pages.
+ *
+ * RAM budget. These are the biggest users of the RP2350's 512K of main SRAM,
+ * which also holds the code (PICO_COPY_TO_RAM). The mirror takes 64K here,
+ * 64K aligned, plus 80K for the other 5 banks. The optional buffers are only
+ * allocated when their feature is switched on:
+ *
+ *   Mirror, 48K layout                  64K  64K aligned
+ *   Mirror, other 128K banks            80K
+ *   Shadow ROM images 1 and 2           32K
+ *   ROM trap patched image              16K
+ *   Write log (USE_WRITE_LOG)          128K
+ *   Exec profile (USE_EXEC_PROFILE)     66K
+ *   PIO ROM image (USE_PIO_ROM_SERVER)  16K  16K aligned
+ */
+static uint8_t zx_memory_mirror[ZX_MEMORY_SIZE] __attribute__((aligned(ZX_MEMORY_SIZE)));
+static uint8_t zx_mirror_other_banks[ZX_NUM_RAM_BANKS-3][ZX_SEGMENT_SIZE];
+
+static uint8_t * const zx_mirror_banks[ZX_NUM_RAM_BANKS] =
+{
+  &zx_memory_mirror[3*ZX_SEGMENT_SIZE],    // Bank 0
+  zx_mirror_other_banks[0],                // Bank 1
+  &zx_memory_mirror[2*ZX_SEGMENT_SIZE],    // Bank 2
+  zx_mirror_other_banks[1],                // Bank 3
+  zx_mirror_other_banks[2],                // Bank 4
+  &zx_memory_mirror[1*ZX_SEGMENT_SIZE],    // Bank 5
+  zx_mirror_other_banks[3],                // Bank 6
+  zx_mirror_other_banks[4],                // Bank 7
+};
+
+/*
+ * Where each 16K segment of the Z80's address space is in the mirror right now.
+ * Only the first and last ever change. Core0 looks at this for every byte it
+ * reads or writes, so it's in main SRAM with core0's code. It's not static
+ * because get_zx_mirror_byte() is inline in zx_mirror.h.
+ *
+ * Core1 has its own copy in scratch X, with its loop, see
+ * zx_memory_management.c. The two are only ever changed together, by
+ * set_zx_mirror_segment().
+ */
+uint8_t * volatile zx_mirror_segments[4] =
+{
+  &zx_memory_mirror[0*ZX_SEGMENT_SIZE],
+  &zx_memory_mirror[1*ZX_SEGMENT_SIZE],
+  &zx_memory_mirror[2*ZX_SEGMENT_SIZE],
+  &zx_memory_mirror[3*ZX_SEGMENT_SIZE],
+};
+
+static uint8_t * volatile zx_mirror_core1_segments[4] __scratch_x("zx_mirror_core1_segments") =
+{
+  &zx_memory_mirror[0*ZX_SEGMENT_SIZE],
+  &zx_memory_mirror[1*ZX_SEGMENT_SIZE],
+  &zx_memory_mirror[2*ZX_SEGMENT_SIZE],
+  &zx_memory_mirror[3*ZX_SEGMENT_SIZE],
+};
+
+/*
+ * Core1's copy first, that's the one which decides where snooped writes go.
+ * Forced inline so core1's paging update stays in scratch X.
+ */
+static __force_inline void set_zx_mirror_segment( const uint32_t segment, uint8_t *ptr )
+{
+  zx_mirror_core1_segments[segment] = ptr;
+  zx_mirror_segments[segment]       = ptr;
+}
+
+/*
+ * Port state. Core1 writes these when it snoops an OUT, anything can read them.
+ * The paging latch is only followed on a 128K, a 48K doesn't have one.
+ */
+static bool             zx_paging_enabled = false;
+static volatile uint8_t zx_paging_latch   = 0;
+static volatile uint8_t zx_ula_port       = 0;
+
+/*
+ * Dirty tracking. One flag per 256 byte page of the mirror, plus one flag per
+ * 32 bytes of screen memory, which is where the finer detail is useful.
+ *
+ * These are bytes, not bits, on purpose. Core1 sets them from the snoop loop
+ * with a plain store, no read-modify-write, so there's nothing for core0 to
+ * race with when it clears them. Core0 only clears a flag it has just seen
+ * set, and core1 always writes the mirror byte before it sets the flag. So if
+ * the flag is cleared just after core1 set it again, the new byte is already
+ * in the mirror when the caller goes to look at the page.
+ */
+static volatile uint8_t zx_dirty_pages[ZX_MIRROR_NUM_PAGES] __attribute__((aligned(4)));
+static volatile uint8_t zx_dirty_screen_cells[ZX_MIRROR_NUM_SCREEN_CELLS_ALIGNED] __attribute__((aligned(4)));
+
+/*
+ * Mark the byte at offset dirty. Forced inline so core1's copy in
+ * snoop_zx_mirror_byte() stays in scratch X and core0's in put_zx_mirror_byte()
+ * stays in main SRAM.
+ */
+static __force_inline void mark_zx_mirror_byte_dirty( const ZX_ADDR offset )
+{
+  zx_dirty_pages[offset >> ZX_MIRROR_PAGE_SHIFT] = 1;
+
+  /* Unsigned, so anything below the screen wraps round to a big number */
+  const uint32_t screen_offset = (uint32_t)offset - ZX_SCREEN_START;
+  if( screen_offset < ZX_SCREEN_LENGTH )
+    zx_dirty_screen_cells[screen_offset >> ZX_MIRROR_SCREEN_CELL_SHIFT] = 1;
+}
+
+/*
+ * Core0's write into the mirror. Core1 has its own, snoop_zx_mirror_byte().
+ */
+void put_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value )
+{
+  zx_mirror_segments[offset >> ZX_SEGMENT_SHIFT][offset & ZX_SEGMENT_MASK] = value;
+  mark_zx_mirror_byte_dirty( offset );
+}
+
+/*
+ * Mark a range of the mirror dirty. This is for callers which have written a
+ * block with store_zx_mirror_byte(), which doesn't, because they're writing
+ * inside timed bus cycles. The range can wrap round from 0xFFFF to 0x0000.
+ */
+static void mark_zx_mirror_range_dirty( const uint32_t first, const uint32_t last )
+{
+  for( uint32_t page=(first >> ZX_MIRROR_PAGE_SHIFT); page <= (last >> ZX_MIRROR_PAGE_SHIFT); page++ )
+    zx_dirty_pages[page] = 1;
+
+  const uint32_t first_screen = (first > ZX_SCREEN_START) ? first : ZX_SCREEN_START;
+  const uint32_t last_screen  = (last < ZX_SCREEN_START+ZX_SCREEN_LENGTH-1) ? last : ZX_SCREEN_START+ZX_SCREEN_LENGTH-1;
+
+  if( first_screen > last_screen )
+    return;
+
+  for( uint32_t cell=((first_screen-ZX_SCREEN_START) >> ZX_MIRROR_SCREEN_CELL_SHIFT);
+       cell <= ((last_screen-ZX_SCREEN_START) >> ZX_MIRROR_SCREEN_CELL_SHIFT);
+       cell++ )
+    zx_dirty_screen_cells[cell] = 1;
+}
+
+void mark_zx_mirror_dirty( const ZX_ADDR addr, const uint32_t length )
+{
+  if( length == 0 )
+    return;
+
+  if( length >= ZX_MEMORY_SIZE )
+  {
+    mark_zx_mirror_range_dirty( 0, ZX_MEMORY_SIZE-1 );
+    return;
+  }
+
+  const uint32_t last = (uint32_t)addr + length - 1;
+  if( last < ZX_MEMORY_SIZE )
+  {
+    mark_zx_mirror_range_dirty( addr, last );
+  }
+  else
+  {
+    mark_zx_mirror_range_dirty( addr, ZX_MEMORY_SIZE-1 );
+    mark_zx_mirror_range_dirty( 0, last-ZX_MEMORY_SIZE );
+  }
+}
+
+/*
+ * Write sequencing. Core1 bumps the sequence number every time it mirrors a
+ * snooped write, after the byte is in the mirror. A write to the command
+ * trigger's high byte also has its sequence number noted. That lets core0
+ * find out when core1 has caught up with a trigger write it saw on the bus,
+ * however much the Z80 has written since (a PUSH, a CALL, the /INT handler).
+ * Core1 handles writes in the order the Z80 makes them, so once it's caught
+ * up with one write all the ones before it are in the mirror too.
+ */
+#define ZX_MIRROR_TRIGGER_ADDR  ((ZX_ADDR)(IMMEDIATE_CMD_TRIGGER_REG+1))
+
+static volatile uint32_t zx_mirror_snoop_seq   = 0;
+static volatile uint32_t zx_mirror_trigger_seq = 0;
+
+/*
+ * Core1's version of put_zx_mirror_byte(), for bytes it has snooped off the bus.
+ */
+void __scratch_x("snoop_zx_mirror_byte") snoop_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value )
+{
+  zx_mirror_core1_segments[offset >> ZX_SEGMENT_SHIFT][offset & ZX_SEGMENT_MASK] = value;
+  mark_zx_mirror_byte_dirty( offset );
+
+  const uint32_t seq = zx_mirror_snoop_seq + 1;
+
+  __dmb();
+  if( offset == ZX_MIRROR_TRIGGER_ADDR )
+    zx_mirror_trigger_seq = seq;
+  zx_mirror_snoop_seq = seq;
+}
+
+/*
+ * The same for a write into a watched page, which also needs the byte it
+ * replaced. Core1 only, it reads its own copy of the segment table.
+ */
+ZX_BYTE __scratch_x("snoop_watched_zx_mirror_byte") snoop_watched_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value )
+{
+  const ZX_BYTE old_value = zx_mirror_core1_segments[offset >> ZX_SEGMENT_SHIFT][offset & ZX_SEGMENT_MASK];
+
+  snoop_zx_mirror_byte( offset, value );
+
+  return old_value;
+}
+
+uint32_t query_zx_mirror_snoop_seq( void )
+{
+  return zx_mirror_snoop_seq;
+}
+
+/*
+ * Has core1 mirrored a write to the trigger's high byte since the sequence
+ * number was since_seq? Signed difference, so the wrap doesn't matter. This
+ * is for core0 to catch a trigger write it was too busy to see on the bus.
+ */
+bool has_zx_mirror_snooped_trigger( const uint32_t since_seq )
+{
+  if( (int32_t)(zx_mirror_trigger_seq - since_seq) <= 0 )
+    return false;
+
+  __dmb();
+  return true;
+}
+
+/*
+ * Wait for core1 to mirror a write to the trigger's high byte which it hadn't
+ * got to when the sequence number was since_seq. Returns false if it doesn't
+ * happen inside the timeout, which means core1 isn't keeping up.
  */
-static uint8_t zx_memory_mirror[ZX_MEMORY_SIZE];
+bool wait_for_zx_mirror_trigger_snoop( const uint32_t since_seq, const uint32_t timeout_us )
+{
+  const uint32_t start_us = time_us_32();
+
+  while( !has_zx_mirror_snooped_trigger( since_seq ) )
+  {
+    if( (time_us_32() - start_us) > timeout_us )
+      return false;
+  }
 
-inline uint8_t get_zx_mirror_byte( ZX_ADDR offset )
+  return true;
+}
+
+/*
+ * Copy a block out of the mirror. Unlike going through query_zx_mirror_ptr(),
+ * this wraps round from 0xFFFF to 0x0000 the way the Z80 does, so a structure
+ * right at the top of memory doesn't read past the end of the mirror.
+ */
+void copy_from_zx_mirror( void *dest, const ZX_ADDR addr, const uint32_t length )
 {
-  return zx_memory_mirror[offset];
+  uint8_t *dest_bytes = (uint8_t*)dest;
+
+  for( uint32_t i=0; i < length; i++ )
+  {
+    dest_bytes[i] = get_zx_mirror_byte( (ZX_ADDR)(addr+i) );
+  }
 }
 
-inline void put_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value )
+/*
+ * Collect the dirty flags which are set into the bitmaps in dirty_set, and
+ * clear them. Only the flags which are found set are cleared, one byte at a
+ * time, so core1 can carry on setting flags while this runs. The flags are
+ * scanned a word at a time, so a clean mirror costs very little.
+ *
+ * Returns the number of dirty 256 byte pages.
+ */
+uint32_t fetch_and_clear_zx_dirty_set( ZX_DIRTY_SET *dirty_set )
 {
-  zx_memory_mirror[offset] = value;
+  uint32_t num_dirty_pages = 0;
+
+  for( uint32_t i=0; i < ZX_DIRTY_PAGE_WORDS; i++ )
+    dirty_set->pages[i] = 0;
+
+  for( uint32_t i=0; i < ZX_DIRTY_SCREEN_WORDS; i++ )
+    dirty_set->screen_cells[i] = 0;
+
+  const volatile uint32_t *page_words = (const volatile uint32_t*)zx_dirty_pages;
+  for( uint32_t word=0; word < ZX_MIRROR_NUM_PAGES/4; word++ )
+  {
+    if( page_words[word] == 0 )
+      continue;
+
+    for( uint32_t page=word*4; page < (word+1)*4; page++ )
+    {
+      if( zx_dirty_pages[page] )
+      {
+        zx_dirty_pages[page] = 0;
+        dirty_set->pages[page/32] |= (1u << (page%32));
+        num_dirty_pages++;
+      }
+    }
+  }
+
+  const volatile uint32_t *cell_words = (const volatile uint32_t*)zx_dirty_screen_cells;
+  for( uint32_t word=0; word < ZX_MIRROR_NUM_SCREEN_CELLS_ALIGNED/4; word++ )
+  {
+    if( cell_words[word] == 0 )
+      continue;
+
+    for( uint32_t cell=word*4; cell < (word+1)*4; cell++ )
+    {
+      if( zx_dirty_screen_cells[cell] )
+      {
+        zx_dirty_screen_cells[cell] = 0;
+        dirty_set->screen_cells[cell/32] |= (1u << (cell%32));
+      }
+    }
+  }
+
+  return num_dirty_pages;
 }
 
+/*
+ * Pointer into the mirror for the given Z80 address. It's only contiguous up
+ * to the end of the 16K segment the address is in, the next segment might be
+ * somewhere else if a 128K has paged.
+ */
 const void *query_zx_mirror_ptr( const ZX_ADDR addr )
 {
-  return &zx_memory_mirror[addr];
+  return &zx_mirror_segments[addr >> ZX_SEGMENT_SHIFT][addr & ZX_SEGMENT_MASK];
+}
+
+/*
+ * Pointer to one of the 128K RAM banks in the mirror, paged in or not.
+ */
+const void *query_zx_mirror_bank_ptr( const uint8_t bank )
+{
+  return zx_mirror_banks[bank & ZX_PAGING_RAM_BANK_MASK];
+}
+
+/*
+ * The mirror's own 16K for the ROM area, and the means to point writes into
+ * the ROM area somewhere else. Both are for the shadow ROM, which serves the
+ * Z80's ROM reads from writable images; see zx_memory_management.c.
+ */
+uint8_t *query_zx_mirror_rom_area( void )
+{
+  return &zx_memory_mirror[0];
+}
+
+void set_zx_mirror_rom_segment( uint8_t *segment )
+{
+  set_zx_mirror_segment( 0, segment );
+}
+
+/*
+ * Switch the 128K paging latch tracking on or off. This has to be done before
+ * core1 starts snooping.
+ */
+void enable_zx_mirror_paging( const bool enable )
+{
+  zx_paging_enabled = enable;
+  reset_zx_mirror_paging();
+}
+
+/*
+ * Back to the power on state, bank 0 at 0xC000, ROM 0, latch unlocked.
+ */
+void reset_zx_mirror_paging( void )
+{
+  zx_paging_latch       = 0;
+  set_zx_mirror_segment( 3, zx_mirror_banks[0] );
+  set_paged_ram_bank( 0 );
+}
+
+/*
+ * Core1 has seen an OUT. The ULA is at any even port. The 128K's paging latch
+ * is only partially decoded, A15 and A1 low. Writes to the latch once it's been
+ * locked are ignored by the hardware until the next reset, so they're ignored
+ * here too.
+ *
+ * When a different bank is paged in at 0xC000 everything up there has, as far
+ * as anyone looking at the mirror by Z80 address is concerned, changed. So all
+ * of it is marked dirty.
+ */
+void __scratch_x("snoop_zx_port_write") snoop_zx_port_write( const uint16_t port, const ZX_BYTE value )
+{
+  if( (port & 0x0001) == 0 )
+    zx_ula_port = value;
+
+  if( !zx_paging_enabled || (port & 0x8002) != 0 || (zx_paging_latch & ZX_PAGING_LOCKED) )
+    return;
+
+  const uint8_t old_bank = zx_paging_latch & ZX_PAGING_RAM_BANK_MASK;
+  const uint8_t new_bank = value & ZX_PAGING_RAM_BANK_MASK;
+
+  zx_paging_latch = value;
+
+  if( new_bank != old_bank )
+  {
+    set_zx_mirror_segment( 3, zx_mirror_banks[new_bank] );
+    set_paged_ram_bank( new_bank );
+
+    for( uint32_t page=(0xC000 >> ZX_MIRROR_PAGE_SHIFT); page < ZX_MIRROR_NUM_PAGES; page++ )
+      zx_dirty_pages[page] = 1;
+  }
+}
+
+uint8_t query_zx_paging_latch( void )
+{
+  return zx_paging_latch;
+}
+
+/*
+ * Last value written to the ULA's port. Border colour in bits 0-2, MIC in
+ * bit 3 and the beeper (EAR) in bit 4.
+ */
+uint8_t query_zx_ula_port( void )
+{
+  return zx_ula_port;
 }
 
 void initialise_zx_mirror( void )
@@ -51,5 +452,21 @@ void initialise_zx_mirror( void )
     zx_memory_mirror[i]=0;
   }
 
+  for( uint32_t bank=0; bank < ZX_NUM_RAM_BANKS-3; bank++ )
+  {
+    for( uint32_t i=0; i < ZX_SEGMENT_SIZE; i++ )
+      zx_mirror_other_banks[bank][i]=0;
+  }
+
+  for( uint32_t i=0; i < ZX_MIRROR_NUM_PAGES; i++ )
+  {
+    zx_dirty_pages[i]=0;
+  }
+
+  for( uint32_t i=0; i < ZX_MIRROR_NUM_SCREEN_CELLS_ALIGNED; i++ )
+  {
+    zx_dirty_screen_cells[i]=0;
+  }
+
   return;
 }
@@ -21,14 +21,99 @@
 #define __ZX_MIRROR_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "zx_copro.h"
 
 #define ZX_MEMORY_SIZE           ((uint32_t)65536)
 
+/* Screen memory, pixels and attributes */
+#define ZX_SCREEN_START          ((uint32_t)0x4000)
+#define ZX_SCREEN_LENGTH         ((uint32_t)6912)
+
+/*
+ * 128K memory banking. The mirror holds all 8 RAM banks. The 64K the Z80 can
+ * see is made of 16K segments: the ROM, then banks 5 and 2, then whichever
+ * bank the paging latch (port 0x7FFD) has put at 0xC000. On a 48K that's
+ * always bank 0, which is just the top 16K of its RAM.
+ */
+#define ZX_SEGMENT_SHIFT         14
+#define ZX_SEGMENT_SIZE          ((uint32_t)1 << ZX_SEGMENT_SHIFT)
+#define ZX_SEGMENT_MASK          (ZX_SEGMENT_SIZE-1)
+#define ZX_NUM_RAM_BANKS         8
+
+/* Port 0x7FFD paging latch bits */
+#define ZX_PAGING_RAM_BANK_MASK  0x07
+#define ZX_PAGING_SHADOW_SCREEN  0x08
+#define ZX_PAGING_ROM_SELECT     0x10
+#define ZX_PAGING_LOCKED         0x20
+
+/* Dirty tracking granularity, 256 byte pages, with 32 byte cells for the screen */
+#define ZX_MIRROR_PAGE_SHIFT               8
+#define ZX_MIRROR_NUM_PAGES                (ZX_MEMORY_SIZE >> ZX_MIRROR_PAGE_SHIFT)
+#define ZX_MIRROR_SCREEN_CELL_SHIFT        5
+#define ZX_MIRROR_NUM_SCREEN_CELLS         (ZX_SCREEN_LENGTH >> ZX_MIRROR_SCREEN_CELL_SHIFT)
+#define ZX_MIRROR_NUM_SCREEN_CELLS_ALIGNED ((ZX_MIRROR_NUM_SCREEN_CELLS+3) & ~3)
+
+#define ZX_DIRTY_PAGE_WORDS      ((ZX_MIRROR_NUM_PAGES+31)/32)
+#define ZX_DIRTY_SCREEN_WORDS    ((ZX_MIRROR_NUM_SCREEN_CELLS+31)/32)
+
+/*
+ * The set of mirror pages written since the last fetch. Bit n of pages[] is
+ * the 256 byte page at n*256. Bit n of screen_cells[] is the 32 bytes at
+ * 0x4000+n*32.
+ */
+typedef struct _zx_dirty_set
+{
+  uint32_t pages[ZX_DIRTY_PAGE_WORDS];
+  uint32_t screen_cells[ZX_DIRTY_SCREEN_WORDS];
+}
+ZX_DIRTY_SET;
+
+/* Where each 16K segment of the Z80's address space is in the mirror, see zx_mirror.c */
+extern uint8_t * volatile zx_mirror_segments[4];
+
+/*
+ * Read a byte from the mirror. This is inline so core0's loops over the mirror
+ * don't make a call for every byte. It's core0's, core1 has its own copy of
+ * the segment table in scratch X and reads the mirror through that.
+ */
+static inline uint8_t get_zx_mirror_byte( const ZX_ADDR offset )
+{
+  return zx_mirror_segments[offset >> ZX_SEGMENT_SHIFT][offset & ZX_SEGMENT_MASK];
+}
+
+/*
+ * Write a byte into the mirror without marking it dirty. This is for the DMA
+ * write loops, which run to NOP-counted bus timings and can only afford the
+ * store. They call mark_zx_mirror_dirty() for the whole block afterwards.
+ */
+static inline void store_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value )
+{
+  zx_mirror_segments[offset >> ZX_SEGMENT_SHIFT][offset & ZX_SEGMENT_MASK] = value;
+}
+
 void initialise_zx_mirror( void );
-uint8_t get_zx_mirror_byte( const ZX_ADDR offset );
 void put_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value );
+void mark_zx_mirror_dirty( const ZX_ADDR addr, const uint32_t length );
 
 const void *query_zx_mirror_ptr( const ZX_ADDR addr );
+void copy_from_zx_mirror( void *dest, const ZX_ADDR addr, const uint32_t length );
+
+void snoop_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value );
+ZX_BYTE snoop_watched_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value );
+uint32_t query_zx_mirror_snoop_seq( void );
+bool has_zx_mirror_snooped_trigger( const uint32_t since_seq );
+bool wait_for_zx_mirror_trigger_snoop( const uint32_t since_seq, const uint32_t timeout_us );
+
+uint32_t fetch_and_clear_zx_dirty_set( ZX_DIRTY_SET *dirty_set );
+
+void enable_zx_mirror_paging( const bool enable );
+void reset_zx_mirror_paging( void );
+void snoop_zx_port_write( const uint16_t port, const ZX_BYTE value );
+uint8_t query_zx_paging_latch( void );
+uint8_t query_zx_ula_port( void );
+const void *query_zx_mirror_bank_ptr( const uint8_t bank );
+uint8_t *query_zx_mirror_rom_area( void );
+void set_zx_mirror_rom_segment( uint8_t *segment );
 
 #endif
@@ -0,0 +1,110 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hardware/timer.h"
+
+#include "zx_mirror_sync.h"
+#include "zx_mirror.h"
+#include "zx_memory_management.h"
+#include "dma_engine.h"
+
+inline uint32_t using_mirror_scrubber( void )
+{
+#define USE_MIRROR_SCRUBBER 0
+  return USE_MIRROR_SCRUBBER;
+}
+
+static MIRROR_SYNC_STATS mirror_sync_stats;
+
+/* Where the scrubber's next chunk comes from, and when it last ran */
+static uint32_t scrub_addr    = MIRROR_SYNC_START;
+static uint32_t last_scrub_us = 0;
+
+/*
+ * Read a chunk of RAM from the Spectrum, which corrects the mirror as it
+ * goes. Returns the number of bytes which were wrong.
+ */
+static uint32_t sync_zx_mirror_chunk( const uint32_t zx_addr, const uint32_t length )
+{
+  uint8_t  buffer[MAX_DMA_READ_LENGTH];
+  uint32_t corrections = 0;
+
+  if( dma_read_block( buffer, (ZX_ADDR)zx_addr, length, true, &corrections ) != DMA_STATUS_OK )
+    return 0;
+
+  return corrections;
+}
+
+/*
+ * Read the whole of the Spectrum's RAM into the mirror. Done once, when the
+ * Z80 has just been let go. It's done in small chunks so each bus request
+ * fits between interrupts, which is slow (something like 100ms) but the Z80
+ * is only running the ROM's start up at that point. Anything the Z80 writes
+ * while this is going on gets mirrored by core1 as normal; the read for each
+ * chunk corrects the mirror while the bus is held, so the two don't race.
+ */
+void bootstrap_zx_mirror( void )
+{
+  for( uint32_t zx_addr=MIRROR_SYNC_START; zx_addr < ZX_MEMORY_SIZE; zx_addr += MAX_DMA_READ_LENGTH )
+  {
+    uint32_t length = MAX_DMA_READ_LENGTH;
+    if( zx_addr + length > ZX_MEMORY_SIZE )
+      length = ZX_MEMORY_SIZE - zx_addr;
+
+    mirror_sync_stats.bootstrap_corrections += sync_zx_mirror_chunk( zx_addr, length );
+  }
+
+  last_scrub_us = time_us_32();
+}
+
+/*
+ * Background check of the mirror against the real RAM, one small chunk at a
+ * time. It only runs while the Z80 is halted, when a bus request costs the
+ * Spectrum nothing, and not more often than MIRROR_SCRUB_INTERVAL_US. On a
+ * 128K it checks whichever bank is paged in at the time.
+ */
+void scrub_zx_mirror_step( void )
+{
+  if( !is_z80_halted() )
+    return;
+
+  const uint32_t now_us = time_us_32();
+  if( (now_us - last_scrub_us) < MIRROR_SCRUB_INTERVAL_US )
+    return;
+
+  uint32_t length = MAX_DMA_READ_LENGTH;
+  if( scrub_addr + length > ZX_MEMORY_SIZE )
+    length = ZX_MEMORY_SIZE - scrub_addr;
+
+  mirror_sync_stats.scrub_corrections += sync_zx_mirror_chunk( scrub_addr, length );
+
+  scrub_addr += length;
+  if( scrub_addr >= ZX_MEMORY_SIZE )
+  {
+    scrub_addr = MIRROR_SYNC_START;
+    mirror_sync_stats.scrub_passes++;
+  }
+
+  last_scrub_us = time_us_32();
+}
+
+const MIRROR_SYNC_STATS *query_mirror_sync_stats( void )
+{
+  return &mirror_sync_stats;
+}
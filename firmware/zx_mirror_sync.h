@@ -0,0 +1,52 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __ZX_MIRROR_SYNC_H
+#define __ZX_MIRROR_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zx_copro.h"
+
+/*
+ * Keeping the mirror honest. The mirror only knows about writes core1 has
+ * seen. Anything in the Spectrum's RAM from before that (or anything core1
+ * missed) is only found by reading the RAM itself.
+ */
+#define MIRROR_SYNC_START          ((ZX_ADDR)0x4000)
+
+/* The scrubber reads one chunk this often, at most, and only while the Z80 is halted */
+#define MIRROR_SCRUB_INTERVAL_US   ((uint32_t)1000)
+
+typedef struct _mirror_sync_stats
+{
+  uint32_t bootstrap_corrections;   // Bytes which differed when the mirror was first read in
+  uint32_t scrub_corrections;       // Bytes the scrubber has found wrong since
+  uint32_t scrub_passes;            // Complete passes over RAM the scrubber has made
+}
+MIRROR_SYNC_STATS;
+
+uint32_t using_mirror_scrubber( void );
+
+void bootstrap_zx_mirror( void );
+void scrub_zx_mirror_step( void );
+
+const MIRROR_SYNC_STATS *query_mirror_sync_stats( void );
+
+#endif
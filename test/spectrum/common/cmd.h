@@ -11,6 +11,14 @@ typedef enum
   ZXCOPRO_PXY2SADDR,
 
   ZXCOPRO_MEMSET_LARGE,          // FIXME Still not sure if commands which run on /int should be separate or flagged
+
+  ZXCOPRO_INT_STATS,             // Fetch the missed interrupt statistics
+  ZXCOPRO_ADD_WATCH,             // Run a command when the Z80 writes to an address range
+  ZXCOPRO_REMOVE_WATCH,
+  ZXCOPRO_PAGE_SHADOW_ROM,       // Page one of the writable 16K images in at 0x0000
+  ZXCOPRO_SELECT_ROM_BANK,       // Switch the emulated ROM to a different bank of images
+  ZXCOPRO_FETCH_WRITE_LOG,       // Drain the oldest entries out of the write log
+  ZXCOPRO_SNAPSHOT,              // Make a .SNA or .Z80 snapshot from the mirror
 }
 ZXCOPRO_CMD;
 
@@ -83,4 +91,160 @@ ZXCOPRO_PXY2SADDR, 0,      /* CMD type and flags */	   \
 #define PXY2SADDR_QUERY_ANSWER(NAME)    (*(uint16_t*)&NAME[6])
 
 
+
+/* Initialise structure for an int_stats */
+#define INT_STATS_INIT(NAME) static uint8_t NAME[] =	   \
+{                                                          \
+ZXCOPRO_INT_STATS, 0,      /* CMD type and flags */	   \
+0, 0,                      /* Status and error */	   \
+                                                           \
+0, 0,                      /* int count */                 \
+0, 0,                      /* missed count */              \
+0, 0,                      /* overlap count */             \
+0,                         /* last missed DMA mode */      \
+0, 0,                      /* last missed DMA length */    \
+}
+
+#define INT_STATS_QUERY_INT_COUNT(NAME)     (*(uint16_t*)&NAME[4])
+#define INT_STATS_QUERY_MISSED(NAME)        (*(uint16_t*)&NAME[6])
+#define INT_STATS_QUERY_OVERLAPPED(NAME)    (*(uint16_t*)&NAME[8])
+#define INT_STATS_QUERY_LAST_MODE(NAME)     (NAME[10])
+#define INT_STATS_QUERY_LAST_LENGTH(NAME)   (*(uint16_t*)&NAME[11])
+
+
+
+/* Write watch match rules */
+#define WATCH_MATCH_ANY      0
+#define WATCH_MATCH_VALUE    1
+#define WATCH_MATCH_CHANGED  2
+
+/* Initialise structure for an add_watch */
+#define ADD_WATCH_INIT(NAME) static uint8_t NAME[] =	   \
+{                                                          \
+ZXCOPRO_ADD_WATCH, 0,      /* CMD type and flags */	   \
+0, 0,                      /* Status and error */	   \
+                                                           \
+0, 0,                      /* start address */             \
+0, 0,                      /* end address */               \
+WATCH_MATCH_ANY, 0,        /* match rule and value */      \
+0, 0,                      /* command to run */            \
+0,                         /* watch id */                  \
+}
+
+#define ADD_WATCH_SET_RANGE(NAME,START,END) NAME[4] = START & 0xFF;      \
+                                            NAME[5] = (START>>8) & 0xFF; \
+                                            NAME[6] = END & 0xFF;        \
+                                            NAME[7] = (END>>8) & 0xFF
+#define ADD_WATCH_SET_MATCH(NAME,RULE,VAL)  NAME[8] = RULE;              \
+                                            NAME[9] = VAL
+#define ADD_WATCH_SET_CMD(NAME,CMD)         NAME[10] = (uint16_t)CMD & 0xFF; \
+                                            NAME[11] = ((uint16_t)CMD>>8) & 0xFF
+#define ADD_WATCH_QUERY_ID(NAME)            (NAME[12])
+
+/* Initialise structure for a remove_watch */
+#define REMOVE_WATCH_INIT(NAME) static uint8_t NAME[] =   \
+{                                                          \
+ZXCOPRO_REMOVE_WATCH, 0,   /* CMD type and flags */	   \
+0, 0,                      /* Status and error */	   \
+                                                           \
+0,                         /* watch id */                  \
+}
+
+#define REMOVE_WATCH_SET_ID(NAME,ID)        NAME[4] = ID
+
+/* Initialise structure for a page_shadow_rom */
+#define PAGE_SHADOW_ROM_INIT(NAME) static uint8_t NAME[] = \
+{                                                          \
+ZXCOPRO_PAGE_SHADOW_ROM, 0, /* CMD type and flags */      \
+0, 0,                      /* Status and error */	   \
+                                                           \
+0,                         /* image */                     \
+0,                         /* previous image */            \
+}
+
+#define PAGE_SHADOW_ROM_SET_IMAGE(NAME,IMAGE)  NAME[4] = IMAGE
+#define PAGE_SHADOW_ROM_QUERY_PREVIOUS(NAME)   (NAME[5])
+
+/* Initialise structure for a select_rom_bank */
+#define SELECT_ROM_BANK_INIT(NAME) static uint8_t NAME[] = \
+{                                                          \
+ZXCOPRO_SELECT_ROM_BANK, 0, /* CMD type and flags */      \
+0, 0,                      /* Status and error */	   \
+                                                           \
+0,                         /* bank */                      \
+0,                         /* reset */                     \
+0,                         /* previous bank */             \
+}
+
+#define SELECT_ROM_BANK_SET_BANK(NAME,BANK)    NAME[4] = BANK
+#define SELECT_ROM_BANK_SET_RESET(NAME,RESET)  NAME[5] = RESET
+#define SELECT_ROM_BANK_QUERY_PREVIOUS(NAME)   (NAME[6])
+
+
+
+/* Snapshot formats */
+#define SNAPSHOT_FORMAT_SNA  0
+#define SNAPSHOT_FORMAT_Z80  1
+
+/*
+ * Saved registers for a snapshot, the layout the coprocessor expects. 16 bit
+ * values are little endian: AF BC DE HL AF' BC' DE' HL' IX IY SP PC, then
+ * I R IFF1 IFF2 IM.
+ */
+#define SNAPSHOT_REGS_SIZE   29
+
+/* Initialise structure for a snapshot */
+#define SNAPSHOT_INIT(NAME) static uint8_t NAME[] =        \
+{                                                          \
+ZXCOPRO_SNAPSHOT, 0,       /* CMD type and flags */        \
+0, 0,                      /* Status and error */          \
+                                                           \
+SNAPSHOT_FORMAT_SNA,       /* format */                    \
+0, 0,                      /* saved registers */           \
+0, 0, 0, 0,                /* snapshot length */           \
+0, 0, 0, 0,                /* Adler-32 of the snapshot */  \
+}
+
+#define SNAPSHOT_SET_FORMAT(NAME,FORMAT)  NAME[4] = FORMAT
+#define SNAPSHOT_SET_REGS(NAME,REGS)      NAME[5] = (uint16_t)REGS & 0xFF; \
+                                          NAME[6] = ((uint16_t)REGS>>8) & 0xFF
+#define SNAPSHOT_QUERY_LENGTH(NAME)       (*(uint32_t*)&NAME[7])
+#define SNAPSHOT_QUERY_CHECKSUM(NAME)     (*(uint32_t*)&NAME[11])
+
+
+
+/*
+ * Coprocessor I/O registers, read with IN and written with OUT, no command
+ * structure needed. The register number goes in the port's high byte.
+ * These need z80.h.
+ */
+#define ZXCOPRO_IO_PORT        0x7F     // Has to match the port the firmware registers
+#define ZXCOPRO_IO_ID          0x5A
+
+#define IO_REG_ID              0x00
+#define IO_REG_VERSION         0x01
+#define IO_REG_SADDR_LO        0x02
+#define IO_REG_SADDR_HI        0x03
+#define IO_REG_CMD_STATUS      0x10
+#define IO_REG_CMD_ERROR       0x11
+#define IO_REG_PXY_X           0x12
+#define IO_REG_PXY_Y           0x13
+#define IO_REG_USER            0x80
+
+#define IO_REG_PORT(REG)       (((uint16_t)(REG) << 8) | ZXCOPRO_IO_PORT)
+#define IO_REG_READ(REG)       z80_inp( IO_REG_PORT(REG) )
+#define IO_REG_WRITE(REG,VAL)  z80_outp( IO_REG_PORT(REG), VAL )
+
+#define IO_IS_COPRO_PRESENT()  (IO_REG_READ(IO_REG_ID) == ZXCOPRO_IO_ID)
+
+/* Clear the status before triggering a command, then it can be spun on with IN */
+#define IO_CMD_CLEAR_STATUS()  IO_REG_WRITE(IO_REG_CMD_STATUS,ZXCOPRO_NONE)
+#define IO_CMD_SPIN_ON_STATUS() while( IO_REG_READ(IO_REG_CMD_STATUS) == ZXCOPRO_NONE )
+
+#define IO_PXY2SADDR_SET(X,Y)        IO_REG_WRITE(IO_REG_PXY_X,X); \
+                                     IO_REG_WRITE(IO_REG_PXY_Y,Y)
+#define IO_PXY2SADDR_QUERY_ANSWER()  (IO_REG_READ(IO_REG_SADDR_LO) | \
+                                      ((uint16_t)IO_REG_READ(IO_REG_SADDR_HI) << 8))
+
+
 #endif
@@ -11,6 +11,7 @@ typedef enum
   DMA_STATUS_TOP_BORDER_TOO_BIG,         // Number of bytes to DMA in top border time is too large
   DMA_STATUS_BAD_INCR,                   // An increment value is way out
   DMA_STATUS_CONTENTION_FAIL,            // DMA would clash with ULA's contention
+  DMA_STATUS_TOO_MANY_IO_CYCLES,         // Number of I/O cycles is too large
 
   DMA_STATUS_LAST
 }
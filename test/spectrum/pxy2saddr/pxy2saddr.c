@@ -81,6 +81,11 @@ void main(void)
 	}
 
 	uint16_t answer = PXY2SADDR_QUERY_ANSWER( pxy2saddr_cmd );
+#elif 0
+	/* Through the I/O registers, no DMA at all */
+	IO_PXY2SADDR_SET( x, y );
+
+	uint16_t answer = IO_PXY2SADDR_QUERY_ANSWER();
 #else
 	/* Takes about 3.4 secs to fill the screen */
 	uint16_t answer = (uint16_t)zx_pxy2saddr( x, y );
@@ -0,0 +1,105 @@
+/*
+ * zcc +zx -vn -startup=4 -clib=sdcc_iy snapshot.c ../common/cmd.c -o z80_image
+ * xxd -i -c 16 z80_image_CODE.bin > ../../../firmware/z80_image.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <z80.h>
+#include <intrinsic.h>
+#include <arch/zx.h>
+
+#include "../common/cmd.h"
+
+/* Filled by capture_registers(), in the layout the coprocessor wants */
+uint8_t saved_regs[SNAPSHOT_REGS_SIZE];
+
+/*
+ * Register capture stub. Saves every register into saved_regs and comes back
+ * with them all as they were. The PC saved is the return address and the SP
+ * is the one after the return, so a loaded snapshot carries on as if this had
+ * just returned. IFF1 is taken to be IFF2, which it is outside an NMI. The IM
+ * can't be read, it's 1 under BASIC.
+ */
+void capture_registers(void) __naked
+{
+  __asm
+    ld (_saved_regs+2),bc
+    ld (_saved_regs+4),de
+    ld (_saved_regs+6),hl
+    ld (_saved_regs+16),ix
+    ld (_saved_regs+18),iy
+
+    push af
+    pop hl
+    ld (_saved_regs+0),hl
+
+    exx
+    ld (_saved_regs+10),bc
+    ld (_saved_regs+12),de
+    ld (_saved_regs+14),hl
+    exx
+
+    ex af,af'
+    push af
+    pop hl
+    ld (_saved_regs+8),hl
+    ex af,af'
+
+    pop hl
+    ld (_saved_regs+22),hl
+    ld (_saved_regs+20),sp
+    push hl
+
+    ld a,r
+    ld (_saved_regs+25),a
+    ld a,i
+    ld (_saved_regs+24),a
+    ld a,0
+    jp po,capture_no_ints
+    inc a
+capture_no_ints:
+    ld (_saved_regs+26),a
+    ld (_saved_regs+27),a
+    ld a,1
+    ld (_saved_regs+28),a
+
+    ld hl,(_saved_regs+0)
+    push hl
+    pop af
+    ld hl,(_saved_regs+6)
+    ret
+  __endasm;
+}
+
+void main(void)
+{
+  SNAPSHOT_INIT(snapshot_cmd);
+
+  ioctl(1, IOCTL_OTERM_PAUSE, 0);
+
+  SNAPSHOT_SET_FORMAT(snapshot_cmd,SNAPSHOT_FORMAT_Z80);
+  SNAPSHOT_SET_REGS(snapshot_cmd,saved_regs);
+
+  /* A snapshot of this loads back to here, and makes another */
+  capture_registers();
+
+  CMD_CLEAR_STATUS(snapshot_cmd);
+  CMD_CLEAR_ERROR(snapshot_cmd);
+
+  CMD_TRIGGER_IMMEDIATE_CMD( snapshot_cmd );
+  CMD_SPIN_ON_STATUS( snapshot_cmd );
+
+  if( CMD_IS_COPRO_ERROR( snapshot_cmd ) )
+  {
+    printf("Error is %d\n", CMD_QUERY_COPRO_ERROR( snapshot_cmd ));
+    while(1);
+  }
+
+  printf("PC %04X SP %04X\n", *(uint16_t*)&saved_regs[22], *(uint16_t*)&saved_regs[20]);
+  printf("Snapshot %lu bytes, Adler-32 %08lX\n",
+         SNAPSHOT_QUERY_LENGTH(snapshot_cmd), SNAPSHOT_QUERY_CHECKSUM(snapshot_cmd));
+
+  while(1);
+}
@@ -0,0 +1,152 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Pretend Spectrum bus, see bus_host.h.
+ */
+
+#include <string.h>
+
+#include "pico.h"
+
+#include "bus_host.h"
+#include "gpios.h"
+#include "zx_mirror.h"
+#include "dma_engine.h"
+#include "int_monitor.h"
+#include "trace_table.h"
+#include "pio_rom_server.h"
+#include "zx_memory_management.h"
+
+uint8_t  host_zx_ram[65536];
+uint8_t  host_zx_mirror[65536];
+
+uint32_t host_bus_writes;
+ZX_ADDR  host_dirty_addr;
+uint32_t host_dirty_length;
+
+pio_hw_t host_pio0;
+
+/* GPIO output levels, one bit per pin */
+static uint64_t gpio_levels = 0;
+static bool     z80_clk     = false;
+
+static bool level( const uint gpio )
+{
+  return (gpio_levels >> gpio) & 1;
+}
+
+void host_reset_bus( const uint8_t ram_fill, const uint8_t mirror_fill )
+{
+  memset( host_zx_ram,    ram_fill,    sizeof(host_zx_ram) );
+  memset( host_zx_mirror, mirror_fill, sizeof(host_zx_mirror) );
+
+  /* Everything inactive, the Z80 has the bus */
+  gpio_levels = ((uint64_t)1 << GPIO_Z80_BUSREQ) | ((uint64_t)1 << GPIO_Z80_MREQ) |
+                ((uint64_t)1 << GPIO_Z80_WR)     | ((uint64_t)1 << GPIO_Z80_RD)   |
+                ((uint64_t)1 << GPIO_Z80_IORQ);
+
+  host_bus_writes   = 0;
+  host_dirty_addr   = 0;
+  host_dirty_length = 0;
+}
+
+bool gpio_get( uint gpio )
+{
+  if( gpio == GPIO_Z80_CLK )
+  {
+    z80_clk = !z80_clk;
+    return z80_clk;
+  }
+
+  if( gpio == GPIO_Z80_BUSACK )
+    return level( GPIO_Z80_BUSREQ );
+
+  return level( gpio );
+}
+
+uint64_t gpio_get_all64( void )
+{
+  return gpio_levels;
+}
+
+void gpio_put( uint gpio, bool value )
+{
+  const bool wr_falls = (gpio == GPIO_Z80_WR) && level( GPIO_Z80_WR ) && !value;
+
+  if( value )
+    gpio_levels |=  ((uint64_t)1 << gpio);
+  else
+    gpio_levels &= ~((uint64_t)1 << gpio);
+
+  if( wr_falls && !level( GPIO_Z80_MREQ ) )
+  {
+    const ZX_ADDR zx_addr = (gpio_levels & GPIO_ABUS_BITMASK) >> GPIO_ABUS_A0;
+    host_zx_ram[zx_addr]  = (gpio_levels & GPIO_DBUS_BITMASK) >> GPIO_DBUS_D0;
+    host_bus_writes++;
+  }
+}
+
+void gpio_put_masked( uint32_t mask, uint32_t value )
+{
+  gpio_levels = (gpio_levels & ~(uint64_t)mask) | (value & mask);
+}
+
+void gpio_set_dir( uint gpio, bool out )                              {}
+void gpio_set_dir_in_masked( uint32_t mask )                          {}
+void gpio_set_dir_out_masked( uint32_t mask )                         {}
+void gpio_set_function_masked( uint32_t mask, gpio_function_t func )  {}
+
+uint32_t time_us_32( void )
+{
+  return 0;
+}
+
+/*
+ * The mirror, straight through to its own 64K.
+ */
+uint8_t * volatile zx_mirror_segments[4] = { &host_zx_mirror[0x0000], &host_zx_mirror[0x4000],
+                                             &host_zx_mirror[0x8000], &host_zx_mirror[0xC000] };
+
+void put_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value )
+{
+  host_zx_mirror[offset] = value;
+}
+
+void mark_zx_mirror_dirty( const ZX_ADDR addr, const uint32_t length )
+{
+  host_dirty_addr   = addr;
+  host_dirty_length = length;
+}
+
+/*
+ * Nothing else the DMA engine calls has anything to do on the host.
+ */
+void int_monitor_start_dma( void )                                                         {}
+void int_monitor_check_dma( const DMA_MODE mode, const uint32_t length )                   {}
+void trace_table_new_entry( void )                                                         {}
+void trace_table_set_dma_args( const uint8_t *src, const ZX_ADDR zx_addr, const uint32_t length ) {}
+void trace_table_set_dma_mode( const DMA_MODE dma_mode )                                   {}
+void pio_rom_server_release_dbus( void )                                                   {}
+void pio_rom_server_reclaim_dbus( void )                                                   {}
+
+uint32_t is_z80_halted( void )
+{
+  return 0;
+}
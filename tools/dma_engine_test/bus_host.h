@@ -0,0 +1,52 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * A pretend Spectrum bus for running the firmware's DMA engine on the host.
+ *
+ * The GPIOs the DMA engine drives are kept as levels. The Z80 clock ticks
+ * each time it's read, and /BUSACK follows /BUSREQ. A memory write is taken
+ * off the address and data lines when /WR falls with /MREQ low, which is
+ * when the ULA or the RAS/CAS logic would latch it, and goes into the
+ * pretend Spectrum's RAM. The mirror is a separate 64K, written only by the
+ * firmware's own mirror updates, so the two can be compared.
+ */
+
+#ifndef __BUS_HOST_H
+#define __BUS_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "zx_copro.h"
+
+/* What the Spectrum's RAM holds, as written over the bus */
+extern uint8_t host_zx_ram[65536];
+
+/* What the firmware's mirror holds */
+extern uint8_t host_zx_mirror[65536];
+
+/* Bus writes seen, and the range the firmware last marked dirty */
+extern uint32_t host_bus_writes;
+extern ZX_ADDR  host_dirty_addr;
+extern uint32_t host_dirty_length;
+
+void host_reset_bus( const uint8_t ram_fill, const uint8_t mirror_fill );
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Host test for dma_engine.c, see the Makefile.
+ *
+ * Blocks are DMAed over the pretend bus in each of the write modes, as
+ * memsets (no increment on the source, the way the memset command sends its
+ * one byte) and as copies. Every byte written over the bus has to be the
+ * right one, and the mirror has to hold the same, with nothing either side
+ * of the block touched.
+ *
+ * The contention check the DMA uses to pick its write mode is tried on a few
+ * ranges too, including ones which wrap past 0xFFFF, as is the int_unsafe
+ * budget for blocks with I/O cycles on the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bus_host.h"
+#include "dma_engine.h"
+#include "machine_profile.h"
+
+#define RAM_FILL     0x11
+#define MIRROR_FILL  0x22
+#define MEMSET_BYTE  0x5A
+
+/*
+ * The memset command points the DMA at its one byte inside the command
+ * snapshot. Whatever follows it there is nothing to do with the memset, so
+ * it's junk here, and plenty of it so a DMA which wrongly steps through it
+ * reads junk rather than off the end.
+ */
+#define SOURCE_LENGTH  (MAX_DMA_LENGTH*MAX_INCR/1024)
+static uint8_t source[SOURCE_LENGTH];
+
+static uint32_t failures = 0;
+
+static void fail( const char *name, const char *what, const uint32_t zx_addr, const uint32_t got, const uint32_t want )
+{
+  printf( "FAIL %s: %s at 0x%04X is 0x%02X, should be 0x%02X\n", name, what, zx_addr, got, want );
+  failures++;
+}
+
+/*
+ * DMA the block and check the Spectrum's RAM and the mirror both hold what
+ * the source says, with nothing else written.
+ */
+static void check_block( const char *name, DMA_BLOCK *block )
+{
+  host_reset_bus( RAM_FILL, MIRROR_FILL );
+
+  const DMA_STATUS status = dma_memory_block( block, false );
+  if( status != DMA_STATUS_OK )
+  {
+    printf( "FAIL %s: DMA status %d\n", name, status );
+    failures++;
+    return;
+  }
+
+  const uint32_t failures_before = failures;
+
+  for( uint32_t i=0; i < 65536 && failures-failures_before < 4; i++ )
+  {
+    const ZX_ADDR  zx_addr = (ZX_ADDR)(block->zx_ram_location+i);
+    const uint32_t want    = (i < block->length) ? block->src[i*block->incr] : 0;
+
+    if( i < block->length )
+    {
+      if( host_zx_ram[zx_addr] != want )
+        fail( name, "RAM", zx_addr, host_zx_ram[zx_addr], want );
+
+      if( host_zx_mirror[zx_addr] != want )
+        fail( name, "mirror", zx_addr, host_zx_mirror[zx_addr], want );
+    }
+    else
+    {
+      if( host_zx_ram[zx_addr] != RAM_FILL )
+        fail( name, "RAM outside the block", zx_addr, host_zx_ram[zx_addr], RAM_FILL );
+
+      if( host_zx_mirror[zx_addr] != MIRROR_FILL )
+        fail( name, "mirror outside the block", zx_addr, host_zx_mirror[zx_addr], MIRROR_FILL );
+    }
+  }
+
+  if( host_bus_writes != block->length )
+  {
+    printf( "FAIL %s: %u bus writes for %u bytes\n", name, host_bus_writes, block->length );
+    failures++;
+  }
+
+  if( host_dirty_addr != block->zx_ram_location || host_dirty_length != block->length )
+  {
+    printf( "FAIL %s: 0x%04X+%u marked dirty\n", name, host_dirty_addr, host_dirty_length );
+    failures++;
+  }
+
+  if( failures == failures_before )
+    printf( "ok   %s\n", name );
+}
+
+static void check_memset( const char *name, const ZX_ADDR zx_addr, const uint32_t length, const bool top_border_time )
+{
+  source[0] = MEMSET_BYTE;
+
+  DMA_BLOCK block = { .src = source,
+                      .zx_ram_location = zx_addr,
+                      .length = length,
+                      .incr = 0,
+                      .top_border_time = top_border_time };
+
+  check_block( name, &block );
+}
+
+static void check_copy( const char *name, const ZX_ADDR zx_addr, const uint32_t length, const uint32_t incr )
+{
+  DMA_BLOCK block = { .src = source,
+                      .zx_ram_location = zx_addr,
+                      .length = length,
+                      .incr = incr };
+
+  check_block( name, &block );
+}
+
+/*
+ * A block with I/O cycles on the end which is too long for the int_unsafe
+ * guard. It's refused when the guard is to be waited for, and run when the
+ * Z80 has said it doesn't mind about interrupts, or protection is off.
+ */
+static void check_io_budget( const char *name, const bool ignore_interrupt, const bool int_protection,
+                             const DMA_STATUS want )
+{
+  DMA_IO_CYCLE io_cycle = { .port = 0x00FE, .value = 0x07, .read = false };
+
+  DMA_BLOCK block = { .src = source,
+                      .zx_ram_location = 0x9000,
+                      .length = INT_SAFE_DMA_LENGTH,
+                      .incr = 1,
+                      .ignore_interrupt = ignore_interrupt,
+                      .io_cycles = &io_cycle,
+                      .num_io_cycles = 1 };
+
+  host_reset_bus( RAM_FILL, MIRROR_FILL );
+
+  const DMA_STATUS got = dma_memory_block( &block, int_protection );
+  if( got != want )
+  {
+    printf( "FAIL %s: DMA status %d, should be %d\n", name, got, want );
+    failures++;
+    return;
+  }
+
+  printf( "ok   %s\n", name );
+}
+
+static void check_contended( const ZX_ADDR zx_addr, const uint32_t length, const bool want )
+{
+  const bool got = zx_range_is_contended( zx_addr, length );
+
+  if( got != want )
+  {
+    printf( "FAIL contention: 0x%04X+0x%X is %s, should be %s\n", zx_addr, length,
+            got ? "contended" : "uncontended", want ? "contended" : "uncontended" );
+    failures++;
+  }
+}
+
+int main( void )
+{
+  srand( 1 );
+  for( uint32_t i=0; i < SOURCE_LENGTH; i++ )
+    source[i] = (rand() % 255) + 1;
+
+  check_memset( "memset, uncontended",            0x9000, 0x1000,  false );
+  check_memset( "memset, contended",              0x5800, 0x0300,  false );
+  check_memset( "memset, top border",             0x4000, 0x0200,  true  );
+  check_memset( "memset, into screen from ROM",   0x3F00, 0x0200,  false );
+  check_memset( "memset, wrapping into the ROM",  0xFF80, 0x0100,  false );
+  check_memset( "memset, all 64K",                0x0000, 0x10000, false );
+
+  check_copy( "copy, uncontended",                0xA000, 0x0800,  1 );
+  check_copy( "copy, contended",                  0x4000, 0x1B00,  1 );
+  check_copy( "copy, spanned source",             0xC000, 0x0400,  3 );
+  check_copy( "copy, largest increment",          0x6000, 0x0040,  MAX_INCR );
+
+  check_io_budget( "I/O cycles over the guard, refused",          false, true,  DMA_STATUS_TOO_MANY_IO_CYCLES );
+  check_io_budget( "I/O cycles over the guard, interrupts ignored", true,  true,  DMA_STATUS_OK );
+  check_io_budget( "I/O cycles over the guard, no protection",    false, false, DMA_STATUS_OK );
+
+  /* The 48K profile, which is what's selected before anything's measured */
+  const uint32_t failures_before = failures;
+  check_contended( 0x0000, 0x4000,  false );
+  check_contended( 0x3FFF, 2,       true  );
+  check_contended( 0x4000, 1,       true  );
+  check_contended( 0x7FFF, 1,       true  );
+  check_contended( 0x8000, 0x8000,  false );
+  check_contended( 0xFFFF, 2,       false );
+  check_contended( 0xC000, 0x8000,  false );
+  check_contended( 0xC000, 0x8001,  true  );
+  check_contended( 0xF000, 0x5001,  true  );
+  check_contended( 0xF000, 0x5000,  false );
+  check_contended( 0x8000, 0x10000, true  );
+  check_contended( 0x8000, 0,       false );
+  if( failures == failures_before )
+    printf( "ok   contention, with and without wrapping\n" );
+
+  printf( "%u failures\n", failures );
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,2 @@
+/* Host stand-in, see ../pico.h */
+#include "pico.h"
@@ -0,0 +1,31 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* Host stand-in for the header pioasm makes from int_unsafe.pio */
+
+#ifndef __HOST_INT_UNSAFE_PIO_H
+#define __HOST_INT_UNSAFE_PIO_H
+
+#include "pico.h"
+
+static const pio_program_t int_unsafe_program = { NULL, 0, -1 };
+
+static inline void int_unsafe_program_init( PIO pio, uint sm, uint offset, uint int_pin, uint test_pin ) {}
+
+#endif
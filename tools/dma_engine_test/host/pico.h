@@ -0,0 +1,95 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Just enough of the Pico SDK for the firmware's DMA engine to build on the
+ * host, with the GPIOs going to the pretend Spectrum bus in bus_host.c.
+ * Nothing here runs on an RP2350.
+ */
+
+#ifndef __HOST_PICO_H
+#define __HOST_PICO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#define __scratch_x(name)
+#define __scratch_y(name)
+#define __not_in_flash_func(func) func
+#define __force_inline inline __attribute__((always_inline))
+
+static inline void __dmb( void )
+{
+  __sync_synchronize();
+}
+
+/* GPIOs, see bus_host.c */
+#define GPIO_IN   false
+#define GPIO_OUT  true
+
+typedef enum { GPIO_FUNC_SIO = 5, GPIO_FUNC_PIO0 = 6, GPIO_FUNC_PIO1 = 7 } gpio_function_t;
+
+bool     gpio_get( uint gpio );
+uint64_t gpio_get_all64( void );
+void     gpio_put( uint gpio, bool value );
+void     gpio_put_masked( uint32_t mask, uint32_t value );
+void     gpio_set_dir( uint gpio, bool out );
+void     gpio_set_dir_in_masked( uint32_t mask );
+void     gpio_set_dir_out_masked( uint32_t mask );
+void     gpio_set_function_masked( uint32_t mask, gpio_function_t func );
+
+uint32_t time_us_32( void );
+
+enum { clk_sys };
+static inline uint32_t clock_get_hz( int clk ) { return 200000000; }
+
+/*
+ * The PIO and DMA channels are only set up by init_interrupt_protection(),
+ * which the host tests don't call. These let it build.
+ */
+typedef struct { volatile uint32_t rxf[4]; volatile uint32_t txf[4]; } pio_hw_t;
+typedef pio_hw_t *PIO;
+extern pio_hw_t host_pio0;
+#define pio0     (&host_pio0)
+#define pio0_hw  (&host_pio0)
+
+typedef struct { const uint16_t *instructions; uint8_t length; int8_t origin; } pio_program_t;
+
+static inline int  pio_set_gpio_base( PIO pio, uint base ) { return 0; }
+static inline int  pio_claim_unused_sm( PIO pio, bool required ) { return 0; }
+static inline uint pio_add_program( PIO pio, const pio_program_t *program ) { return 0; }
+static inline void pio_sm_set_enabled( PIO pio, uint sm, bool enabled ) {}
+
+typedef struct { uint32_t ctrl; } dma_channel_config;
+enum { DMA_SIZE_8, DMA_SIZE_16, DMA_SIZE_32 };
+enum { DREQ_PIO0_TX0, DREQ_PIO0_RX0 };
+
+static inline int  dma_claim_unused_channel( bool required ) { return 0; }
+static inline dma_channel_config dma_channel_get_default_config( uint channel ) { dma_channel_config c = {0}; return c; }
+static inline void channel_config_set_transfer_data_size( dma_channel_config *c, int size ) {}
+static inline void channel_config_set_read_increment( dma_channel_config *c, bool incr ) {}
+static inline void channel_config_set_write_increment( dma_channel_config *c, bool incr ) {}
+static inline void channel_config_set_dreq( dma_channel_config *c, uint dreq ) {}
+static inline void dma_channel_configure( uint channel, const dma_channel_config *config, volatile void *write_addr,
+                                          const volatile void *read_addr, uint32_t count, bool trigger ) {}
+
+#endif
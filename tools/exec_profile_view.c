@@ -0,0 +1,364 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Host side viewer for the firmware's execution profile.
+ *
+ * gcc -O2 -Wall -o exec_profile_view exec_profile_view.c
+ *
+ * Takes a dump of the profile, taken from the debugger with something like
+ *
+ *  dump binary value exec_profile.bin exec_profile
+ *
+ * and lists where the Z80 spent its time, busiest first. With a symbol file
+ * from the assembler the fetches are added up by label as well, each bucket
+ * going to the nearest label at or below it. Most assemblers' symbol and map
+ * files will do, anything with a label and a hex address on each line:
+ *
+ *  label: EQU 0x8000      (sjasmplus)
+ *  label = $8000 ; ...    (z88dk)
+ *  label EQU 8000H        (pasmo)
+ *
+ * Usage: exec_profile_view [-s symbols] [-n count] [-p] exec_profile.bin
+ *
+ *  -s  symbol file to put labels against the addresses
+ *  -n  how many of the busiest addresses and labels to list, default 20
+ *  -p  print the data reads and writes for each 256 byte page, busiest first
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "../firmware/exec_profile.h"
+
+#define MAX_SYMBOLS  16384
+
+typedef struct _symbol
+{
+  char     name[64];
+  uint32_t address;
+  uint64_t fetches;
+}
+SYMBOL;
+
+static SYMBOL   symbols[MAX_SYMBOLS];
+static uint32_t num_symbols = 0;
+
+static EXEC_PROFILE profile;
+
+static int read_file( const char *filename, void *buffer, const size_t length, size_t *read_length )
+{
+  FILE *f = fopen( filename, "rb" );
+  if( f == NULL )
+  {
+    perror( filename );
+    return -1;
+  }
+
+  *read_length = fread( buffer, 1, length, f );
+  fclose( f );
+
+  return 0;
+}
+
+/*
+ * A hex address in any of the usual forms, $8000, 0x8000, #8000, 8000h, or
+ * just 8000. Without a prefix it has to start with a digit, or labels like
+ * "fade" would look like addresses. Returns -1 if it isn't one.
+ */
+static long parse_address( const char *token )
+{
+  char   digits[32];
+  size_t length = strlen( token );
+
+  if( token[0] == '$' || token[0] == '#' )
+  {
+    token++;
+    length--;
+  }
+  else if( token[0] == '0' && (token[1] == 'x' || token[1] == 'X') )
+  {
+    token  += 2;
+    length -= 2;
+  }
+  else if( !isdigit( (unsigned char)token[0] ) )
+  {
+    return -1;
+  }
+  else if( token[length-1] == 'h' || token[length-1] == 'H' )
+  {
+    length--;
+  }
+
+  if( length == 0 || length >= sizeof(digits) )
+    return -1;
+
+  memcpy( digits, token, length );
+  digits[length] = '\0';
+
+  for( size_t i=0; i < length; i++ )
+  {
+    if( !isxdigit( (unsigned char)digits[i] ) )
+      return -1;
+  }
+
+  const long address = strtol( digits, NULL, 16 );
+  return (address <= 0xFFFF) ? address : -1;
+}
+
+static int is_label( const char *token )
+{
+  if( !(isalpha( (unsigned char)token[0] ) || token[0] == '_' || token[0] == '.') )
+    return 0;
+
+  return strcasecmp( token, "equ" ) != 0 && strcasecmp( token, "defl" ) != 0;
+}
+
+/*
+ * Pick the first label and the first address out of each line. Comments
+ * after a ';' are ignored.
+ */
+static int read_symbols( const char *filename )
+{
+  FILE *f = fopen( filename, "r" );
+  if( f == NULL )
+  {
+    perror( filename );
+    return -1;
+  }
+
+  char line[1024];
+  while( fgets( line, sizeof(line), f ) != NULL && num_symbols < MAX_SYMBOLS )
+  {
+    char *comment = strchr( line, ';' );
+    if( comment != NULL )
+      *comment = '\0';
+
+    const char *name    = NULL;
+    long        address = -1;
+
+    for( char *token = strtok( line, " \t\r\n:=," ); token != NULL; token = strtok( NULL, " \t\r\n:=," ) )
+    {
+      if( address < 0 && (address = parse_address( token )) >= 0 )
+        continue;
+
+      if( name == NULL && is_label( token ) )
+        name = token;
+    }
+
+    if( name == NULL || address < 0 )
+      continue;
+
+    SYMBOL *symbol = &symbols[num_symbols++];
+    snprintf( symbol->name, sizeof(symbol->name), "%s", name );
+    symbol->address = (uint32_t)address;
+    symbol->fetches = 0;
+  }
+
+  fclose( f );
+  return 0;
+}
+
+static int compare_symbol_addresses( const void *a, const void *b )
+{
+  const SYMBOL *symbol_a = (const SYMBOL*)a;
+  const SYMBOL *symbol_b = (const SYMBOL*)b;
+
+  if( symbol_a->address != symbol_b->address )
+    return (symbol_a->address < symbol_b->address) ? -1 : 1;
+
+  return strcmp( symbol_a->name, symbol_b->name );
+}
+
+static int compare_symbol_fetches( const void *a, const void *b )
+{
+  const SYMBOL *symbol_a = (const SYMBOL*)a;
+  const SYMBOL *symbol_b = (const SYMBOL*)b;
+
+  if( symbol_a->fetches != symbol_b->fetches )
+    return (symbol_a->fetches < symbol_b->fetches) ? 1 : -1;
+
+  return (symbol_a->address < symbol_b->address) ? -1 : 1;
+}
+
+/* The nearest label at or below the address, symbols sorted by address. NULL if none */
+static SYMBOL *find_symbol( const uint32_t address )
+{
+  SYMBOL *found = NULL;
+  uint32_t low = 0, high = num_symbols;
+
+  while( low < high )
+  {
+    const uint32_t mid = (low + high) / 2;
+    if( symbols[mid].address <= address )
+    {
+      found = &symbols[mid];
+      low   = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+
+  return found;
+}
+
+static const uint32_t *sort_counts;
+
+static int compare_counts( const void *a, const void *b )
+{
+  const uint32_t index_a = *(const uint32_t*)a;
+  const uint32_t index_b = *(const uint32_t*)b;
+
+  if( sort_counts[index_a] != sort_counts[index_b] )
+    return (sort_counts[index_a] < sort_counts[index_b]) ? 1 : -1;
+
+  return (index_a < index_b) ? -1 : 1;
+}
+
+static void print_page_summary( const char *title, const uint32_t *counts )
+{
+  uint32_t pages[NUM_EXEC_PROFILE_PAGES];
+  for( uint32_t i=0; i < NUM_EXEC_PROFILE_PAGES; i++ )
+    pages[i] = i;
+
+  sort_counts = counts;
+  qsort( pages, NUM_EXEC_PROFILE_PAGES, sizeof(uint32_t), compare_counts );
+
+  printf( "\npage %10s\n", title );
+  for( uint32_t i=0; i < NUM_EXEC_PROFILE_PAGES && counts[pages[i]] != 0; i++ )
+    printf( "%02X00 %10u\n", pages[i], counts[pages[i]] );
+}
+
+int main( int argc, char *argv[] )
+{
+  const char *symbol_filename = NULL;
+  uint32_t    count           = 20;
+  int         pages           = 0;
+  int         opt;
+
+  while( (opt = getopt( argc, argv, "s:n:p" )) != -1 )
+  {
+    switch( opt )
+    {
+    case 's': symbol_filename = optarg;                      break;
+    case 'n': count           = (uint32_t)atoi( optarg );    break;
+    case 'p': pages           = 1;                           break;
+    default:
+      fprintf( stderr, "Usage: %s [-s symbols] [-n count] [-p] exec_profile.bin\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if( optind != argc-1 )
+  {
+    fprintf( stderr, "Usage: %s [-s symbols] [-n count] [-p] exec_profile.bin\n", argv[0] );
+    return 1;
+  }
+
+  size_t length;
+
+  if( read_file( argv[optind], &profile, sizeof(profile), &length ) != 0 )
+    return 1;
+
+  if( length != sizeof(profile) || profile.magic != EXEC_PROFILE_MAGIC
+      || profile.pc_shift != EXEC_PROFILE_PC_SHIFT || profile.num_buckets != NUM_EXEC_PROFILE_BUCKETS
+      || profile.num_pages != NUM_EXEC_PROFILE_PAGES )
+  {
+    fprintf( stderr, "%s: not an execution profile dump from this version of the firmware\n", argv[optind] );
+    return 1;
+  }
+
+  if( symbol_filename != NULL )
+  {
+    if( read_symbols( symbol_filename ) != 0 )
+      return 1;
+
+    qsort( symbols, num_symbols, sizeof(SYMBOL), compare_symbol_addresses );
+  }
+
+  uint64_t total = 0;
+  for( uint32_t i=0; i < NUM_EXEC_PROFILE_BUCKETS; i++ )
+    total += profile.fetches[i];
+
+  printf( "%llu fetches, %u byte buckets, %u.%06uMHz%s\n",
+          (unsigned long long)total, 1U << EXEC_PROFILE_PC_SHIFT,
+          profile.cpu_clock_hz / 1000000, profile.cpu_clock_hz % 1000000,
+          profile.running ? "" : ", stopped" );
+
+  if( total == 0 )
+    return 0;
+
+  static uint32_t buckets[NUM_EXEC_PROFILE_BUCKETS];
+  for( uint32_t i=0; i < NUM_EXEC_PROFILE_BUCKETS; i++ )
+    buckets[i] = i;
+
+  sort_counts = profile.fetches;
+  qsort( buckets, NUM_EXEC_PROFILE_BUCKETS, sizeof(uint32_t), compare_counts );
+
+  printf( "\naddress    fetches      %%\n" );
+  for( uint32_t i=0; i < count && i < NUM_EXEC_PROFILE_BUCKETS && profile.fetches[buckets[i]] != 0; i++ )
+  {
+    const uint32_t address = buckets[i] << EXEC_PROFILE_PC_SHIFT;
+    const uint32_t fetches = profile.fetches[buckets[i]];
+    const SYMBOL  *symbol  = find_symbol( address );
+
+    printf( "%04X %12u %6.2f", address, fetches, 100.0 * fetches / total );
+    if( symbol != NULL )
+      printf( "  %s+%u", symbol->name, address - symbol->address );
+    printf( "\n" );
+  }
+
+  if( num_symbols != 0 )
+  {
+    uint64_t unlabelled = 0;
+
+    for( uint32_t i=0; i < NUM_EXEC_PROFILE_BUCKETS; i++ )
+    {
+      SYMBOL *symbol = find_symbol( i << EXEC_PROFILE_PC_SHIFT );
+      if( symbol != NULL )
+        symbol->fetches += profile.fetches[i];
+      else
+        unlabelled += profile.fetches[i];
+    }
+
+    qsort( symbols, num_symbols, sizeof(SYMBOL), compare_symbol_fetches );
+
+    printf( "\nlabel                              fetches      %%\n" );
+    for( uint32_t i=0; i < count && i < num_symbols && symbols[i].fetches != 0; i++ )
+      printf( "%-28s %14llu %6.2f\n", symbols[i].name, (unsigned long long)symbols[i].fetches,
+              100.0 * symbols[i].fetches / total );
+
+    if( unlabelled != 0 )
+      printf( "%-28s %14llu %6.2f\n", "(below the first label)", (unsigned long long)unlabelled,
+              100.0 * unlabelled / total );
+  }
+
+  if( pages )
+  {
+    print_page_summary( "reads", profile.page_reads );
+    print_page_summary( "writes", profile.page_writes );
+  }
+
+  return 0;
+}
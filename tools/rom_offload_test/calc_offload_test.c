@@ -0,0 +1,267 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Host test for calc_offload.c, see the Makefile.
+ *
+ * Usage: calc_offload_test [seed [rounds]]
+ *
+ * Each case puts one or two random numbers on the calculator stack and runs
+ * RST 28 with a short list of literals from RAM: an arithmetic operation, a
+ * function, or a few literals together. It's run once on the original ROM,
+ * then again from the same starting state on the patched ROM, where the
+ * offload runs the calculator on the RP2350 side. The registers and the RAM
+ * have to come out the same, apart from the stack below the final SP, which
+ * nothing can see.
+ *
+ * The default, 300 rounds of the 18 cases, is 5400 runs. Numbers are stored
+ * in the small integer form a third of the time, as BASIC does for whole
+ * numbers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "offload_host.h"
+#include "calc_offload.h"
+
+#define STKBOT       0x6000
+#define LITERALS     0x8000
+#define TEST_SP      0xFF00
+#define MAX_STEPS    5000000
+
+typedef struct
+{
+  const char *name;
+  uint8_t     literals[8];      // Ending with end-calc, 0x38
+  uint32_t    num_literals;
+  uint32_t    num_values;       // Numbers put on the stack first
+}
+CALC_CASE;
+
+static const CALC_CASE calc_cases[] =
+{
+  { "add",      { 0x0F, 0x38 },                   2, 2 },
+  { "subtract", { 0x03, 0x38 },                   2, 2 },
+  { "multiply", { 0x04, 0x38 },                   2, 2 },
+  { "divide",   { 0x05, 0x38 },                   2, 2 },
+  { "to-power", { 0x06, 0x38 },                   2, 2 },
+  { "n-mod-m",  { 0x32, 0x38 },                   2, 2 },
+  { "sin",      { 0x1F, 0x38 },                   2, 1 },
+  { "cos",      { 0x20, 0x38 },                   2, 1 },
+  { "tan",      { 0x21, 0x38 },                   2, 1 },
+  { "asn",      { 0x22, 0x38 },                   2, 1 },
+  { "acs",      { 0x23, 0x38 },                   2, 1 },
+  { "atn",      { 0x24, 0x38 },                   2, 1 },
+  { "ln",       { 0x25, 0x38 },                   2, 1 },
+  { "exp",      { 0x26, 0x38 },                   2, 1 },
+  { "int",      { 0x27, 0x38 },                   2, 1 },
+  { "sqr",      { 0x28, 0x38 },                   2, 1 },
+  { "dup-mem",  { 0x31, 0x04, 0xC0, 0x02, 0xE0, 0x38 }, 6, 1 },   // duplicate, multiply, st-mem-0, delete, get-mem-0
+  { "dup-sub",  { 0x31, 0x01, 0x38 },             3, 2 },         // duplicate, exchange
+};
+#define NUM_CALC_CASES (sizeof(calc_cases)/sizeof(calc_cases[0]))
+
+/*
+ * A number in the Spectrum's 5 byte form. Whole numbers which fit go in the
+ * small integer form if small_ints is set.
+ */
+static void put_number( uint8_t *dest, const double value, const bool small_ints )
+{
+  if( small_ints && value == floor( value ) && fabs( value ) < 65536 )
+  {
+    const int32_t  whole = (int32_t)value;
+    const uint16_t bits  = (uint16_t)whole;
+
+    dest[0] = 0;
+    dest[1] = (whole < 0) ? 0xFF : 0x00;
+    dest[2] = bits & 0xFF;
+    dest[3] = bits >> 8;
+    dest[4] = 0;
+    return;
+  }
+
+  if( value == 0 )
+  {
+    memset( dest, 0, 5 );
+    return;
+  }
+
+  int exponent;
+  const double   fraction = frexp( fabs( value ), &exponent );
+  const uint32_t mantissa = (uint32_t)ldexp( fraction, 32 );
+
+  dest[0] = exponent + 128;
+  dest[1] = ((mantissa >> 24) & 0x7F) | ((value < 0) ? 0x80 : 0x00);
+  dest[2] = mantissa >> 16;
+  dest[3] = mantissa >> 8;
+  dest[4] = mantissa;
+}
+
+static double random_number( void )
+{
+  switch( rand() % 4 )
+  {
+  case 0:  return (rand() % 2001) - 1000;
+  case 1:  return ldexp( (double)rand() / RAND_MAX, rand() % 40 - 20 );
+  case 2:  return ((double)rand() / RAND_MAX) * 2 - 1;
+  default: return -ldexp( (double)rand() / RAND_MAX, rand() % 20 - 5 );
+  }
+}
+
+static void set_word( const ZX_ADDR zx_addr, const ZX_WORD value )
+{
+  host_zx_memory[zx_addr]   = value & 0xFF;
+  host_zx_memory[zx_addr+1] = value >> 8;
+}
+
+/* Fill the RAM, put the numbers on the calculator stack and the literals at LITERALS */
+static void set_up_case( const CALC_CASE *calc_case, const double *values, const bool small_ints )
+{
+  for( uint32_t zx_addr=0x4000; zx_addr < 0x10000; zx_addr++ )
+    host_zx_memory[zx_addr] = (uint8_t)(zx_addr*7 + 3);
+
+  for( uint32_t i=0; i < calc_case->num_values; i++ )
+    put_number( &host_zx_memory[STKBOT + 5*i], values[i], small_ints );
+
+  set_word( 0x5C63, STKBOT );                               // STKBOT
+  set_word( 0x5C65, STKBOT + 5*calc_case->num_values );     // STKEND
+  set_word( 0x5C68, 0x5C92 );                               // MEM, the calculator's memory area
+
+  host_zx_memory[LITERALS] = 0xEF;                          // RST 28
+  memcpy( &host_zx_memory[LITERALS+1], calc_case->literals, calc_case->num_literals );
+}
+
+static void init_case_cpu( Z80_CPU *cpu )
+{
+  host_init_cpu( cpu, LITERALS );
+
+  cpu->af     = 0x1234; cpu->bc     = 0x5678; cpu->de     = 0x9ABC; cpu->hl     = 0xDEF0;
+  cpu->af_alt = 0x1111; cpu->bc_alt = 0x2222; cpu->de_alt = 0x3333; cpu->hl_alt = 0x4444;
+  cpu->ix     = 0xABCD; cpu->iy     = 0x5C3A; cpu->sp     = TEST_SP;
+}
+
+static bool same_registers( const Z80_CPU *a, const Z80_CPU *b )
+{
+  return a->af     == b->af     && a->bc     == b->bc     && a->de     == b->de     && a->hl     == b->hl     &&
+         a->af_alt == b->af_alt && a->bc_alt == b->bc_alt && a->de_alt == b->de_alt && a->hl_alt == b->hl_alt &&
+         a->ix     == b->ix     && a->iy     == b->iy     && a->sp     == b->sp     && a->pc     == b->pc;
+}
+
+int main( int argc, char **argv )
+{
+  const uint32_t seed   = (argc > 1) ? atoi( argv[1] ) : 1;
+  const uint32_t rounds = (argc > 2) ? atoi( argv[2] ) : 300;
+
+  static uint8_t start_memory[65536];
+  static uint8_t ref_memory[65536];
+
+  host_init();
+  if( !init_calc_offload() || !host_serve_patched_rom() )
+  {
+    printf( "Calculator offload didn't install\n" );
+    return 1;
+  }
+
+  srand( seed );
+
+  uint32_t runs = 0, failures = 0, errors = 0;
+
+  for( uint32_t round=0; round < rounds; round++ )
+  {
+    for( uint32_t c=0; c < NUM_CALC_CASES; c++ )
+    {
+      const CALC_CASE *calc_case = &calc_cases[c];
+      const bool small_ints = (rand() % 3) == 0;
+      double values[2];
+
+      for( uint32_t i=0; i < 2; i++ )
+        values[i] = random_number();
+
+      set_up_case( calc_case, values, small_ints );
+      memcpy( start_memory, host_zx_memory, sizeof(start_memory) );
+
+      const ZX_ADDR stop_pc = LITERALS + 1 + calc_case->num_literals;
+
+      Z80_CPU ref_cpu;
+      init_case_cpu( &ref_cpu );
+      host_serve_original_rom();
+      const long ref_steps = host_run( &ref_cpu, stop_pc, MAX_STEPS );
+      memcpy( ref_memory, host_zx_memory, sizeof(ref_memory) );
+
+      memcpy( host_zx_memory, start_memory, sizeof(start_memory) );
+
+      Z80_CPU offload_cpu;
+      init_case_cpu( &offload_cpu );
+      host_serve_patched_rom();
+      const long offload_steps = host_run( &offload_cpu, stop_pc, MAX_STEPS );
+
+      runs++;
+
+      /* Errors (a RST 8 report, say) end up stuck, and have to do so both ways */
+      if( ref_steps < 0 || offload_steps < 0 )
+      {
+        errors++;
+        if( (ref_steps < 0) != (offload_steps < 0) )
+        {
+          failures++;
+          printf( "FAIL %s %.10g %.10g: finished on one ROM only\n", calc_case->name, values[0], values[1] );
+        }
+        continue;
+      }
+
+      bool same = same_registers( &ref_cpu, &offload_cpu );
+      for( uint32_t zx_addr=0x4000; zx_addr < 0x10000 && same; zx_addr++ )
+      {
+        /* Below the SP is old stack */
+        if( zx_addr >= TEST_SP - 0x100 && zx_addr < ref_cpu.sp )
+          continue;
+
+        if( ref_memory[zx_addr] != host_zx_memory[zx_addr] )
+        {
+          printf( "  %04X is %02X, should be %02X\n", zx_addr, host_zx_memory[zx_addr], ref_memory[zx_addr] );
+          same = false;
+        }
+      }
+
+      if( !same )
+      {
+        failures++;
+        printf( "FAIL %s %.10g %.10g%s: AF %04X/%04X BC %04X/%04X DE %04X/%04X HL %04X/%04X\n",
+                calc_case->name, values[0], values[1], small_ints ? " (small ints)" : "",
+                ref_cpu.af, offload_cpu.af, ref_cpu.bc, offload_cpu.bc,
+                ref_cpu.de, offload_cpu.de, ref_cpu.hl, offload_cpu.hl );
+      }
+    }
+  }
+
+  printf( "%u runs, %u failures, %u errors on both ROMs\n", runs, failures, errors );
+  printf( "%u offloaded, %u fell back to the Z80, %u DMAs of %u bytes\n",
+          query_calc_offload_count(), query_calc_fallback_count(), host_dma_count, host_dma_bytes );
+
+  if( query_calc_offload_count() == 0 )
+  {
+    printf( "Nothing was offloaded\n" );
+    return 1;
+  }
+
+  return (failures == 0) ? 0 : 1;
+}
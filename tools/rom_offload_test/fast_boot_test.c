@@ -0,0 +1,235 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Host test for fast_boot.c, see the Makefile.
+ *
+ * The ROM is started from power on with RAM full of junk, once on the
+ * original ROM and once with fast boot's clear stub in place of the RAM
+ * test, and both have to reach MAIN-1 with the same RAM and registers. A
+ * third start up sets a program image which has to be loaded and run. Then
+ * NEW, with RAMTOP moved down and junk under it, has to clear the same as
+ * the original. The calculator and screen offloads are installed too, as
+ * they would be on the device, so the stubs have to share the patched ROM.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "offload_host.h"
+#include "calc_offload.h"
+#include "screen_offload.h"
+#include "fast_boot.h"
+
+#define START              0x0000
+#define NEW                0x11B7
+#define STACK_SET          0x1229      // Just after the LD SP,HL which puts the stack under RAMTOP
+#define MAIN_1             0x12A9
+#define RAMTOP             0x5CB2
+#define MAX_BOOT_STEPS     50000000
+
+#define JUNK               0xA5
+#define NEW_RAMTOP         0xEF57      // Not a page boundary, so the stub clears some bytes singly
+#define NEW_JUNK_BYTE      0x77
+
+/* LD A,42h / LD (9000h),A / RET */
+#define IMAGE_ADDR         0x8000
+#define IMAGE_RESULT_ADDR  0x9000
+#define IMAGE_RESULT       0x42
+static const uint8_t image[] = { 0x3E, IMAGE_RESULT, 0x32, IMAGE_RESULT_ADDR & 0xFF, IMAGE_RESULT_ADDR >> 8, 0xC9 };
+
+typedef struct _BOOT_RESULT
+{
+  long    steps;
+  Z80_CPU cpu;
+  ZX_ADDR lowest_sp;
+  uint8_t memory[65536];
+}
+BOOT_RESULT;
+
+static BOOT_RESULT ref_boot, fast_boot, image_boot, ref_new, fast_new;
+
+/*
+ * Carry on from where the ROM sets up its stack to MAIN-1. The clear stub
+ * pushes its way down the whole of RAM and leaves SP at the bottom, which
+ * isn't the stack, so the lowest SP is only counted from here.
+ */
+static bool run_from_stack_set( BOOT_RESULT *result, const long steps )
+{
+  if( steps < 0 )
+    return false;
+
+  const Z80_CPU cleared = result->cpu;
+  host_init_cpu( &result->cpu, STACK_SET );
+  result->cpu = cleared;
+
+  const long more_steps = host_run( &result->cpu, MAIN_1, MAX_BOOT_STEPS );
+
+  result->steps     = steps + more_steps;
+  result->lowest_sp = host_query_lowest_sp();
+  memcpy( result->memory, host_zx_memory, sizeof(result->memory) );
+
+  return (more_steps >= 0);
+}
+
+static bool boot( BOOT_RESULT *result )
+{
+  host_clear_memory( JUNK );
+  host_init_cpu( &result->cpu, START );
+
+  return run_from_stack_set( result, host_run( &result->cpu, STACK_SET, MAX_BOOT_STEPS ) );
+}
+
+/*
+ * NEW from a booted machine, with RAMTOP moved down, junk under it for NEW
+ * to clear and a byte above it for NEW to leave alone. Both ROMs start from
+ * the original ROM's boot, NEW leaves what's above RAMTOP as it finds it.
+ */
+static bool new( const BOOT_RESULT *booted, BOOT_RESULT *result )
+{
+  memcpy( host_zx_memory, booted->memory, sizeof(host_zx_memory) );
+  memset( &host_zx_memory[0x6000], NEW_JUNK_BYTE, NEW_RAMTOP+1-0x6000 );
+  host_zx_memory[RAMTOP]       = NEW_RAMTOP & 0xFF;
+  host_zx_memory[RAMTOP+1]     = NEW_RAMTOP >> 8;
+  host_zx_memory[NEW_RAMTOP+1] = NEW_JUNK_BYTE;
+
+  host_init_cpu( &result->cpu, NEW );
+  result->cpu.sp = booted->cpu.sp;
+  result->cpu.iy = booted->cpu.iy;
+
+  return run_from_stack_set( result, host_run( &result->cpu, STACK_SET, MAX_BOOT_STEPS ) );
+}
+
+static bool is_image_addr( const uint32_t zx_addr )
+{
+  return (zx_addr >= IMAGE_ADDR && zx_addr < IMAGE_ADDR+sizeof(image)) || zx_addr == IMAGE_RESULT_ADDR;
+}
+
+/*
+ * Compare the RAM, and the registers if they're expected to match. Returns
+ * 1 if there's a difference, printing the first few.
+ *
+ * The offloads' stubs don't use the stack the way the ROM does, so what's
+ * left below the final SP isn't compared. Nor is AF, the run stub leaves its
+ * status in it, and MAIN-1 sets A itself.
+ */
+static uint32_t compare( const char *name, const BOOT_RESULT *ref, const BOOT_RESULT *got, const bool with_image )
+{
+  const ZX_ADDR lowest_sp = (ref->lowest_sp < got->lowest_sp) ? ref->lowest_sp : got->lowest_sp;
+  uint32_t differences = 0;
+
+  for( uint32_t zx_addr=0x4000; zx_addr < 0x10000; zx_addr++ )
+  {
+    if( zx_addr >= lowest_sp && zx_addr < ref->cpu.sp )
+      continue;
+
+    if( with_image && is_image_addr( zx_addr ) )
+      continue;
+
+    if( ref->memory[zx_addr] != got->memory[zx_addr] )
+    {
+      if( differences < 8 )
+        printf( "  %s: 0x%04X is 0x%02X, should be 0x%02X\n", name, zx_addr, got->memory[zx_addr], ref->memory[zx_addr] );
+      differences++;
+    }
+  }
+
+  /* The image leaves its own registers, the stub puts the stack back */
+  if( got->cpu.sp != ref->cpu.sp || got->cpu.iy != ref->cpu.iy )
+  {
+    printf( "  %s: SP 0x%04X IY 0x%04X, should be 0x%04X 0x%04X\n", name, got->cpu.sp, got->cpu.iy, ref->cpu.sp, ref->cpu.iy );
+    differences++;
+  }
+
+  if( !with_image &&
+      (got->cpu.bc != ref->cpu.bc ||
+       got->cpu.de != ref->cpu.de || got->cpu.hl != ref->cpu.hl || got->cpu.ix != ref->cpu.ix) )
+  {
+    printf( "  %s: BC %04X DE %04X HL %04X IX %04X, should be %04X %04X %04X %04X\n", name,
+            got->cpu.bc, got->cpu.de, got->cpu.hl, got->cpu.ix,
+            ref->cpu.bc, ref->cpu.de, ref->cpu.hl, ref->cpu.ix );
+    differences++;
+  }
+
+  printf( "%s %s: %ld instructions, %ld on the original ROM\n",
+          differences ? "FAIL" : "ok  ", name, got->steps, ref->steps );
+
+  return differences ? 1 : 0;
+}
+
+int main( void )
+{
+  host_init();
+  if( !init_calc_offload() || !init_screen_offload() || !init_fast_boot() )
+  {
+    printf( "Fast boot didn't install\n" );
+    return 1;
+  }
+
+  host_serve_original_rom();
+  if( !boot( &ref_boot ) || !new( &ref_boot, &ref_new ) )
+  {
+    printf( "The original ROM didn't boot\n" );
+    return 1;
+  }
+
+  uint32_t failures = 0;
+
+  host_serve_patched_rom();
+  if( is_fast_boot_image_pending() || !boot( &fast_boot ) )
+  {
+    printf( "FAIL fast boot didn't finish\n" );
+    return 1;
+  }
+  failures += compare( "fast boot", &ref_boot, &fast_boot, false );
+
+  if( !new( &ref_boot, &fast_new ) )
+  {
+    printf( "FAIL NEW didn't finish\n" );
+    return 1;
+  }
+  failures += compare( "NEW under a lower RAMTOP", &ref_new, &fast_new, false );
+
+  if( !set_fast_boot_image( image, IMAGE_ADDR, sizeof(image), IMAGE_ADDR ) || !boot( &image_boot ) )
+  {
+    printf( "FAIL fast boot with an image didn't finish\n" );
+    return 1;
+  }
+  failures += compare( "fast boot with an image", &ref_boot, &image_boot, true );
+
+  if( is_fast_boot_image_pending() || memcmp( &image_boot.memory[IMAGE_ADDR], image, sizeof(image) ) != 0 ||
+      image_boot.memory[IMAGE_RESULT_ADDR] != IMAGE_RESULT )
+  {
+    printf( "FAIL the image wasn't loaded and run\n" );
+    failures++;
+  }
+
+  /* Only the once, the next start up goes straight into BASIC */
+  BOOT_RESULT *again = &fast_new;
+  if( !boot( again ) || again->memory[IMAGE_RESULT_ADDR] == IMAGE_RESULT )
+  {
+    printf( "FAIL the image ran a second time\n" );
+    failures++;
+  }
+
+  printf( "%u failures. %u DMAs of %u bytes\n", failures, host_dma_count, host_dma_bytes );
+
+  return failures ? 1 : 0;
+}
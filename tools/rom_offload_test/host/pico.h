@@ -0,0 +1,42 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Just enough of the Pico SDK's pico.h for the firmware's ROM offload code
+ * to build on the host. Nothing here runs on an RP2350.
+ */
+
+#ifndef __HOST_PICO_H
+#define __HOST_PICO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define __scratch_x(name)
+#define __scratch_y(name)
+#define __not_in_flash_func(func) func
+#define __force_inline inline __attribute__((always_inline))
+
+static inline void __dmb( void )
+{
+  __sync_synchronize();
+}
+
+#endif
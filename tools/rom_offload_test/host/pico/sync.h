@@ -0,0 +1,2 @@
+/* Host stand-in, see pico.h in this directory */
+#include "pico.h"
@@ -0,0 +1,336 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The pretend Spectrum, see offload_host.h. The rest of this file stands in
+ * for the parts of the firmware the offloads call but which need the real
+ * hardware: the DMA engine, the mirror and the ROM banks.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "offload_host.h"
+#include "dma_engine.h"
+#include "rom_bank.h"
+#include "rom_trap.h"
+#include "zx_mirror.h"
+#include "zx_memory_management.h"
+#include "machine_profile.h"
+#include "rom.h"
+
+uint8_t  host_zx_memory[65536];
+uint32_t host_dma_count = 0;
+uint32_t host_dma_bytes = 0;
+
+static const uint8_t *served_rom     = _48_original_rom;
+static const uint8_t *patched_rom    = NULL;
+static uint8_t        host_rom_bank  = 0;
+static ZX_ADDR        lowest_sp      = 0xFFFF;
+
+void host_init( void )
+{
+  host_clear_memory( 0 );
+  host_serve_original_rom();
+
+  init_rom_traps();
+}
+
+void host_clear_memory( const uint8_t fill )
+{
+  memset( host_zx_memory, fill, sizeof(host_zx_memory) );
+}
+
+void host_serve_original_rom( void )
+{
+  switch_rom_bank( 0 );
+}
+
+bool host_serve_patched_rom( void )
+{
+  if( patched_rom == NULL )
+    return false;
+
+  return switch_rom_bank( 1 );
+}
+
+static ZX_BYTE host_read( const ZX_ADDR zx_addr, void *user_data )
+{
+  return (zx_addr < 0x4000) ? served_rom[zx_addr] : host_zx_memory[zx_addr];
+}
+
+/*
+ * Writes to the ROM area don't change the ROM, but core1 still mirrors them.
+ * The trap stubs use that to pass their SP over.
+ */
+static void host_write( const ZX_ADDR zx_addr, const ZX_BYTE value, void *user_data )
+{
+  host_zx_memory[zx_addr] = value;
+}
+
+void host_init_cpu( Z80_CPU *cpu, const ZX_ADDR pc )
+{
+  memset( cpu, 0, sizeof(Z80_CPU) );
+
+  cpu->pc    = pc;
+  cpu->read  = host_read;
+  cpu->write = host_write;
+
+  lowest_sp = 0xFFFF;
+}
+
+ZX_ADDR host_query_lowest_sp( void )
+{
+  return lowest_sp;
+}
+
+static ZX_WORD pop_word( Z80_CPU *cpu )
+{
+  const ZX_WORD value = host_read( cpu->sp, NULL ) | (host_read( cpu->sp+1, NULL ) << 8);
+  cpu->sp += 2;
+  return value;
+}
+
+/*
+ * The instructions the sandbox won't run. Port reads see a keyboard with
+ * nothing pressed. Returns false for anything else it doesn't know.
+ */
+static bool run_refused_instruction( Z80_CPU *cpu )
+{
+  const uint8_t op  = host_read( cpu->pc,   NULL );
+  const uint8_t op2 = host_read( cpu->pc+1, NULL );
+
+  switch( op )
+  {
+  case 0xF3:    /* DI */
+  case 0xFB:    /* EI */
+  case 0x76:    /* HALT, there are no interrupts to wait for */
+    cpu->pc += 1;
+    return true;
+
+  case 0xD3:    /* OUT (n),A */
+    cpu->pc += 2;
+    return true;
+
+  case 0xDB:    /* IN A,(n) */
+    cpu->af = (cpu->af & 0x00FF) | 0xBF00;
+    cpu->pc += 2;
+    return true;
+
+  case 0xED:
+    if( op2 == 0x45 || op2 == 0x4D )               /* RETN, RETI */
+      cpu->pc = pop_word( cpu );
+    else if( op2 == 0x57 || op2 == 0x5F )          /* LD A,I and LD A,R */
+    {
+      cpu->af &= 0x00FF;
+      cpu->pc += 2;
+    }
+    else if( (op2 & 0xC7) == 0x40 )                /* IN r,(C) */
+    {
+      if( ((op2 >> 3) & 0x07) == 7 )
+        cpu->af = (cpu->af & 0x00FF) | 0xBF00;
+      cpu->pc += 2;
+    }
+    else                                           /* OUT (C),r, IM n */
+      cpu->pc += 2;
+    return true;
+  }
+
+  return false;
+}
+
+static uint32_t core0_lag = 1;
+
+void host_set_core0_lag( const uint32_t instructions )
+{
+  core0_lag = (instructions != 0) ? instructions : 1;
+}
+
+long host_run( Z80_CPU *cpu, const ZX_ADDR stop_pc, const long max_steps )
+{
+  for( long steps=0; steps < max_steps; steps++ )
+  {
+    if( cpu->pc == stop_pc )
+      return steps;
+
+    /* RST 8 is the ROM's error report, which ends up waiting for a key */
+    if( cpu->pc == 0x0008 )
+      return -1;
+
+    if( cpu->sp < lowest_sp )
+      lowest_sp = cpu->sp;
+
+    /* Core1 sees the fetch... */
+    if( cpu->pc < 0x4000 && is_rom_trap_page( cpu->pc ) )
+      check_rom_traps( cpu->pc );
+
+    /* ...and core0 runs the handler when it next gets round to it */
+    if( (steps % core0_lag) == 0 && is_rom_trap_pending() )
+      service_rom_traps();
+
+    const Z80_CPU saved = *cpu;
+    if( !z80_cpu_step( cpu ) )
+    {
+      *cpu = saved;
+      if( !run_refused_instruction( cpu ) )
+      {
+        printf( "Can't run %02X at %04X\n", host_read( cpu->pc, NULL ), cpu->pc );
+        return -1;
+      }
+    }
+  }
+
+  return -1;
+}
+
+/*
+ * The DMA engine. Each block is checked the way dma_memory_block() checks
+ * it, and anything sent with interrupt protection has to fit in the
+ * int_unsafe guard, which is what dma_memory_block_int_safe() is for.
+ */
+DMA_STATUS dma_memory_block( const DMA_BLOCK *data_block, const bool int_protection )
+{
+  if( data_block == NULL || data_block->src == NULL )
+    return DMA_STATUS_BAD_STRUCT;
+
+  if( data_block->length == 0 )
+    return DMA_STATUS_TOO_SMALL;
+
+  if( data_block->length > MAX_DMA_LENGTH )
+    return DMA_STATUS_TOO_BIG;
+
+  if( int_protection )
+  {
+    const uint32_t limit = zx_range_is_contended( data_block->zx_ram_location, data_block->length )
+                           ? INT_SAFE_CONTENDED_DMA_LENGTH : INT_SAFE_DMA_LENGTH;
+    if( data_block->length > limit )
+    {
+      printf( "DMA of %u bytes to %04X is too long for the int_unsafe guard\n",
+              data_block->length, data_block->zx_ram_location );
+      return DMA_STATUS_TOO_BIG;
+    }
+  }
+
+  for( uint32_t i=0; i < data_block->length; i++ )
+    host_write( (ZX_ADDR)(data_block->zx_ram_location+i), data_block->src[i], NULL );
+
+  host_dma_count++;
+  host_dma_bytes += data_block->length;
+
+  return DMA_STATUS_OK;
+}
+
+/* The same split as the one in dma_engine.c */
+DMA_STATUS dma_memory_block_int_safe( const uint8_t *src, const ZX_ADDR zx_addr, const uint32_t length )
+{
+  uint32_t offset = 0;
+
+  while( offset < length )
+  {
+    uint32_t chunk = length - offset;
+    if( chunk > INT_SAFE_DMA_LENGTH )
+      chunk = INT_SAFE_DMA_LENGTH;
+
+    if( chunk > INT_SAFE_CONTENDED_DMA_LENGTH && zx_range_is_contended( zx_addr+offset, chunk ) )
+      chunk = INT_SAFE_CONTENDED_DMA_LENGTH;
+
+    DMA_BLOCK block = { (uint8_t*)(src+offset), zx_addr+offset, chunk, 1 };
+
+    const DMA_STATUS status = dma_memory_block( &block, true );
+    if( status != DMA_STATUS_OK )
+      return status;
+
+    offset += chunk;
+  }
+
+  return DMA_STATUS_OK;
+}
+
+/* A 48K, the screen RAM is the only contended memory. Ranges wrap at 0xFFFF. */
+bool zx_range_is_contended( const ZX_ADDR zx_addr, const uint32_t length )
+{
+  if( length == 0 )
+    return false;
+
+  if( length >= 0x10000 )
+    return true;
+
+  const uint32_t start = zx_addr;
+  const uint32_t end   = start + length - 1;
+
+  if( end > 0xFFFF )
+    return (start <= 0x7FFF) || ((end & 0xFFFF) >= 0x4000);
+
+  return (start <= 0x7FFF && end >= 0x4000);
+}
+
+/* The mirror is the memory image itself */
+uint8_t * volatile zx_mirror_segments[4] =
+{
+  &host_zx_memory[0x0000], &host_zx_memory[0x4000], &host_zx_memory[0x8000], &host_zx_memory[0xC000],
+};
+
+void put_zx_mirror_byte( const ZX_ADDR offset, const ZX_BYTE value )
+{
+  host_zx_memory[offset] = value;
+}
+
+void copy_from_zx_mirror( void *dest, const ZX_ADDR addr, const uint32_t length )
+{
+  for( uint32_t i=0; i < length; i++ )
+    ((uint8_t*)dest)[i] = host_zx_memory[(ZX_ADDR)(addr+i)];
+}
+
+void mark_zx_mirror_dirty( const ZX_ADDR addr, const uint32_t length )
+{
+}
+
+/* The ROM banks. There's the 48K ROM, and the ROM trap image when it's registered. */
+const uint8_t *query_rom_bank_page( const uint8_t page )
+{
+  return _48_original_rom;
+}
+
+uint8_t register_rom_bank( const char *name, const uint8_t *page0, const uint8_t *page1 )
+{
+  patched_rom = page0;
+  return 1;
+}
+
+bool switch_rom_bank( const uint8_t bank )
+{
+  host_rom_bank = bank;
+  served_rom    = (bank == 0) ? _48_original_rom : patched_rom;
+  return true;
+}
+
+uint8_t query_rom_bank( void )
+{
+  return host_rom_bank;
+}
+
+uint8_t query_zx_paging_latch( void )
+{
+  return 0;
+}
+
+bool is_pio_rom_serving( void )
+{
+  return false;
+}
@@ -0,0 +1,79 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * A pretend Spectrum for running the firmware's ROM offloads on the host.
+ *
+ * The Z80 is the firmware's own sandbox interpreter, run against a 64K
+ * memory image. The ROM area is served from either the original 48K ROM or
+ * the patched ROM trap image. Core1's part (spotting fetches from a trap
+ * address) and core0's part (running the handlers) are done between
+ * instructions. The DMA engine and the mirror both go straight to the memory
+ * image, so the mirror is always right, which is what the firmware aims for.
+ *
+ * The sandbox interpreter refuses anything that touches the world outside
+ * memory. The ROM does some of that (DI/EI, HALT, IN, OUT), so the runner
+ * does those itself, with a keyboard that has nothing pressed.
+ */
+
+#ifndef __OFFLOAD_HOST_H
+#define __OFFLOAD_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "zx_copro.h"
+#include "z80_cpu.h"
+
+/*
+ * The Spectrum's memory, which is also the mirror. ROM reads come from the
+ * served ROM, 0x0000-0x3FFF here only holds what's been written there.
+ */
+extern uint8_t host_zx_memory[65536];
+
+/* Counts of what the firmware asked the DMA engine to do */
+extern uint32_t host_dma_count;
+extern uint32_t host_dma_bytes;
+
+void host_init( void );
+void host_clear_memory( const uint8_t fill );
+
+void host_serve_original_rom( void );
+bool host_serve_patched_rom( void );
+
+void host_init_cpu( Z80_CPU *cpu, const ZX_ADDR pc );
+
+/*
+ * Run until the PC gets to stop_pc. Returns the number of instructions run,
+ * or -1 if it didn't get there in max_steps, ran into something it can't do,
+ * or the ROM reported an error.
+ */
+long host_run( Z80_CPU *cpu, const ZX_ADDR stop_pc, const long max_steps );
+
+/*
+ * Have core0 only look for traps to service every so many instructions,
+ * the way the main loop's housekeeping only comes round every so often.
+ * The default is every instruction.
+ */
+void host_set_core0_lag( const uint32_t instructions );
+
+/* The lowest SP seen by host_run() since the last host_init_cpu() */
+ZX_ADDR host_query_lowest_sp( void );
+
+#endif
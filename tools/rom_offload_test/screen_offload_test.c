@@ -0,0 +1,290 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Host test for screen_offload.c, see the Makefile.
+ *
+ * Usage: screen_offload_test [first_seed [sequences [core0_lag]]]
+ *
+ * The ROM is booted as far as the editor waiting for a key. From there,
+ * each sequence runs a random Z80 program that calls the ROM to print, clear
+ * the screen, PLOT and DRAW: about 40 operations, made from the seed. It
+ * runs once on the original ROM, then again from the same starting state on
+ * the patched ROM. On the patched ROM the screen routines, and the
+ * calculator behind PLOT and DRAW, are offloaded. The registers and the RAM
+ * have to come out the same, apart from the stack below the final SP and the
+ * program itself.
+ *
+ * The default is 30 sequences, seeds 1 to 30. With a core0_lag, trap
+ * handlers only run every that many instructions, as if core0 were busy
+ * elsewhere. PLOT and DRAW call the calculator over and over, so this
+ * is where a stub which comes round again before core0 has caught up
+ * shows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "offload_host.h"
+#include "calc_offload.h"
+#include "screen_offload.h"
+
+#define EDITOR_WAIT_KEY  0x10A8      // KEY-INPUT, where the booted ROM sits waiting
+#define PROGRAM          0xF000
+#define MAX_PROGRAM      3000        // Operations stop being added after this
+#define PROGRAM_SPACE    4096        // The last one can take it up to about 3500, to 0xFFFF at most
+#define NUM_OPERATIONS   40
+#define MAX_BOOT_STEPS   50000000
+#define MAX_RUN_STEPS    200000000
+
+static uint8_t  program[PROGRAM_SPACE];
+static uint32_t program_length;
+
+static void emit( const uint8_t byte )
+{
+  if( program_length == PROGRAM_SPACE )
+  {
+    fprintf( stderr, "Program overflows 0x%04X\n", PROGRAM );
+    exit( 2 );
+  }
+  program[program_length++] = byte;
+}
+
+static void emit_call( const ZX_ADDR zx_addr )
+{
+  emit( 0xCD );
+  emit( zx_addr & 0xFF );
+  emit( zx_addr >> 8 );
+}
+
+/* LD A,n and STACK-A */
+static void emit_stack_a( const uint8_t value )
+{
+  emit( 0x3E ); emit( value );
+  emit_call( 0x2D28 );
+}
+
+/* Set SCR-CT so there's never a "scroll?", then LD A,ch and RST 10 */
+static void emit_print( const uint8_t ch )
+{
+  emit( 0x3E ); emit( 0xFF );
+  emit( 0x32 ); emit( 0x8C ); emit( 0x5C );
+  emit( 0x3E ); emit( ch );
+  emit( 0xD7 );
+}
+
+/* Open channel 'S', the upper screen */
+static void emit_open_screen( void )
+{
+  emit( 0x3E ); emit( 0x02 );
+  emit_call( 0x1601 );
+}
+
+/*
+ * A random mix of CLS, runs of printing, PLOT, DRAW, and AT/INK control
+ * codes, ending with a HALT, which is where the run stops.
+ */
+static void make_program( const uint32_t seed )
+{
+  srand( seed );
+  program_length = 0;
+
+  emit_open_screen();
+
+  for( uint32_t op=0; op < NUM_OPERATIONS && program_length < MAX_PROGRAM; op++ )
+  {
+    switch( rand() % 6 )
+    {
+    case 0:                                   /* CLS */
+      emit_call( 0x0D6B );
+      emit_open_screen();
+      break;
+
+    case 1:
+    case 2:                                   /* Some text, with the odd newline */
+    {
+      const uint32_t length = rand() % 60 + 1;
+      for( uint32_t i=0; i < length; i++ )
+        emit_print( (rand() % 8 == 0) ? 0x0D : (rand() % 95 + 32) );
+      break;
+    }
+
+    case 3:                                   /* PLOT x,y */
+      emit_stack_a( rand() % 256 );
+      emit_stack_a( rand() % 176 );
+      emit_call( 0x22DC );
+      break;
+
+    case 4:                                   /* PLOT x,y: DRAW dx,dy */
+    {
+      const int x  = rand() % 256, y  = rand() % 176;
+      const int dx = rand() % 256 - x, dy = rand() % 176 - y;
+
+      emit_stack_a( x );
+      emit_stack_a( y );
+      emit_call( 0x22DC );
+
+      emit_stack_a( abs( dx ) );
+      emit_stack_a( abs( dy ) );
+      emit( 0xEF );                           /* Calculator: negate where needed, then exchange */
+      if( dy < 0 ) emit( 0x1B );
+      emit( 0x01 );
+      if( dx < 0 ) emit( 0x1B );
+      emit( 0x01 );
+      emit( 0x38 );
+      emit_call( 0x24B7 );                    /* DRAW-LINE */
+      break;
+    }
+
+    default:                                  /* AT row,col; INK n; a character */
+      emit_print( 0x16 );
+      emit_print( rand() % 22 );
+      emit_print( rand() % 32 );
+      emit_print( 0x11 );
+      emit_print( rand() % 8 );
+      emit_print( rand() % 95 + 32 );
+      break;
+    }
+  }
+
+  emit( 0x76 );
+}
+
+/*
+ * Run the program from the booted state. The stack goes just under the one
+ * ERR_SP points at, with PROGRAM as the address an error would go back to.
+ */
+static long run_program( const uint8_t *booted, Z80_CPU *cpu )
+{
+  memcpy( host_zx_memory, booted, sizeof(host_zx_memory) );
+  memcpy( &host_zx_memory[PROGRAM], program, program_length );
+
+  host_init_cpu( cpu, PROGRAM );
+
+  const ZX_ADDR err_sp = host_zx_memory[0x5C3D] | (host_zx_memory[0x5C3E] << 8);
+  cpu->sp = err_sp - 2;
+  host_zx_memory[cpu->sp]   = PROGRAM & 0xFF;
+  host_zx_memory[cpu->sp+1] = PROGRAM >> 8;
+  cpu->iy = 0x5C3A;
+
+  return host_run( cpu, PROGRAM + program_length - 1, MAX_RUN_STEPS );
+}
+
+static bool same_registers( const Z80_CPU *a, const Z80_CPU *b )
+{
+  return a->af     == b->af     && a->bc     == b->bc     && a->de     == b->de     && a->hl     == b->hl     &&
+         a->af_alt == b->af_alt && a->bc_alt == b->bc_alt && a->de_alt == b->de_alt && a->hl_alt == b->hl_alt &&
+         a->ix     == b->ix     && a->iy     == b->iy     && a->sp     == b->sp     && a->pc     == b->pc;
+}
+
+int main( int argc, char **argv )
+{
+  const uint32_t first_seed = (argc > 1) ? atoi( argv[1] ) : 1;
+  const uint32_t sequences  = (argc > 2) ? atoi( argv[2] ) : 30;
+  const uint32_t core0_lag  = (argc > 3) ? atoi( argv[3] ) : 1;
+
+  static uint8_t booted[65536];
+  static uint8_t ref_memory[65536];
+
+  host_init();
+  host_set_core0_lag( core0_lag );
+  if( !init_calc_offload() || !init_screen_offload() )
+  {
+    printf( "Screen offload didn't install\n" );
+    return 1;
+  }
+
+  Z80_CPU cpu;
+  host_serve_original_rom();
+  host_init_cpu( &cpu, 0x0000 );
+  if( host_run( &cpu, EDITOR_WAIT_KEY, MAX_BOOT_STEPS ) < 0 )
+  {
+    printf( "The ROM didn't boot\n" );
+    return 1;
+  }
+  memcpy( booted, host_zx_memory, sizeof(booted) );
+
+  uint32_t failures = 0;
+
+  for( uint32_t seed=first_seed; seed < first_seed+sequences; seed++ )
+  {
+    make_program( seed );
+
+    Z80_CPU ref_cpu;
+    host_serve_original_rom();
+    const long    ref_steps  = run_program( booted, &ref_cpu );
+    const ZX_ADDR ref_lowest = host_query_lowest_sp();
+    memcpy( ref_memory, host_zx_memory, sizeof(ref_memory) );
+
+    const uint32_t offloads_before = query_screen_offload_count();
+
+    Z80_CPU offload_cpu;
+    host_serve_patched_rom();
+    const long    offload_steps  = run_program( booted, &offload_cpu );
+    const ZX_ADDR offload_lowest = host_query_lowest_sp();
+
+    if( ref_steps < 0 || offload_steps < 0 )
+    {
+      failures++;
+      printf( "FAIL seed %u: didn't finish (%ld/%ld steps)\n", seed, ref_steps, offload_steps );
+      continue;
+    }
+
+    const ZX_ADDR lowest_sp = (ref_lowest < offload_lowest) ? ref_lowest : offload_lowest;
+    uint32_t differences = 0;
+
+    for( uint32_t zx_addr=0x4000; zx_addr < 0x10000; zx_addr++ )
+    {
+      if( zx_addr >= lowest_sp && zx_addr < ref_cpu.sp )
+        continue;
+
+      if( zx_addr >= PROGRAM && zx_addr < PROGRAM + program_length )
+        continue;
+
+      if( ref_memory[zx_addr] != host_zx_memory[zx_addr] )
+      {
+        if( differences < 10 )
+          printf( "  %04X is %02X, should be %02X\n", zx_addr, host_zx_memory[zx_addr], ref_memory[zx_addr] );
+        differences++;
+      }
+    }
+
+    const bool same = (differences == 0) && same_registers( &ref_cpu, &offload_cpu );
+    if( !same )
+      failures++;
+
+    printf( "%s seed %u: %u bytes of program, %ld instructions on the Z80, %ld with %u offloads\n",
+            same ? "ok  " : "FAIL", seed, program_length, ref_steps, offload_steps,
+            query_screen_offload_count() - offloads_before );
+  }
+
+  printf( "%u sequences, %u failures\n", sequences, failures );
+  printf( "Screen: %u offloaded, %u fell back. Calculator: %u offloaded, %u fell back. %u DMAs of %u bytes\n",
+          query_screen_offload_count(), query_screen_fallback_count(),
+          query_calc_offload_count(), query_calc_fallback_count(), host_dma_count, host_dma_bytes );
+
+  if( query_screen_offload_count() == 0 )
+  {
+    printf( "Nothing was offloaded\n" );
+    return 1;
+  }
+
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,490 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Host test for snapshot.c, see the Makefile.
+ *
+ * The mirror is eight pretend RAM banks, filled with a mix of runs, lone and
+ * repeated EDs and noise, so the .Z80 compression has every case to deal with
+ * and one bank doesn't compress at all. A snapshot is made of it in each
+ * format, as a 48K and as a 128K, and loaded back the way an emulator would.
+ * The memory, the registers, the border and the paging have to come back as
+ * they went in.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+#include "zx_mirror.h"
+#include "machine_profile.h"
+
+#define BORDER         0x03
+#define MAX_SNAPSHOT   (27 + 4 + 9*ZX_SEGMENT_SIZE)
+
+static const ZX_MACHINE_PROFILE profile_48k  = { .machine = ZX_MACHINE_48K,  .name = "48K",  .num_ram_banks = 3 };
+static const ZX_MACHINE_PROFILE profile_128k = { .machine = ZX_MACHINE_128K, .name = "128K", .num_ram_banks = 8 };
+
+static const ZX_MACHINE_PROFILE *profile = &profile_48k;
+
+static uint8_t banks[ZX_NUM_RAM_BANKS][ZX_SEGMENT_SIZE];
+static uint8_t rom[ZX_SEGMENT_SIZE];
+static uint8_t paging_latch = 0;
+
+/* What's loaded back from a snapshot */
+static uint8_t loaded_banks[ZX_NUM_RAM_BANKS][ZX_SEGMENT_SIZE];
+static uint8_t loaded_latch;
+static uint8_t loaded_border;
+
+static uint8_t  snapshot[MAX_SNAPSHOT];
+static uint32_t snapshot_length;
+static uint32_t largest_chunk;
+
+static uint32_t failures = 0;
+
+/*
+ * The parts of the firmware snapshot.c calls on. The 64K the Z80 sees is the
+ * ROM, banks 5 and 2, and the paged bank, which is always 0 on a 48K.
+ */
+const ZX_MACHINE_PROFILE *query_machine_profile( void )
+{
+  return profile;
+}
+
+const void *query_zx_mirror_bank_ptr( const uint8_t bank )
+{
+  return banks[bank & ZX_PAGING_RAM_BANK_MASK];
+}
+
+const void *query_zx_mirror_ptr( const ZX_ADDR addr )
+{
+  const uint8_t *segments[4] = { rom, banks[5], banks[2], banks[paging_latch & ZX_PAGING_RAM_BANK_MASK] };
+
+  return &segments[addr >> ZX_SEGMENT_SHIFT][addr & ZX_SEGMENT_MASK];
+}
+
+uint8_t query_zx_paging_latch( void )
+{
+  return paging_latch;
+}
+
+uint8_t query_zx_ula_port( void )
+{
+  return 0xF8 | BORDER;
+}
+
+static bool collect_chunk( const uint8_t *data, const uint32_t length, void *user_data )
+{
+  if( length > SNAPSHOT_CHUNK_SIZE || snapshot_length + length > sizeof(snapshot) )
+    return false;
+
+  if( length > largest_chunk )
+    largest_chunk = length;
+
+  memcpy( &snapshot[snapshot_length], data, length );
+  snapshot_length += length;
+
+  return true;
+}
+
+static bool fail_chunk( const uint8_t *data, const uint32_t length, void *user_data )
+{
+  return false;
+}
+
+static uint16_t word_at( const uint32_t offset )
+{
+  return snapshot[offset] | (snapshot[offset+1] << 8);
+}
+
+static uint8_t *loaded_byte( const uint32_t zx_addr )
+{
+  const uint8_t bank[4] = { 0, 5, 2, loaded_latch & ZX_PAGING_RAM_BANK_MASK };
+
+  return &loaded_banks[bank[(zx_addr >> ZX_SEGMENT_SHIFT) & 3]][zx_addr & ZX_SEGMENT_MASK];
+}
+
+/*
+ * .SNA. A 48K one has its PC on the stack, which is popped the way the
+ * RETN at the end of loading it would.
+ */
+static bool load_sna( ZX_REGISTERS *regs, const bool large )
+{
+  const uint32_t expected = large ? 27 + 3*ZX_SEGMENT_SIZE + 4 + 5*ZX_SEGMENT_SIZE : 27 + 3*ZX_SEGMENT_SIZE;
+
+  /* A 128K .SNA with bank 2 or 5 paged in has that bank twice, and the other six after */
+  if( snapshot_length != expected && !(large && snapshot_length == expected + ZX_SEGMENT_SIZE) )
+  {
+    printf( "  .SNA is %u bytes, should be %u\n", snapshot_length, expected );
+    return false;
+  }
+
+  memset( regs, 0, sizeof(*regs) );
+  regs->i      = snapshot[0];
+  regs->hl_alt = word_at( 1 );
+  regs->de_alt = word_at( 3 );
+  regs->bc_alt = word_at( 5 );
+  regs->af_alt = word_at( 7 );
+  regs->hl     = word_at( 9 );
+  regs->de     = word_at( 11 );
+  regs->bc     = word_at( 13 );
+  regs->iy     = word_at( 15 );
+  regs->ix     = word_at( 17 );
+  regs->iff2   = (snapshot[19] & 0x04) ? 1 : 0;
+  regs->iff1   = regs->iff2;
+  regs->r      = snapshot[20];
+  regs->af     = word_at( 21 );
+  regs->sp     = word_at( 23 );
+  regs->im     = snapshot[25];
+  loaded_border = snapshot[26];
+
+  if( large )
+  {
+    const uint32_t rest = 27 + 3*ZX_SEGMENT_SIZE;
+
+    regs->pc     = word_at( rest );
+    loaded_latch = snapshot[rest+2];
+
+    const uint8_t paged = loaded_latch & ZX_PAGING_RAM_BANK_MASK;
+    memcpy( loaded_banks[5],     &snapshot[27],                   ZX_SEGMENT_SIZE );
+    memcpy( loaded_banks[2],     &snapshot[27+ZX_SEGMENT_SIZE],   ZX_SEGMENT_SIZE );
+    memcpy( loaded_banks[paged], &snapshot[27+2*ZX_SEGMENT_SIZE], ZX_SEGMENT_SIZE );
+
+    uint32_t offset = rest + 4;
+    for( uint8_t bank=0; bank < ZX_NUM_RAM_BANKS; bank++ )
+    {
+      if( bank != 5 && bank != 2 && bank != paged )
+      {
+        memcpy( loaded_banks[bank], &snapshot[offset], ZX_SEGMENT_SIZE );
+        offset += ZX_SEGMENT_SIZE;
+      }
+    }
+  }
+  else
+  {
+    loaded_latch = 0;
+    for( uint32_t zx_addr=0x4000; zx_addr < ZX_MEMORY_SIZE; zx_addr++ )
+      *loaded_byte( zx_addr ) = snapshot[27 + zx_addr - 0x4000];
+
+    regs->pc = *loaded_byte( regs->sp ) | (*loaded_byte( regs->sp+1 ) << 8);
+    regs->sp += 2;
+  }
+
+  return true;
+}
+
+/*
+ * .Z80 page, either stored as is (length 0xFFFF) or ED ED count byte
+ * compressed. Returns the offset of the next page, or 0 if it's bad.
+ */
+static uint32_t load_z80_page( const uint32_t offset, uint8_t *page )
+{
+  const uint32_t length = word_at( offset );
+  const uint32_t start  = offset + 3;
+
+  if( length == 0xFFFF )
+  {
+    memcpy( page, &snapshot[start], ZX_SEGMENT_SIZE );
+    return start + ZX_SEGMENT_SIZE;
+  }
+
+  uint32_t in = start, out = 0;
+  while( in < start + length )
+  {
+    if( snapshot[in] == 0xED && in+1 < start + length && snapshot[in+1] == 0xED )
+    {
+      const uint32_t run = snapshot[in+2];
+      if( run == 0 || out + run > ZX_SEGMENT_SIZE )
+        return 0;
+
+      memset( &page[out], snapshot[in+3], run );
+      out += run;
+      in  += 4;
+    }
+    else
+    {
+      if( out == ZX_SEGMENT_SIZE )
+        return 0;
+
+      page[out++] = snapshot[in++];
+    }
+  }
+
+  return (out == ZX_SEGMENT_SIZE && in == start + length) ? in : 0;
+}
+
+static bool load_z80( ZX_REGISTERS *regs, const bool large )
+{
+  memset( regs, 0, sizeof(*regs) );
+  regs->af     = (snapshot[0] << 8) | snapshot[1];
+  regs->bc     = word_at( 2 );
+  regs->hl     = word_at( 4 );
+  regs->sp     = word_at( 8 );
+  regs->i      = snapshot[10];
+  regs->r      = (snapshot[11] & 0x7F) | ((snapshot[12] & 0x01) << 7);
+  loaded_border = (snapshot[12] >> 1) & 0x07;
+  regs->de     = word_at( 13 );
+  regs->bc_alt = word_at( 15 );
+  regs->de_alt = word_at( 17 );
+  regs->hl_alt = word_at( 19 );
+  regs->af_alt = (snapshot[21] << 8) | snapshot[22];
+  regs->iy     = word_at( 23 );
+  regs->ix     = word_at( 25 );
+  regs->iff1   = snapshot[27];
+  regs->iff2   = snapshot[28];
+  regs->im     = snapshot[29] & 0x03;
+
+  if( word_at( 6 ) != 0 || word_at( 30 ) != 54 )
+  {
+    printf( "  .Z80 isn't version 3\n" );
+    return false;
+  }
+
+  regs->pc     = word_at( 32 );
+  loaded_latch = snapshot[35];
+
+  if( snapshot[34] != (large ? 4 : 0) )
+  {
+    printf( "  .Z80 hardware is %u\n", snapshot[34] );
+    return false;
+  }
+
+  const uint32_t num_pages = large ? 8 : 3;
+  uint32_t       offset    = 32 + 54;
+
+  for( uint32_t i=0; i < num_pages; i++ )
+  {
+    const uint8_t page_number = snapshot[offset+2];
+    int           bank;
+
+    if( large )
+      bank = (page_number >= 3 && page_number <= 10) ? page_number - 3 : -1;
+    else
+      bank = (page_number == 8) ? 5 : (page_number == 4) ? 2 : (page_number == 5) ? 0 : -1;
+
+    if( bank < 0 || (offset = load_z80_page( offset, loaded_banks[bank] )) == 0 )
+    {
+      printf( "  .Z80 page %u is bad\n", page_number );
+      return false;
+    }
+  }
+
+  if( offset != snapshot_length )
+  {
+    printf( "  .Z80 is %u bytes, the pages end at %u\n", snapshot_length, offset );
+    return false;
+  }
+
+  return true;
+}
+
+/*
+ * A bit of everything for the .Z80 compression: runs long and short, runs of
+ * more than 255, EDs on their own, in pairs, in runs and straight before a
+ * run, and noise. One bank's pure noise, which doesn't compress.
+ */
+static void fill_banks( void )
+{
+  srand( 1 );
+
+  for( uint32_t bank=0; bank < ZX_NUM_RAM_BANKS; bank++ )
+  {
+    uint8_t *page = banks[bank];
+
+    if( bank == 3 )
+    {
+      for( uint32_t i=0; i < ZX_SEGMENT_SIZE; i++ )
+        page[i] = rand();
+      continue;
+    }
+
+    uint32_t i = 0;
+    while( i < ZX_SEGMENT_SIZE )
+    {
+      uint32_t length = 1 + rand() % 300;
+      uint8_t  value  = rand();
+
+      switch( rand() % 6 )
+      {
+      case 0:  value = 0xED;          break;   // A run of EDs, or just the one or two
+      case 1:  length = 1 + rand() % 6; break;
+      case 2:
+        page[i++] = 0xED;                      // A lone ED straight before a run
+        break;
+      default:
+        length = 1;
+        break;
+      }
+
+      for( uint32_t n=0; n < length && i < ZX_SEGMENT_SIZE; n++ )
+        page[i++] = value;
+    }
+  }
+
+  /* A lone ED in the last byte of the page */
+  banks[0][ZX_SEGMENT_SIZE-2] = 0x00;
+  banks[0][ZX_SEGMENT_SIZE-1] = 0xED;
+}
+
+static void check_snapshot( const char *name, const SNAPSHOT_FORMAT format, const bool large,
+                            const uint8_t latch, const ZX_REGISTERS *regs )
+{
+  profile      = large ? &profile_128k : &profile_48k;
+  paging_latch = large ? latch : 0;
+
+  snapshot_length = 0;
+  largest_chunk   = 0;
+  memset( loaded_banks, 0, sizeof(loaded_banks) );
+
+  const uint32_t failures_before = failures;
+
+  const SNAPSHOT_STATUS status = write_zx_snapshot( format, regs, collect_chunk, NULL );
+  if( status != SNAPSHOT_OK )
+  {
+    printf( "FAIL %s: status %u\n", name, status );
+    failures++;
+    return;
+  }
+
+  ZX_REGISTERS loaded;
+  if( !(format == SNAPSHOT_FORMAT_SNA ? load_sna( &loaded, large ) : load_z80( &loaded, large )) )
+  {
+    printf( "FAIL %s: didn't load\n", name );
+    failures++;
+    return;
+  }
+
+  /* With no registers the snapshot has SP at the top of RAM and IM 1 */
+  ZX_REGISTERS want;
+  if( regs != NULL )
+  {
+    want = *regs;
+  }
+  else
+  {
+    memset( &want, 0, sizeof(want) );
+    want.sp = 0xFFFF;
+    want.im = 1;
+  }
+
+  /* .SNA doesn't have IFF1 */
+  if( format == SNAPSHOT_FORMAT_SNA )
+    want.iff1 = want.iff2;
+
+  if( memcmp( &loaded, &want, sizeof(want) ) != 0 )
+  {
+    printf( "  %s: registers don't match\n", name );
+    failures++;
+  }
+
+  if( loaded_border != BORDER || loaded_latch != paging_latch )
+  {
+    printf( "  %s: border %u latch 0x%02X, should be %u 0x%02X\n", name,
+            loaded_border, loaded_latch, BORDER, paging_latch );
+    failures++;
+  }
+
+  /*
+   * A 48K only has banks 5, 2 and 0. The two bytes under a 48K .SNA's SP hold
+   * the pushed PC, in the snapshot but not in the mirror.
+   */
+  for( uint32_t bank=0; bank < ZX_NUM_RAM_BANKS; bank++ )
+  {
+    if( !large && bank != 5 && bank != 2 && bank != 0 )
+      continue;
+
+    for( uint32_t i=0; i < ZX_SEGMENT_SIZE; i++ )
+    {
+      if( !large && format == SNAPSHOT_FORMAT_SNA )
+      {
+        const uint32_t zx_addr = ((bank == 5) ? 0x4000 : (bank == 2) ? 0x8000 : 0xC000) + i;
+        if( zx_addr == (uint16_t)(want.sp-2) || zx_addr == (uint16_t)(want.sp-1) )
+          continue;
+      }
+
+      if( loaded_banks[bank][i] != banks[bank][i] )
+      {
+        printf( "  %s: bank %u offset 0x%04X is 0x%02X, should be 0x%02X\n", name,
+                bank, i, loaded_banks[bank][i], banks[bank][i] );
+        failures++;
+        break;
+      }
+    }
+  }
+
+  if( failures == failures_before )
+    printf( "ok   %s, %u bytes, largest chunk %u\n", name, snapshot_length, largest_chunk );
+}
+
+static void check_status( const char *name, const SNAPSHOT_FORMAT format, const ZX_REGISTERS *regs,
+                          SNAPSHOT_SINK sink, const SNAPSHOT_STATUS want )
+{
+  profile      = &profile_48k;
+  paging_latch = 0;
+
+  snapshot_length = 0;
+
+  const SNAPSHOT_STATUS got = write_zx_snapshot( format, regs, sink, NULL );
+  if( got != want )
+  {
+    printf( "FAIL %s: status %u, should be %u\n", name, got, want );
+    failures++;
+    return;
+  }
+
+  printf( "ok   %s\n", name );
+}
+
+int main( void )
+{
+  fill_banks();
+
+  const ZX_REGISTERS regs = { .af = 0x1234, .bc = 0x2345, .de = 0x3456, .hl = 0x4567,
+                              .af_alt = 0x5678, .bc_alt = 0x6789, .de_alt = 0x789A, .hl_alt = 0x89AB,
+                              .ix = 0x9ABC, .iy = 0x5C3A, .sp = 0xFF40, .pc = 0x8123,
+                              .i = 0x3F, .r = 0xA5, .iff1 = 1, .iff2 = 1, .im = 2 };
+
+  ZX_REGISTERS low_stack = regs;
+  low_stack.sp   = 0x4002;
+  low_stack.iff1 = 0;
+  low_stack.iff2 = 0;
+  low_stack.r    = 0x12;
+
+  check_snapshot( ".SNA, 48K",                         SNAPSHOT_FORMAT_SNA, false, 0,    &regs );
+  check_snapshot( ".SNA, 48K, PC pushed into screen",  SNAPSHOT_FORMAT_SNA, false, 0,    &low_stack );
+  check_snapshot( ".SNA, 48K, no registers",           SNAPSHOT_FORMAT_SNA, false, 0,    NULL );
+  check_snapshot( ".SNA, 128K, bank 7 paged",          SNAPSHOT_FORMAT_SNA, true,  0x1F, &regs );
+  check_snapshot( ".SNA, 128K, bank 2 paged",          SNAPSHOT_FORMAT_SNA, true,  0x02, &regs );
+  check_snapshot( ".Z80, 48K",                         SNAPSHOT_FORMAT_Z80, false, 0,    &regs );
+  check_snapshot( ".Z80, 48K, no registers",           SNAPSHOT_FORMAT_Z80, false, 0,    NULL );
+  check_snapshot( ".Z80, 128K, bank 3 paged",          SNAPSHOT_FORMAT_Z80, true,  0x13, &regs );
+
+  ZX_REGISTERS rom_stack = regs;
+  rom_stack.sp = 0x4001;
+
+  check_status( ".SNA, 48K, PC would be pushed into ROM", SNAPSHOT_FORMAT_SNA, &rom_stack, collect_chunk, SNAPSHOT_BAD_STACK );
+  check_status( "sink gives up",                          SNAPSHOT_FORMAT_Z80, &regs,      fail_chunk,    SNAPSHOT_SINK_FAILED );
+  check_status( "no sink",                                SNAPSHOT_FORMAT_SNA, &regs,      NULL,          SNAPSHOT_BAD_ARG );
+  check_status( "unknown format",                         (SNAPSHOT_FORMAT)7,  &regs,      collect_chunk, SNAPSHOT_BAD_ARG );
+
+  printf( "%u failures\n", failures );
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * ZX Coprocessor Firmware, a Raspberry Pi RP2350b based Spectrum device
+ * Copyright (C) 2025 Derek Fountain
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Host side replayer for the firmware's write log.
+ *
+ * gcc -O2 -Wall -o write_log_replay write_log_replay.c
+ *
+ * Takes a dump of the log, taken from the debugger with something like
+ *
+ *  dump binary value write_log.bin write_log
+ *
+ * and plays the writes back into a 64K image of the Spectrum's memory, one
+ * frame at a time. The replay starts from the image the firmware took when
+ * the log was armed, which is in the dump.
+ *
+ * Entries the Z80 has drained with the fetch_write_log command aren't in the
+ * log any more. If the Z80 program saved them, end to end, pass the file with
+ * -e and they're replayed ahead of what's still in the log.
+ *
+ * Usage: write_log_replay [-i initial.bin] [-e fetched.bin] [-o prefix] [-s] write_log.bin
+ *
+ *  -i  memory image to start from instead of the one in the dump
+ *  -e  entries fetched by the Z80 before the dump was taken
+ *  -o  write the memory image at the end of each frame to prefix_NNNNNN.bin
+ *  -s  print how many times each 256 byte page was written to, busiest first
+ *
+ * A line per frame goes to stdout: the frame, the number of writes, how many
+ * of those came from the DMA engine, the number of different 256 byte pages
+ * written to and the T-state of the last write.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../firmware/write_log.h"
+
+#define ZX_MEMORY_SIZE  65536
+#define NUM_PAGES       256
+
+static uint8_t  zx_memory[ZX_MEMORY_SIZE];
+static uint32_t page_writes[NUM_PAGES];
+static uint32_t tstates_per_line = 0;
+
+typedef struct _frame_stats
+{
+  uint32_t frame;
+  uint32_t writes;
+  uint32_t dma_writes;
+  uint32_t last_tstate;
+  uint8_t  pages[NUM_PAGES];
+}
+FRAME_STATS;
+
+static int read_file( const char *filename, void *buffer, const size_t length, size_t *read_length )
+{
+  FILE *f = fopen( filename, "rb" );
+  if( f == NULL )
+  {
+    perror( filename );
+    return -1;
+  }
+
+  *read_length = fread( buffer, 1, length, f );
+  fclose( f );
+
+  return 0;
+}
+
+static void end_frame( FRAME_STATS *stats, const char *prefix )
+{
+  uint32_t num_pages = 0;
+  for( uint32_t i=0; i < NUM_PAGES; i++ )
+    num_pages += stats->pages[i];
+
+  printf( "frame %6u: %6u writes, %6u dma, %3u pages, last t-state %u (line %u)\n",
+          stats->frame, stats->writes, stats->dma_writes, num_pages, stats->last_tstate,
+          tstates_per_line ? stats->last_tstate / tstates_per_line : 0 );
+
+  if( prefix != NULL )
+  {
+    char filename[1024];
+    snprintf( filename, sizeof(filename), "%s_%06u.bin", prefix, stats->frame );
+
+    FILE *f = fopen( filename, "wb" );
+    if( f == NULL )
+    {
+      perror( filename );
+      exit( 1 );
+    }
+    fwrite( zx_memory, 1, ZX_MEMORY_SIZE, f );
+    fclose( f );
+  }
+}
+
+typedef struct _replay
+{
+  FRAME_STATS *stats;
+  const char  *prefix;
+  uint32_t     last_logged_frame;
+  int          first;
+}
+REPLAY;
+
+/*
+ * The frame number in each entry is only 15 bits. Frames only go forwards,
+ * so the difference from the previous entry (modulo the wrap) gives the real
+ * frame count.
+ */
+static void replay_entry( REPLAY *replay, const WRITE_LOG_ENTRY *entry )
+{
+  FRAME_STATS   *stats        = replay->stats;
+  const uint32_t logged_frame = WRITE_LOG_FRAME(entry);
+
+  if( replay->first )
+  {
+    stats->frame  = logged_frame;
+    replay->first = 0;
+  }
+  else if( logged_frame != replay->last_logged_frame )
+  {
+    end_frame( stats, replay->prefix );
+
+    const uint32_t next_frame = stats->frame + ((logged_frame - replay->last_logged_frame) & WRITE_LOG_FRAME_MASK);
+    memset( stats, 0, sizeof(*stats) );
+    stats->frame = next_frame;
+  }
+  replay->last_logged_frame = logged_frame;
+
+  zx_memory[entry->address] = entry->value;
+
+  stats->writes++;
+  if( entry->flags & WRITE_LOG_FLAG_DMA )
+    stats->dma_writes++;
+  stats->last_tstate = WRITE_LOG_TSTATE(entry);
+  stats->pages[entry->address >> 8] = 1;
+
+  page_writes[entry->address >> 8]++;
+}
+
+static int compare_pages( const void *a, const void *b )
+{
+  const uint32_t page_a = *(const uint32_t*)a;
+  const uint32_t page_b = *(const uint32_t*)b;
+
+  if( page_writes[page_a] != page_writes[page_b] )
+    return (page_writes[page_a] < page_writes[page_b]) ? 1 : -1;
+
+  return (page_a < page_b) ? -1 : 1;
+}
+
+static void print_page_summary( void )
+{
+  uint32_t pages[NUM_PAGES];
+  for( uint32_t i=0; i < NUM_PAGES; i++ )
+    pages[i] = i;
+
+  qsort( pages, NUM_PAGES, sizeof(uint32_t), compare_pages );
+
+  printf( "\npage   writes\n" );
+  for( uint32_t i=0; i < NUM_PAGES && page_writes[pages[i]] != 0; i++ )
+    printf( "%02X00 %8u\n", pages[i], page_writes[pages[i]] );
+}
+
+int main( int argc, char *argv[] )
+{
+  const char *initial_filename = NULL;
+  const char *fetched_filename = NULL;
+  const char *prefix           = NULL;
+  int         summary          = 0;
+  int         opt;
+
+  while( (opt = getopt( argc, argv, "i:e:o:s" )) != -1 )
+  {
+    switch( opt )
+    {
+    case 'i': initial_filename = optarg; break;
+    case 'e': fetched_filename = optarg; break;
+    case 'o': prefix           = optarg; break;
+    case 's': summary          = 1;      break;
+    default:
+      fprintf( stderr, "Usage: %s [-i initial.bin] [-e fetched.bin] [-o prefix] [-s] write_log.bin\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if( optind != argc-1 )
+  {
+    fprintf( stderr, "Usage: %s [-i initial.bin] [-e fetched.bin] [-o prefix] [-s] write_log.bin\n", argv[0] );
+    return 1;
+  }
+
+  static WRITE_LOG log;
+  size_t length;
+
+  if( read_file( argv[optind], &log, sizeof(log), &length ) != 0 )
+    return 1;
+
+  if( length != sizeof(log) || log.magic != WRITE_LOG_MAGIC
+      || log.entry_size != sizeof(WRITE_LOG_ENTRY) || log.num_entries != NUM_WRITE_LOG_ENTRIES )
+  {
+    fprintf( stderr, "%s: not a write log dump from this version of the firmware\n", argv[optind] );
+    return 1;
+  }
+
+  if( !log.armed )
+  {
+    fprintf( stderr, "%s: the log hasn't been armed, the Spectrum hadn't finished booting\n", argv[optind] );
+    return 1;
+  }
+
+  memcpy( zx_memory, log.start_image, ZX_MEMORY_SIZE );
+
+  static WRITE_LOG_ENTRY fetched[1 << 20];
+  size_t num_fetched = 0;
+
+  if( fetched_filename != NULL )
+  {
+    if( read_file( fetched_filename, fetched, sizeof(fetched), &length ) != 0 )
+      return 1;
+
+    if( length % sizeof(WRITE_LOG_ENTRY) != 0 || length == sizeof(fetched) )
+    {
+      fprintf( stderr, "%s: expected up to %zu whole entries\n", fetched_filename, sizeof(fetched)/sizeof(WRITE_LOG_ENTRY)-1 );
+      return 1;
+    }
+    num_fetched = length / sizeof(WRITE_LOG_ENTRY);
+  }
+
+  if( initial_filename != NULL )
+  {
+    if( read_file( initial_filename, zx_memory, ZX_MEMORY_SIZE, &length ) != 0 )
+      return 1;
+
+    if( length != ZX_MEMORY_SIZE )
+    {
+      fprintf( stderr, "%s: expected a 64K memory image\n", initial_filename );
+      return 1;
+    }
+  }
+
+  printf( "%zu fetched, %u entries, %u dropped, %u.%06uMHz, %u t-states per frame, %u per line\n",
+          num_fetched, (log.head + NUM_WRITE_LOG_ENTRIES - log.tail) % NUM_WRITE_LOG_ENTRIES, log.dropped,
+          log.cpu_clock_hz / 1000000, log.cpu_clock_hz % 1000000, log.frame_tstates, log.tstates_per_line );
+
+  tstates_per_line = log.tstates_per_line;
+
+  FRAME_STATS stats;
+  memset( &stats, 0, sizeof(stats) );
+
+  REPLAY replay = { &stats, prefix, 0, 1 };
+
+  for( size_t i=0; i < num_fetched; i++ )
+    replay_entry( &replay, &fetched[i] );
+
+  for( uint32_t i=log.tail; i != log.head; i = (i + 1) % NUM_WRITE_LOG_ENTRIES )
+    replay_entry( &replay, &log.entries[i] );
+
+  if( !replay.first )
+    end_frame( &stats, prefix );
+
+  if( summary )
+    print_page_summary();
+
+  return 0;
+}